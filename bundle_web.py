@@ -0,0 +1,69 @@
+#!/usr/bin/env python3
+"""Bundle the web interface into one gzipped page for the firmware.
+
+Stylesheets and scripts referenced by index.html are inlined, everything is
+minified conservatively (comments and whitespace only, line breaks in
+scripts are kept), and the page is gzipped without a timestamp so builds are
+reproducible. main/CMakeLists.txt runs this and embeds the result.
+
+Usage: bundle_web.py <data dir> <output .html.gz>
+"""
+
+import gzip
+import re
+import sys
+from pathlib import Path
+
+
+def minify_css(text):
+    text = re.sub(r"/\*.*?\*/", "", text, flags=re.S)
+    text = re.sub(r"\s+", " ", text)
+    text = re.sub(r"\s*([{};,>])\s*", r"\1", text)
+    text = re.sub(r":\s+", ":", text)
+    return text.replace(";}", "}").strip()
+
+
+def minify_js(text):
+    lines = []
+    for line in text.splitlines():
+        line = line.strip()
+        if line and not line.startswith("//"):
+            lines.append(line)
+    # A literal "</script" would end the inline script early
+    return "\n".join(lines).replace("</script", "<\\/script")
+
+
+def minify_html(text):
+    text = re.sub(r"<!--.*?-->", "", text, flags=re.S)
+    return "\n".join(line.strip() for line in text.splitlines() if line.strip())
+
+
+def bundle(data_dir):
+    def inline_css(match):
+        return "<style>" + minify_css((data_dir / match.group(1)).read_text()) + "</style>"
+
+    def inline_js(match):
+        return "<script>" + minify_js((data_dir / match.group(1)).read_text()) + "</script>"
+
+    page = minify_html((data_dir / "index.html").read_text())
+    page = re.sub(r'<link rel="stylesheet" href="([^"]+)">', inline_css, page)
+    return re.sub(r'<script src="([^"]+)"></script>', inline_js, page)
+
+
+def main():
+    if len(sys.argv) != 3:
+        sys.exit(__doc__.strip().splitlines()[-1])
+    data_dir = Path(sys.argv[1])
+    output = Path(sys.argv[2])
+
+    page = bundle(data_dir).encode()
+    compressed = gzip.compress(page, compresslevel=9, mtime=0)
+    output.write_bytes(compressed)
+
+    sources = sum(f.stat().st_size for f in data_dir.iterdir() if f.is_file())
+    print(f"Web bundle: {sources} bytes in {len(list(data_dir.iterdir()))} files -> "
+          f"{len(page)} minified -> {len(compressed)} gzipped")
+
+
+if __name__ == "__main__":
+    main()
@@ -34,25 +34,45 @@ function setupEventListeners() {
     document.getElementById('unlockForm').addEventListener('submit', handleUnlockNote);
 }
 
-// Load notes list
-async function loadNotes() {
+// Load notes list (newest first); with a cursor, append the next page
+async function loadNotes(cursor = null) {
     try {
-        const response = await fetch(`${API_BASE}/notes`);
+        const query = cursor ? `?cursor=${encodeURIComponent(cursor)}` : '';
+        const response = await fetch(`${API_BASE}/notes${query}`);
         const data = await response.json();
         
         const notesList = document.getElementById('notesList');
+        const moreBtn = document.getElementById('loadMoreBtn');
+        if (moreBtn) {
+            moreBtn.remove();
+        }
         
         if (data.notes && data.notes.length > 0) {
-            notesList.innerHTML = data.notes.map(note => `
+            const cards = data.notes.map(note => `
                 <div class="note-card" onclick="openNote('${note.id}', '${escapeHtml(note.title)}', ${note.encrypted})">
                     <h3>${escapeHtml(note.title)}</h3>
                     <p class="timestamp">${formatTimestamp(note.timestamp)}</p>
+                    ${note.expires_at ? `<p class="timestamp">Expires ${formatTimestamp(note.expires_at)}</p>` : ''}
                     ${note.encrypted ? '<span class="encrypted-badge">🔒 Encrypted</span>' : '<span class="plain-badge">📝 Plain</span>'}
                 </div>
             `).join('');
-        } else {
+            if (cursor) {
+                notesList.insertAdjacentHTML('beforeend', cards);
+            } else {
+                notesList.innerHTML = cards;
+            }
+        } else if (!cursor) {
             notesList.innerHTML = '<p class="loading">No messages yet. Create one to get started!</p>';
         }
+
+        if (data.next_cursor) {
+            const btn = document.createElement('button');
+            btn.id = 'loadMoreBtn';
+            btn.className = 'btn-secondary';
+            btn.textContent = 'Load more';
+            btn.addEventListener('click', () => loadNotes(data.next_cursor));
+            notesList.appendChild(btn);
+        }
     } catch (error) {
         console.error('Failed to load notes:', error);
         document.getElementById('notesList').innerHTML = '<p class="error">Failed to load messages</p>';
@@ -91,6 +111,7 @@ async function handleCreateNote(e) {
     const title = document.getElementById('titleInput').value;
     const message = document.getElementById('messageInput').value;
     const password = document.getElementById('passwordInput').value;
+    const ttl = document.getElementById('ttlInput').value;
     
     try {
         let finalMessage = message;
@@ -102,10 +123,19 @@ async function handleCreateNote(e) {
             encrypted = true;
         }
         
+        // Raw body upload; the device writes it to flash as it arrives
+        const headers = {
+            'Content-Type': 'application/octet-stream',
+            'X-Note-Title': encodeURIComponent(title),
+            'X-Note-Encrypted': encrypted ? '1' : '0'
+        };
+        if (ttl) {
+            headers['X-Note-TTL'] = ttl;
+        }
         const response = await fetch(`${API_BASE}/notes`, {
             method: 'POST',
-            headers: { 'Content-Type': 'application/json' },
-            body: JSON.stringify({ title, message: finalMessage, encrypted })
+            headers,
+            body: finalMessage
         });
         
         const data = await response.json();
@@ -58,8 +58,19 @@ async function encryptMessage(message, password) {
     return btoa(String.fromCharCode(...combined));
 }
 
-// Decrypt message with password
+// Decrypt message with password. Notes grown with PATCH /api/notes/{id}
+// hold one base64 segment per line, each encrypted on its own.
 async function decryptMessage(encryptedData, password) {
+    const parts = [];
+    for (const segment of encryptedData.split('\n')) {
+        if (segment) {
+            parts.push(await decryptSegment(segment, password));
+        }
+    }
+    return parts.join('');
+}
+
+async function decryptSegment(encryptedData, password) {
     try {
         // Decode from base64
         const combined = Uint8Array.from(atob(encryptedData), c => c.charCodeAt(0));
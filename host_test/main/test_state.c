@@ -0,0 +1,313 @@
+// Stress tests for the lock the storage worker takes around index changes.
+// Tasks yield inside their critical sections so the scheduler interleaves
+// them as often as possible; checks run in the tasks and are counted, as
+// Unity asserts may only fail from the test task itself.
+
+#include "unity.h"
+#include "state_lock.h"
+#include "catalog.h"
+#include "search_index.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+#include <inttypes.h>
+
+#define READER_TASKS 4
+#define TASK_PRIORITY (tskIDLE_PRIORITY + 1)
+#define TASK_STACK 8192
+#define WRITER_TIMEOUT_MS 20000
+
+#define LOCK_WRITES 200
+#define STRESS_NOTES 300
+#define STRESS_NAMESPACES 2
+#define STRESS_PAGE 16
+
+static atomic_int g_readers_inside;
+static atomic_int g_writers_inside;
+static atomic_int g_max_readers;
+static atomic_int g_violations;
+static atomic_int g_reads;
+static atomic_bool g_stop;
+static SemaphoreHandle_t g_writer_done;
+static SemaphoreHandle_t g_reader_done;
+
+static void harness_setup(void)
+{
+    static bool initialized = false;
+    if (!initialized) {
+        TEST_ASSERT_EQUAL(ESP_OK, state_lock_init());
+        g_writer_done = xSemaphoreCreateBinary();
+        g_reader_done = xSemaphoreCreateCounting(READER_TASKS, 0);
+        TEST_ASSERT_NOT_NULL(g_writer_done);
+        TEST_ASSERT_NOT_NULL(g_reader_done);
+        initialized = true;
+    }
+    atomic_store(&g_readers_inside, 0);
+    atomic_store(&g_writers_inside, 0);
+    atomic_store(&g_max_readers, 0);
+    atomic_store(&g_violations, 0);
+    atomic_store(&g_reads, 0);
+    atomic_store(&g_stop, false);
+
+    // Above the workers, so the test task can always time them out
+    vTaskPrioritySet(NULL, TASK_PRIORITY + 1);
+}
+
+// Start the reader tasks and the writer, then wait for the writer to finish
+// while the readers keep the lock busy. Returns false if the writer starved.
+static bool run_tasks(TaskFunction_t reader, TaskFunction_t writer)
+{
+    for (int i = 0; i < READER_TASKS; i++) {
+        char name[16];
+        snprintf(name, sizeof(name), "reader%d", i);
+        TEST_ASSERT_EQUAL(pdPASS, xTaskCreate(reader, name, TASK_STACK, NULL, TASK_PRIORITY, NULL));
+    }
+    TEST_ASSERT_EQUAL(pdPASS, xTaskCreate(writer, "writer", TASK_STACK, NULL, TASK_PRIORITY, NULL));
+
+    bool finished = xSemaphoreTake(g_writer_done, pdMS_TO_TICKS(WRITER_TIMEOUT_MS)) == pdTRUE;
+    atomic_store(&g_stop, true);
+    if (finished) {
+        for (int i = 0; i < READER_TASKS; i++) {
+            xSemaphoreTake(g_reader_done, portMAX_DELAY);
+        }
+    }
+    return finished;
+}
+
+static void check(bool ok)
+{
+    if (!ok) {
+        atomic_fetch_add(&g_violations, 1);
+    }
+}
+
+static void enter_read(void)
+{
+    state_read_lock();
+    int inside = atomic_fetch_add(&g_readers_inside, 1) + 1;
+    int max = atomic_load(&g_max_readers);
+    while (inside > max && !atomic_compare_exchange_weak(&g_max_readers, &max, inside)) {
+    }
+    check(atomic_load(&g_writers_inside) == 0);
+}
+
+static void leave_read(void)
+{
+    check(atomic_load(&g_writers_inside) == 0);
+    atomic_fetch_sub(&g_readers_inside, 1);
+    atomic_fetch_add(&g_reads, 1);
+    state_read_unlock();
+}
+
+static void enter_write(void)
+{
+    state_write_lock();
+    check(atomic_fetch_add(&g_writers_inside, 1) == 0);
+    check(atomic_load(&g_readers_inside) == 0);
+}
+
+static void leave_write(void)
+{
+    check(atomic_load(&g_readers_inside) == 0);
+    atomic_fetch_sub(&g_writers_inside, 1);
+    state_write_unlock();
+}
+
+// Lock alone
+
+static void lock_reader_task(void *arg)
+{
+    // No pause between reads: the writer must still get its turn
+    while (!atomic_load(&g_stop)) {
+        enter_read();
+        taskYIELD();
+        leave_read();
+    }
+    xSemaphoreGive(g_reader_done);
+    vTaskDelete(NULL);
+}
+
+static void lock_writer_task(void *arg)
+{
+    for (int i = 0; i < LOCK_WRITES; i++) {
+        enter_write();
+        taskYIELD();
+        leave_write();
+        vTaskDelay(1);
+    }
+    xSemaphoreGive(g_writer_done);
+    vTaskDelete(NULL);
+}
+
+TEST_CASE("writer excludes readers and is not starved by them", "[state_lock]")
+{
+    harness_setup();
+    TEST_ASSERT_TRUE_MESSAGE(run_tasks(lock_reader_task, lock_writer_task), "writer starved");
+    TEST_ASSERT_EQUAL(0, atomic_load(&g_violations));
+    TEST_ASSERT_GREATER_THAN(1, atomic_load(&g_max_readers));
+    TEST_ASSERT_GREATER_THAN(0, atomic_load(&g_reads));
+}
+
+// Catalog and search index under the lock, written the way the storage
+// worker does: search docs are built unlocked, then committed together with
+// the catalog entry; deletes drop both.
+
+static void stress_note(uint32_t n, note_metadata_t *meta, char *body, size_t body_size)
+{
+    memset(meta, 0, sizeof(*meta));
+    snprintf(meta->id, sizeof(meta->id), "%08" PRIx32, n);
+    snprintf(meta->title, sizeof(meta->title), "note %" PRIu32, n);
+    meta->timestamp = 1000 + n;
+    meta->size = 10 + n % 50;
+    meta->encrypted = n % 3 == 0;
+    meta->ns = n % STRESS_NAMESPACES;
+    snprintf(body, body_size, "common stress word%" PRIu32, n % 7);
+}
+
+static void index_writer_task(void *arg)
+{
+    for (uint32_t n = 1; n <= STRESS_NOTES; n++) {
+        note_metadata_t meta;
+        char body[64];
+        stress_note(n, &meta, body, sizeof(body));
+
+        search_doc_t *doc = NULL;
+        if (search_doc_begin(n, false, &doc) != ESP_OK) {
+            check(false);
+            break;
+        }
+        search_doc_feed(doc, meta.title, strlen(meta.title));
+        search_doc_break(doc);
+        search_doc_feed(doc, body, strlen(body));
+
+        enter_write();
+        check(catalog_insert(&meta) == ESP_OK);
+        taskYIELD();
+        check(search_doc_commit(doc) == ESP_OK);
+        leave_write();
+
+        // Delete every third note shortly after it was written
+        if (n % 3 == 0) {
+            char id[16];
+            snprintf(id, sizeof(id), "%08" PRIx32, n - 2);
+            enter_write();
+            check(catalog_remove(id) == ESP_OK);
+            taskYIELD();
+            search_remove(n - 2);
+            leave_write();
+        }
+        vTaskDelay(1);
+    }
+    xSemaphoreGive(g_writer_done);
+    vTaskDelete(NULL);
+}
+
+static void check_catalog(void)
+{
+    catalog_totals_t totals;
+    catalog_get_totals(&totals);
+    size_t count = catalog_count();
+    check(totals.count == count);
+
+    // ID order, and totals that match the entries
+    uint32_t encrypted = 0;
+    uint64_t bytes = 0;
+    const note_metadata_t *prev = NULL;
+    for (size_t i = 0; i < count; i++) {
+        const note_metadata_t *meta = catalog_at(i);
+        check(meta != NULL);
+        if (!meta) {
+            return;
+        }
+        check(!prev || strcmp(prev->id, meta->id) < 0);
+        check(catalog_find(meta->id) == meta);
+        encrypted += meta->encrypted;
+        bytes += meta->size;
+        prev = meta;
+    }
+    check(totals.encrypted_count == encrypted);
+    check(totals.bytes == bytes);
+
+    uint32_t ns_count = 0;
+    for (uint8_t ns = 0; ns < STRESS_NAMESPACES; ns++) {
+        catalog_totals_t ns_totals;
+        catalog_get_ns_totals(ns, &ns_totals);
+        ns_count += ns_totals.count;
+    }
+    check(ns_count == totals.count);
+}
+
+static void check_pages(uint8_t ns)
+{
+    catalog_totals_t ns_totals;
+    catalog_get_ns_totals(ns, &ns_totals);
+
+    note_metadata_t page[STRESS_PAGE];
+    bool more;
+    size_t got = catalog_page(ns, true, NULL, page, STRESS_PAGE, &more);
+    check(got <= ns_totals.count);
+    check(more == (ns_totals.count > got));
+    for (size_t i = 0; i < got; i++) {
+        check(page[i].ns == ns);
+        check(i == 0 || page[i - 1].timestamp >= page[i].timestamp);
+        check(catalog_find(page[i].id) != NULL);
+    }
+}
+
+static void check_search(uint8_t ns)
+{
+    uint32_t ids[32];
+    bool more;
+    size_t got = search_query(ns, "common stress", ids, 32, &more);
+    for (size_t i = 0; i < got; i++) {
+        char id[16];
+        snprintf(id, sizeof(id), "%08" PRIx32, ids[i]);
+        const note_metadata_t *meta = catalog_find(id);
+        check(meta != NULL && meta->ns == ns);
+        check(i == 0 || ids[i - 1] > ids[i]);
+    }
+}
+
+static void index_reader_task(void *arg)
+{
+    uint8_t ns = 0;
+    while (!atomic_load(&g_stop)) {
+        enter_read();
+        check_catalog();
+        taskYIELD();
+        check_pages(ns);
+        taskYIELD();
+        check_search(ns);
+        leave_read();
+        ns = (ns + 1) % STRESS_NAMESPACES;
+    }
+    xSemaphoreGive(g_reader_done);
+    vTaskDelete(NULL);
+}
+
+TEST_CASE("catalog and search index stay consistent under concurrent readers", "[state_lock]")
+{
+    harness_setup();
+    TEST_ASSERT_EQUAL(ESP_OK, catalog_init());
+    TEST_ASSERT_EQUAL(ESP_OK, search_init());
+
+    TEST_ASSERT_TRUE_MESSAGE(run_tasks(index_reader_task, index_writer_task), "writer starved");
+    TEST_ASSERT_EQUAL(0, atomic_load(&g_violations));
+    TEST_ASSERT_GREATER_THAN(0, atomic_load(&g_reads));
+
+    // No write was lost: every live note is cataloged and searchable
+    uint32_t live = STRESS_NOTES - STRESS_NOTES / 3;
+    TEST_ASSERT_EQUAL(live, catalog_count());
+    static uint32_t ids[STRESS_NOTES];
+    uint32_t found = 0;
+    for (uint8_t ns = 0; ns < STRESS_NAMESPACES; ns++) {
+        bool more;
+        found += search_query(ns, "common", ids, STRESS_NOTES, &more);
+        TEST_ASSERT_FALSE(more);
+    }
+    TEST_ASSERT_EQUAL(live, found);
+}
@@ -0,0 +1,165 @@
+#include "body_cache.h"
+#include "constants.h"
+#include "esp_log.h"
+#include "esp_heap_caps.h"
+#include <string.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <inttypes.h>
+
+struct body_cache_entry {
+    uint32_t id;
+    uint32_t refs;   // Open readers; an entry is only freed at 0
+    bool removed;    // Unlinked from the cache, freed by the last release
+    size_t len;
+    char *data;
+    body_cache_entry_t *prev;  // Towards most recently used
+    body_cache_entry_t *next;  // Towards least recently used
+};
+
+static const char *TAG = "body_cache";
+
+// Doubly linked LRU list, most recently used first
+static body_cache_entry_t *g_head = NULL;
+static body_cache_entry_t *g_tail = NULL;
+static uint32_t g_entries = 0;
+static size_t g_bytes = 0;
+static uint32_t g_hits = 0;
+static uint32_t g_misses = 0;
+
+static void unlink_entry(body_cache_entry_t *entry)
+{
+    if (entry->prev) {
+        entry->prev->next = entry->next;
+    } else {
+        g_head = entry->next;
+    }
+    if (entry->next) {
+        entry->next->prev = entry->prev;
+    } else {
+        g_tail = entry->prev;
+    }
+    entry->prev = entry->next = NULL;
+}
+
+static void push_front(body_cache_entry_t *entry)
+{
+    entry->prev = NULL;
+    entry->next = g_head;
+    if (g_head) {
+        g_head->prev = entry;
+    } else {
+        g_tail = entry;
+    }
+    g_head = entry;
+}
+
+static void free_entry(body_cache_entry_t *entry)
+{
+    heap_caps_free(entry->data);
+    free(entry);
+}
+
+// Take an entry out of the cache; it lives on while readers hold it
+static void drop_entry(body_cache_entry_t *entry)
+{
+    unlink_entry(entry);
+    g_entries--;
+    g_bytes -= entry->len;
+    if (entry->refs == 0) {
+        free_entry(entry);
+    } else {
+        entry->removed = true;
+    }
+}
+
+static body_cache_entry_t *find(uint32_t note_id)
+{
+    for (body_cache_entry_t *entry = g_head; entry; entry = entry->next) {
+        if (entry->id == note_id) {
+            return entry;
+        }
+    }
+    return NULL;
+}
+
+bool body_cache_contains(uint32_t note_id)
+{
+    return find(note_id) != NULL;
+}
+
+body_cache_entry_t *body_cache_get(uint32_t note_id)
+{
+    body_cache_entry_t *entry = find(note_id);
+    if (!entry) {
+        g_misses++;
+        return NULL;
+    }
+
+    g_hits++;
+    unlink_entry(entry);
+    push_front(entry);
+    entry->refs++;
+    return entry;
+}
+
+body_cache_entry_t *body_cache_put(uint32_t note_id, char *data, size_t len)
+{
+    if (len > BODY_CACHE_MAX_NOTE) {
+        return NULL;
+    }
+
+    body_cache_entry_t *entry = calloc(1, sizeof(body_cache_entry_t));
+    if (!entry) {
+        return NULL;
+    }
+
+    body_cache_entry_t *old = find(note_id);
+    if (old) {
+        drop_entry(old);
+    }
+
+    // Evicted entries still being read leave the budget now and are freed later
+    body_cache_entry_t *victim = g_tail;
+    while (victim && (g_bytes + len > BODY_CACHE_BYTES || g_entries >= BODY_CACHE_MAX_ENTRIES)) {
+        body_cache_entry_t *prev = victim->prev;
+        ESP_LOGD(TAG, "Evicting note %08" PRIx32, victim->id);
+        drop_entry(victim);
+        victim = prev;
+    }
+
+    *entry = (body_cache_entry_t){ .id = note_id, .refs = 1, .len = len, .data = data };
+    push_front(entry);
+    g_entries++;
+    g_bytes += len;
+    return entry;
+}
+
+const char *body_cache_data(const body_cache_entry_t *entry, size_t *len)
+{
+    *len = entry->len;
+    return entry->data;
+}
+
+void body_cache_release(body_cache_entry_t *entry)
+{
+    if (entry && --entry->refs == 0 && entry->removed) {
+        free_entry(entry);
+    }
+}
+
+void body_cache_remove(uint32_t note_id)
+{
+    body_cache_entry_t *entry = find(note_id);
+    if (entry) {
+        drop_entry(entry);
+    }
+}
+
+void body_cache_get_stats(body_cache_stats_t *stats)
+{
+    stats->hits = g_hits;
+    stats->misses = g_misses;
+    stats->entries = g_entries;
+    stats->bytes = g_bytes;
+}
@@ -0,0 +1,81 @@
+#ifndef BODY_CACHE_H
+#define BODY_CACHE_H
+
+#include "esp_err.h"
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+// A cached note body as it is returned to clients (decompressed, still
+// encrypted if the note is). Only used on the storage task, apart from
+// body_cache_get_stats.
+typedef struct body_cache_entry body_cache_entry_t;
+
+typedef struct {
+    uint32_t hits;
+    uint32_t misses;
+    uint32_t entries;
+    size_t bytes;
+} body_cache_stats_t;
+
+/**
+ * Check for a note body without touching the LRU order or the counters
+ *
+ * @param note_id Numeric note ID
+ * @return true if the body is cached
+ */
+bool body_cache_contains(uint32_t note_id);
+
+/**
+ * Look up a note body and mark it most recently used
+ *
+ * @param note_id Numeric note ID
+ * @return Entry to read with body_cache_data and release with
+ *         body_cache_release, or NULL on a miss
+ */
+body_cache_entry_t *body_cache_get(uint32_t note_id);
+
+/**
+ * Add a note body, evicting least recently used bodies to stay within
+ * BODY_CACHE_BYTES
+ *
+ * @param note_id Numeric note ID
+ * @param data Body allocated with heap_caps_malloc; owned by the cache on success
+ * @param len Body length (at most BODY_CACHE_MAX_NOTE)
+ * @return Entry as for body_cache_get, or NULL if it does not fit
+ *         (data is then still owned by the caller)
+ */
+body_cache_entry_t *body_cache_put(uint32_t note_id, char *data, size_t len);
+
+/**
+ * Body bytes of an entry
+ *
+ * @param entry Entry from body_cache_get or body_cache_put
+ * @param len Output: body length
+ * @return Body bytes, valid until the entry is released
+ */
+const char *body_cache_data(const body_cache_entry_t *entry, size_t *len);
+
+/**
+ * Drop a reference; the body stays cached
+ *
+ * @param entry Entry from body_cache_get or body_cache_put
+ */
+void body_cache_release(body_cache_entry_t *entry);
+
+/**
+ * Forget a note (deleted). Readers holding the entry keep it until released.
+ *
+ * @param note_id Numeric note ID
+ */
+void body_cache_remove(uint32_t note_id);
+
+/**
+ * Counters since boot and current size. May be called from any task; the
+ * values are read without locking and can be a moment out of date.
+ *
+ * @param stats Output: cache statistics
+ */
+void body_cache_get_stats(body_cache_stats_t *stats);
+
+#endif // BODY_CACHE_H
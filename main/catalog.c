@@ -0,0 +1,354 @@
+#include "catalog.h"
+#include "esp_log.h"
+#include "esp_heap_caps.h"
+#include <string.h>
+#include <stdlib.h>
+
+#define CATALOG_INITIAL_CAPACITY 64
+
+static const char *TAG = "catalog";
+
+// Metadata records ordered by note ID. IDs are zero-padded hex counters, so
+// string order matches creation order and new notes append at the end.
+static note_metadata_t *g_entries = NULL;
+static size_t g_count = 0;
+static size_t g_capacity = 0;
+static catalog_totals_t g_totals;
+static catalog_totals_t g_ns_totals[NAMESPACE_MAX];
+
+// Secondary index ordered by (timestamp, id) for time-ordered listing.
+// Same length as g_entries; holds keys only, metadata is looked up by ID.
+static catalog_pos_t *g_by_time = NULL;
+
+static void totals_apply(catalog_totals_t *totals, const note_metadata_t *meta, int sign)
+{
+    totals->count += sign;
+    totals->bytes += (int64_t)sign * meta->size;
+    if (meta->encrypted) {
+        totals->encrypted_count += sign;
+        totals->encrypted_bytes += (int64_t)sign * meta->size;
+    }
+}
+
+// Notes of a namespace unknown to this build still count in the overall totals
+static void totals_add(const note_metadata_t *meta)
+{
+    totals_apply(&g_totals, meta, 1);
+    if (meta->ns < NAMESPACE_MAX) {
+        totals_apply(&g_ns_totals[meta->ns], meta, 1);
+    }
+}
+
+static void totals_sub(const note_metadata_t *meta)
+{
+    totals_apply(&g_totals, meta, -1);
+    if (meta->ns < NAMESPACE_MAX) {
+        totals_apply(&g_ns_totals[meta->ns], meta, -1);
+    }
+}
+
+static esp_err_t ensure_capacity(size_t needed)
+{
+    if (needed <= g_capacity) {
+        return ESP_OK;
+    }
+
+    size_t new_capacity = g_capacity ? g_capacity * 2 : CATALOG_INITIAL_CAPACITY;
+    while (new_capacity < needed) {
+        new_capacity *= 2;
+    }
+
+    // Prefer PSRAM, fall back to internal RAM on boards without it
+    note_metadata_t *entries = heap_caps_realloc_prefer(g_entries,
+                                                        new_capacity * sizeof(note_metadata_t), 2,
+                                                        MALLOC_CAP_SPIRAM, MALLOC_CAP_DEFAULT);
+    if (!entries) {
+        ESP_LOGE(TAG, "Failed to grow catalog to %zu entries", new_capacity);
+        return ESP_ERR_NO_MEM;
+    }
+    g_entries = entries;
+
+    catalog_pos_t *by_time = heap_caps_realloc_prefer(g_by_time,
+                                                      new_capacity * sizeof(catalog_pos_t), 2,
+                                                      MALLOC_CAP_SPIRAM, MALLOC_CAP_DEFAULT);
+    if (!by_time) {
+        ESP_LOGE(TAG, "Failed to grow time index to %zu entries", new_capacity);
+        return ESP_ERR_NO_MEM;
+    }
+    g_by_time = by_time;
+
+    g_capacity = new_capacity;
+    return ESP_OK;
+}
+
+// Returns the index of note_id if present, otherwise the insertion point
+static size_t lower_bound(const char *note_id, bool *found)
+{
+    size_t lo = 0, hi = g_count;
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        int cmp = strcmp(g_entries[mid].id, note_id);
+        if (cmp < 0) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    *found = lo < g_count && strcmp(g_entries[lo].id, note_id) == 0;
+    return lo;
+}
+
+static int compare_entries(const void *a, const void *b)
+{
+    return strcmp(((const note_metadata_t *)a)->id, ((const note_metadata_t *)b)->id);
+}
+
+static int compare_pos(const void *a, const void *b)
+{
+    const catalog_pos_t *pa = a, *pb = b;
+    if (pa->ns != pb->ns) {
+        return pa->ns < pb->ns ? -1 : 1;
+    }
+    if (pa->timestamp != pb->timestamp) {
+        return pa->timestamp < pb->timestamp ? -1 : 1;
+    }
+    return strcmp(pa->id, pb->id);
+}
+
+static void pos_from_meta(const note_metadata_t *meta, catalog_pos_t *pos)
+{
+    pos->ns = meta->ns;
+    pos->timestamp = meta->timestamp;
+    memcpy(pos->id, meta->id, sizeof(pos->id));
+}
+
+// First time-index slot not ordered before pos
+static size_t time_lower_bound(const catalog_pos_t *pos)
+{
+    size_t lo = 0, hi = g_count;
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        if (compare_pos(&g_by_time[mid], pos) < 0) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    return lo;
+}
+
+// Insert into the time index, whose first g_count - 1 slots are filled
+static void time_insert(const note_metadata_t *meta)
+{
+    catalog_pos_t pos;
+    pos_from_meta(meta, &pos);
+
+    g_count--;
+    size_t at = (g_count == 0 || compare_pos(&g_by_time[g_count - 1], &pos) < 0)
+                    ? g_count : time_lower_bound(&pos);
+    memmove(&g_by_time[at + 1], &g_by_time[at], (g_count - at) * sizeof(catalog_pos_t));
+    g_by_time[at] = pos;
+    g_count++;
+}
+
+// Remove from the time index; g_count still includes the note
+static void time_remove(const note_metadata_t *meta)
+{
+    catalog_pos_t pos;
+    pos_from_meta(meta, &pos);
+
+    size_t at = time_lower_bound(&pos);
+    if (at < g_count && compare_pos(&g_by_time[at], &pos) == 0) {
+        memmove(&g_by_time[at], &g_by_time[at + 1], (g_count - at - 1) * sizeof(catalog_pos_t));
+    }
+}
+
+static void rebuild_time_index(void)
+{
+    for (size_t i = 0; i < g_count; i++) {
+        pos_from_meta(&g_entries[i], &g_by_time[i]);
+    }
+    if (g_count > 1) {
+        qsort(g_by_time, g_count, sizeof(catalog_pos_t), compare_pos);
+    }
+}
+
+esp_err_t catalog_init(void)
+{
+    g_count = 0;
+    memset(&g_totals, 0, sizeof(g_totals));
+    memset(g_ns_totals, 0, sizeof(g_ns_totals));
+    return ensure_capacity(CATALOG_INITIAL_CAPACITY);
+}
+
+esp_err_t catalog_insert(const note_metadata_t *meta)
+{
+    if (!meta) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    bool found = false;
+    size_t pos = g_count;
+
+    // Fast path: newly created notes carry the highest ID
+    if (g_count > 0 && strcmp(g_entries[g_count - 1].id, meta->id) >= 0) {
+        pos = lower_bound(meta->id, &found);
+    }
+
+    if (found) {
+        totals_sub(&g_entries[pos]);
+        time_remove(&g_entries[pos]);
+        g_entries[pos] = *meta;
+        totals_add(meta);
+        time_insert(meta);
+        return ESP_OK;
+    }
+
+    esp_err_t err = ensure_capacity(g_count + 1);
+    if (err != ESP_OK) {
+        return err;
+    }
+
+    memmove(&g_entries[pos + 1], &g_entries[pos], (g_count - pos) * sizeof(note_metadata_t));
+    g_entries[pos] = *meta;
+    g_count++;
+    totals_add(meta);
+    time_insert(meta);
+    return ESP_OK;
+}
+
+esp_err_t catalog_insert_unsorted(const note_metadata_t *meta)
+{
+    if (!meta) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    esp_err_t err = ensure_capacity(g_count + 1);
+    if (err != ESP_OK) {
+        return err;
+    }
+
+    g_entries[g_count++] = *meta;
+    totals_add(meta);
+    return ESP_OK;
+}
+
+void catalog_sort(void)
+{
+    if (g_count > 1) {
+        qsort(g_entries, g_count, sizeof(note_metadata_t), compare_entries);
+
+        // Engines may report a note twice (e.g. a record copied mid-compaction)
+        size_t out = 1;
+        for (size_t i = 1; i < g_count; i++) {
+            if (strcmp(g_entries[out - 1].id, g_entries[i].id) != 0) {
+                g_entries[out++] = g_entries[i];
+            }
+        }
+        g_count = out;
+    }
+
+    // Reconcile the running totals with what was actually loaded
+    memset(&g_totals, 0, sizeof(g_totals));
+    memset(g_ns_totals, 0, sizeof(g_ns_totals));
+    for (size_t i = 0; i < g_count; i++) {
+        totals_add(&g_entries[i]);
+    }
+
+    rebuild_time_index();
+}
+
+esp_err_t catalog_remove(const char *note_id)
+{
+    if (!note_id) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    bool found;
+    size_t pos = lower_bound(note_id, &found);
+    if (!found) {
+        return ESP_ERR_NOT_FOUND;
+    }
+
+    totals_sub(&g_entries[pos]);
+    time_remove(&g_entries[pos]);
+    memmove(&g_entries[pos], &g_entries[pos + 1], (g_count - pos - 1) * sizeof(note_metadata_t));
+    g_count--;
+    return ESP_OK;
+}
+
+const note_metadata_t *catalog_find(const char *note_id)
+{
+    if (!note_id || g_count == 0) {
+        return NULL;
+    }
+
+    bool found;
+    size_t pos = lower_bound(note_id, &found);
+    return found ? &g_entries[pos] : NULL;
+}
+
+const note_metadata_t *catalog_at(size_t index)
+{
+    return index < g_count ? &g_entries[index] : NULL;
+}
+
+size_t catalog_count(void)
+{
+    return g_count;
+}
+
+void catalog_get_totals(catalog_totals_t *totals)
+{
+    *totals = g_totals;
+}
+
+void catalog_get_ns_totals(uint8_t ns, catalog_totals_t *totals)
+{
+    if (ns < NAMESPACE_MAX) {
+        *totals = g_ns_totals[ns];
+    } else {
+        memset(totals, 0, sizeof(*totals));
+    }
+}
+
+size_t catalog_page(uint8_t ns, bool newest_first, const catalog_pos_t *after,
+                    note_metadata_t *notes, size_t max_notes, bool *more)
+{
+    size_t n = 0;
+    bool found;
+
+    // The namespace's run of the time index
+    catalog_pos_t edge = { .ns = ns };
+    size_t first = time_lower_bound(&edge);
+    size_t last = g_count;
+    if (ns < UINT8_MAX) {
+        edge.ns = ns + 1;
+        last = time_lower_bound(&edge);
+    }
+
+    if (newest_first) {
+        // Everything ordered before the cursor, walking backwards
+        size_t end = after ? time_lower_bound(after) : last;
+        end = end < first ? first : end > last ? last : end;
+        while (n < max_notes && end > first) {
+            size_t at = lower_bound(g_by_time[--end].id, &found);
+            notes[n++] = g_entries[at];
+        }
+        *more = end > first;
+    } else {
+        // Everything ordered after the cursor, walking forwards
+        size_t start = after ? time_lower_bound(after) : first;
+        if (after && start < g_count && compare_pos(&g_by_time[start], after) == 0) {
+            start++;
+        }
+        start = start < first ? first : start > last ? last : start;
+        while (n < max_notes && start < last) {
+            size_t at = lower_bound(g_by_time[start++].id, &found);
+            notes[n++] = g_entries[at];
+        }
+        *more = start < last;
+    }
+
+    return n;
+}
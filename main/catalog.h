@@ -0,0 +1,112 @@
+#ifndef CATALOG_H
+#define CATALOG_H
+
+#include "esp_err.h"
+#include "storage.h"
+#include <stddef.h>
+#include <stdint.h>
+
+// Running totals over all cataloged notes, or those of one namespace
+typedef struct {
+    uint32_t count;
+    uint32_t encrypted_count;
+    uint64_t bytes;
+    uint64_t encrypted_bytes;
+} catalog_totals_t;
+
+// Position in time order: notes sort by namespace, timestamp, then ID, so
+// each namespace is one contiguous run
+typedef struct {
+    uint8_t ns;
+    uint64_t timestamp;
+    char id[16];
+} catalog_pos_t;
+
+/**
+ * Initialize the in-memory note catalog (empty, allocated in PSRAM when available)
+ */
+esp_err_t catalog_init(void);
+
+/**
+ * Add a note's metadata to the catalog (or replace it if the ID already exists)
+ *
+ * @param meta Note metadata to insert
+ * @return ESP_OK on success, ESP_ERR_NO_MEM if the catalog cannot grow
+ */
+esp_err_t catalog_insert(const note_metadata_t *meta);
+
+/**
+ * Append metadata without keeping the catalog ordered (boot-time bulk load).
+ * catalog_sort() must be called before any lookup.
+ *
+ * @param meta Note metadata to append
+ * @return ESP_OK on success, ESP_ERR_NO_MEM if the catalog cannot grow
+ */
+esp_err_t catalog_insert_unsorted(const note_metadata_t *meta);
+
+/**
+ * Sort the catalog after a batch of catalog_insert_unsorted() calls,
+ * dropping duplicate IDs and recomputing the running totals
+ */
+void catalog_sort(void);
+
+/**
+ * Remove a note from the catalog
+ *
+ * @param note_id Note ID
+ * @return ESP_OK on success, ESP_ERR_NOT_FOUND if the note is not cataloged
+ */
+esp_err_t catalog_remove(const char *note_id);
+
+/**
+ * Look up a note's metadata
+ *
+ * @param note_id Note ID
+ * @return Pointer into the catalog (valid until the next insert/remove), or NULL
+ */
+const note_metadata_t *catalog_find(const char *note_id);
+
+/**
+ * Get the entry at a position in note ID order
+ *
+ * @param index Position (0 = oldest note)
+ * @return Pointer into the catalog (valid until the next insert/remove), or NULL
+ */
+const note_metadata_t *catalog_at(size_t index);
+
+/**
+ * Number of cataloged notes
+ */
+size_t catalog_count(void);
+
+/**
+ * Get note count and byte totals (maintained incrementally, O(1))
+ *
+ * @param totals Output: running totals
+ */
+void catalog_get_totals(catalog_totals_t *totals);
+
+/**
+ * Get one namespace's note count and byte totals (O(1))
+ *
+ * @param ns Namespace (below NAMESPACE_MAX)
+ * @param totals Output: running totals
+ */
+void catalog_get_ns_totals(uint8_t ns, catalog_totals_t *totals);
+
+/**
+ * Copy one page of a namespace's metadata in time order. Cost depends on
+ * the page size, not on how many notes other namespaces hold.
+ *
+ * @param ns Namespace
+ * @param newest_first true for descending (newest first), false for ascending
+ * @param after Resume after this position (exclusive, same namespace), or NULL for the first page
+ * @param notes Output array
+ * @param max_notes Page size
+ * @param more Output: true if further notes follow this page
+ * @return Number of entries copied
+ */
+size_t catalog_page(uint8_t ns, bool newest_first, const catalog_pos_t *after,
+                    note_metadata_t *notes, size_t max_notes, bool *more);
+
+#endif // CATALOG_H
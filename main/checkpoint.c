@@ -0,0 +1,254 @@
+#include "checkpoint.h"
+#include "catalog.h"
+#include "note_meta.h"
+#include "esp_log.h"
+#include "esp_rom_crc.h"
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <inttypes.h>
+#include <sys/stat.h>
+
+#define SNAPSHOT_MAGIC 0x58494444  // "DDIX"
+#define SNAPSHOT_PATH STORAGE_BASE_PATH "/index.snap"
+#define SNAPSHOT_TMP_PATH STORAGE_BASE_PATH "/index.tmp"
+#define JOURNAL_PATH STORAGE_BASE_PATH "/index.jnl"
+
+// The snapshot is the catalog as note_meta_record_t entries, then this trailer.
+// The journal is a plain sequence of entries; deletes carry NOTE_META_FLAG_DELETED.
+typedef struct __attribute__((packed)) {
+    uint32_t magic;
+    uint32_t count;
+    uint32_t probe_from;
+    uint32_t crc;  // CRC32 of all entries
+} snapshot_trailer_t;
+
+static const char *TAG = "checkpoint";
+static FILE *g_journal = NULL;
+static uint32_t g_journal_entries = 0;
+static bool g_journal_torn = false;
+
+static esp_err_t open_journal(bool truncate)
+{
+    if (g_journal) {
+        fclose(g_journal);
+    }
+    g_journal = fopen(JOURNAL_PATH, truncate ? "wb" : "ab");
+    if (!g_journal) {
+        ESP_LOGE(TAG, "Failed to open journal (errno=%d)", errno);
+        return ESP_FAIL;
+    }
+    return ESP_OK;
+}
+
+// Without a trustworthy journal the snapshot could resurrect deleted notes,
+// so drop both and let the next boot scan the engine instead
+static void drop_checkpoint(void)
+{
+    if (g_journal) {
+        fclose(g_journal);
+        g_journal = NULL;
+    }
+    unlink(SNAPSHOT_PATH);
+    unlink(JOURNAL_PATH);
+    ESP_LOGW(TAG, "Index checkpoint dropped, next boot does a full scan");
+}
+
+static esp_err_t load_snapshot(uint32_t *probe_from)
+{
+    FILE *f = fopen(SNAPSHOT_PATH, "rb");
+    if (!f) {
+        return ESP_ERR_NOT_FOUND;
+    }
+
+    snapshot_trailer_t trailer;
+    if (fseek(f, -(long)sizeof(trailer), SEEK_END) != 0 ||
+        fread(&trailer, 1, sizeof(trailer), f) != sizeof(trailer) ||
+        trailer.magic != SNAPSHOT_MAGIC ||
+        ftell(f) != (long)(sizeof(trailer) + trailer.count * sizeof(note_meta_record_t))) {
+        fclose(f);
+        return ESP_ERR_INVALID_SIZE;
+    }
+    fseek(f, 0, SEEK_SET);
+
+    esp_err_t err = ESP_OK;
+    uint32_t crc = 0;
+    for (uint32_t i = 0; i < trailer.count && err == ESP_OK; i++) {
+        note_meta_record_t rec;
+        note_metadata_t meta;
+        bool outdated;
+        if (fread(&rec, 1, sizeof(rec), f) != sizeof(rec)) {
+            err = ESP_ERR_INVALID_SIZE;
+            break;
+        }
+        crc = esp_rom_crc32_le(crc, (const uint8_t *)&rec, sizeof(rec));
+        err = note_meta_decode(&rec, sizeof(rec), &meta, &outdated);
+        if (err == ESP_OK) {
+            err = catalog_insert_unsorted(&meta);
+        }
+    }
+    fclose(f);
+
+    if (err == ESP_OK && crc != trailer.crc) {
+        err = ESP_ERR_INVALID_CRC;
+    }
+    if (err == ESP_OK) {
+        *probe_from = trailer.probe_from;
+    }
+    return err;
+}
+
+static void replay_journal(checkpoint_purge_cb_t purge)
+{
+    FILE *f = fopen(JOURNAL_PATH, "rb");
+    if (!f) {
+        return;
+    }
+
+    note_meta_record_t rec;
+    size_t len;
+    while ((len = fread(&rec, 1, sizeof(rec), f)) > 0) {
+        note_metadata_t meta;
+        bool outdated;
+        if (note_meta_decode(&rec, len, &meta, &outdated) != ESP_OK) {
+            // Power cut mid-append; nothing may be appended after this
+            g_journal_torn = true;
+            break;
+        }
+
+        if (rec.flags & NOTE_META_FLAG_DELETED) {
+            catalog_remove(meta.id);
+            purge(&meta);
+        } else {
+            catalog_insert(&meta);
+        }
+        g_journal_entries++;
+    }
+    fclose(f);
+}
+
+esp_err_t checkpoint_load(checkpoint_purge_cb_t purge, uint32_t *probe_from)
+{
+    // A power cut between replacing the old snapshot and renaming the new
+    // one leaves only the (complete) temporary file
+    struct stat st;
+    if (stat(SNAPSHOT_PATH, &st) != 0 && stat(SNAPSHOT_TMP_PATH, &st) == 0) {
+        rename(SNAPSHOT_TMP_PATH, SNAPSHOT_PATH);
+    }
+
+    esp_err_t err = load_snapshot(probe_from);
+    if (err != ESP_OK) {
+        if (err != ESP_ERR_NOT_FOUND) {
+            ESP_LOGW(TAG, "Ignoring unreadable snapshot: %s", esp_err_to_name(err));
+        }
+        return ESP_ERR_NOT_FOUND;
+    }
+    catalog_sort();
+
+    g_journal_entries = 0;
+    g_journal_torn = false;
+    replay_journal(purge);
+    ESP_LOGI(TAG, "Loaded %zu notes from snapshot and %" PRIu32 " journal entries",
+             catalog_count(), g_journal_entries);
+
+    return open_journal(false);
+}
+
+esp_err_t checkpoint_write(uint32_t probe_from)
+{
+    FILE *f = fopen(SNAPSHOT_TMP_PATH, "wb");
+    if (!f) {
+        ESP_LOGE(TAG, "Failed to create snapshot (errno=%d)", errno);
+        return ESP_FAIL;
+    }
+
+    snapshot_trailer_t trailer = {
+        .magic = SNAPSHOT_MAGIC,
+        .count = catalog_count(),
+        .probe_from = probe_from,
+    };
+    bool ok = true;
+    for (uint32_t i = 0; i < trailer.count && ok; i++) {
+        note_meta_record_t rec;
+        note_meta_encode(catalog_at(i), &rec);
+        trailer.crc = esp_rom_crc32_le(trailer.crc, (const uint8_t *)&rec, sizeof(rec));
+        ok = fwrite(&rec, 1, sizeof(rec), f) == sizeof(rec);
+    }
+    ok = ok && fwrite(&trailer, 1, sizeof(trailer), f) == sizeof(trailer) &&
+         fflush(f) == 0 && fsync(fileno(f)) == 0;
+    ok = fclose(f) == 0 && ok;
+    if (!ok) {
+        ESP_LOGE(TAG, "Failed to write snapshot (errno=%d)", errno);
+        unlink(SNAPSHOT_TMP_PATH);
+        return ESP_FAIL;
+    }
+
+    unlink(SNAPSHOT_PATH);
+    if (rename(SNAPSHOT_TMP_PATH, SNAPSHOT_PATH) != 0) {
+        ESP_LOGE(TAG, "Failed to rename snapshot (errno=%d)", errno);
+        drop_checkpoint();
+        return ESP_FAIL;
+    }
+
+    // Everything journaled so far is in the snapshot
+    g_journal_entries = 0;
+    g_journal_torn = false;
+    ESP_LOGI(TAG, "Checkpointed %" PRIu32 " notes", trailer.count);
+    return open_journal(true);
+}
+
+static esp_err_t append_entry(const note_meta_record_t *rec)
+{
+    if (!g_journal) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    if (fwrite(rec, 1, sizeof(*rec), g_journal) != sizeof(*rec)) {
+        ESP_LOGE(TAG, "Failed to append to journal (errno=%d)", errno);
+        drop_checkpoint();
+        return ESP_FAIL;
+    }
+    g_journal_entries++;
+    return ESP_OK;
+}
+
+esp_err_t checkpoint_log_put(const note_metadata_t *meta)
+{
+    note_meta_record_t rec;
+    note_meta_encode(meta, &rec);
+    return append_entry(&rec);
+}
+
+esp_err_t checkpoint_log_delete(const note_metadata_t *meta)
+{
+    note_meta_record_t rec;
+    note_meta_encode(meta, &rec);
+    note_meta_mark_deleted(&rec);
+    return append_entry(&rec);
+}
+
+esp_err_t checkpoint_sync(void)
+{
+    if (!g_journal) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    if (fflush(g_journal) != 0 || fsync(fileno(g_journal)) != 0) {
+        ESP_LOGE(TAG, "Failed to sync journal (errno=%d)", errno);
+        drop_checkpoint();
+        return ESP_FAIL;
+    }
+    return ESP_OK;
+}
+
+bool checkpoint_due(void)
+{
+    if (!g_journal) {
+        return true;
+    }
+
+    // Snapshots rewrite the whole catalog, so let the journal grow with it
+    size_t limit = catalog_count() / 4;
+    if (limit < CHECKPOINT_JOURNAL_MIN) {
+        limit = CHECKPOINT_JOURNAL_MIN;
+    }
+    return g_journal_torn || g_journal_entries >= limit;
+}
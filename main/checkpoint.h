@@ -0,0 +1,65 @@
+#ifndef CHECKPOINT_H
+#define CHECKPOINT_H
+
+#include "esp_err.h"
+#include "storage.h"
+#include <stdint.h>
+#include <stdbool.h>
+
+/**
+ * Callback for notes the journal records as deleted, so that files left
+ * behind by an interrupted delete can be removed
+ */
+typedef esp_err_t (*checkpoint_purge_cb_t)(const note_metadata_t *meta);
+
+/**
+ * Rebuild the catalog from the last snapshot plus the journal written since.
+ * Opens the journal for appending.
+ *
+ * @param purge Called for every delete replayed from the journal
+ * @param probe_from Output: notes with this ID or higher may be on flash
+ *                   without a journal entry and need checking
+ * @return ESP_OK on success, ESP_ERR_NOT_FOUND if there is no usable snapshot
+ */
+esp_err_t checkpoint_load(checkpoint_purge_cb_t purge, uint32_t *probe_from);
+
+/**
+ * Snapshot the whole catalog and start an empty journal
+ *
+ * @param probe_from Lowest note ID that is not settled (created or abandoned)
+ * @return ESP_OK on success
+ */
+esp_err_t checkpoint_write(uint32_t probe_from);
+
+/**
+ * Append a created note to the journal (durable after checkpoint_sync).
+ * On any journal failure the checkpoint is dropped, so the next boot falls
+ * back to a full engine load.
+ *
+ * @param meta Note metadata
+ * @return ESP_OK on success
+ */
+esp_err_t checkpoint_log_put(const note_metadata_t *meta);
+
+/**
+ * Append a deleted note to the journal (durable after checkpoint_sync)
+ *
+ * @param meta Note metadata
+ * @return ESP_OK on success
+ */
+esp_err_t checkpoint_log_delete(const note_metadata_t *meta);
+
+/**
+ * Flush journal entries appended since the last call
+ *
+ * @return ESP_OK on success
+ */
+esp_err_t checkpoint_sync(void);
+
+/**
+ * Whether the journal has grown enough that a new snapshot pays off, or
+ * there is no usable checkpoint at all
+ */
+bool checkpoint_due(void);
+
+#endif // CHECKPOINT_H
@@ -17,12 +17,63 @@
 #define BLE_DISCONNECT_GRACE_PERIOD_SEC 15
 
 // Storage limits
-#define MAX_NOTE_SIZE_BYTES 4096
+#define MAX_NOTE_SIZE_BYTES 4096  // Largest JSON-encoded note (POST application/json)
+#define MAX_UPLOAD_SIZE_BYTES (8 * 1024 * 1024)  // Largest streamed note (POST application/octet-stream)
+#define UPLOAD_CHUNK_SIZE 4096  // Request body bytes received per httpd_req_recv
 #define MAX_NOTE_COUNT 0  // 0 = unlimited, fills naturally
 #define MAX_TITLE_LENGTH 128
-#define SPIFFS_BASE_PATH "/spiffs"
-#define SPIFFS_PARTITION_LABEL "storage"
-#define SPIFFS_MAX_FILES 10
+#define STORAGE_BASE_PATH "/storage"  // Mount point of the storage backend
+#define STORAGE_PARTITION_LABEL "storage"
+#define STORAGE_MAX_FILES 10
+#define NOTE_ID_BLOCK_SIZE 64  // Note IDs reserved per NVS commit
+#define LIST_PAGE_DEFAULT 20   // GET /api/notes page size without ?limit
+#define LIST_PAGE_MAX 100      // Largest ?limit accepted
+#define STORAGE_COMPRESS_PLAINTEXT 1   // Deflate unencrypted note bodies on flash
+#define STORAGE_COMPRESS_MIN_SIZE 128  // Shorter bodies are stored as-is
+#define CHECKPOINT_JOURNAL_MIN 256  // Index journal entries before a new snapshot is written
+
+// PSRAM cache of recently read note bodies
+#define BODY_CACHE_BYTES (1024 * 1024)
+#define BODY_CACHE_MAX_NOTE (64 * 1024)  // Larger bodies are always streamed from flash
+#define BODY_CACHE_MAX_ENTRIES 128
+#define BODY_CACHE_WARM_NOTES 16  // Newest notes loaded when the AP comes up
+
+// Self-destructing notes
+#define EXPIRY_MAX_TTL_S (365 * 24 * 3600)  // Longest TTL accepted on create
+#define EXPIRY_CLOCK_VALID_AFTER 1704067200  // 2024-01-01; an earlier clock was never set
+#define EXPIRY_SWEEP_BATCH 16    // Expired notes deleted before queued requests get a turn
+#define EXPIRY_CHECK_MAX_S 60    // Longest sleep between expiry checks
+
+// Full-text search over titles and plaintext bodies (GET /api/search)
+#define SEARCH_MAX_WORDS_PER_NOTE 256  // Distinct words indexed per note (power of two)
+#define SEARCH_MAX_QUERY_WORDS 8
+#define SEARCH_MAX_QUERY_LEN 128
+#define SEARCH_SAVE_MIN 64   // Index changes before the index is saved to flash...
+#define SEARCH_SAVE_MAX 512  // ...scaled with the note count up to this many
+
+// Storage worker task: all flash I/O runs here, off the WiFi/BLE core (0)
+#define STORAGE_TASK_CORE 1
+#define STORAGE_TASK_PRIORITY 5
+#define STORAGE_TASK_STACK_SIZE 6144
+#define STORAGE_QUEUE_LENGTH 16
+#define STORAGE_GROUP_COMMIT_MAX 8  // Queued note writes made durable by one sync
+#define RECLAIM_IDLE_MS 500  // Queue idle time before deleted notes are removed from flash
+#define RECLAIM_BATCH 8      // Deleted notes removed per idle period
+#define FS_GC_IDLE_MS 500    // Queue idle time before filesystem GC runs
+#define FS_GC_BUDGET_MS 50   // GC time per idle period; checked between steps
+#define FS_GC_STEP (16 * 1024)        // Extra space asked of the filesystem per GC step
+#define FS_GC_HEADROOM (256 * 1024)   // Space kept ready so creates do not GC inline
+#define STORAGE_LATENCY_BUCKETS 16    // Commit latency histogram: <1 ms, <2 ms, ... <16 s
+#define IMPORT_BATCH_NOTES 4  // Archive notes committed together (each holds a writer open until then)
+#define STORAGE_MAX_APPENDS 4  // Notes that can be appended to at the same time
+#define NAMESPACE_MAX 16       // Namespaces including the default one
+#define NAMESPACE_NAME_LEN 16  // Including the terminator
+
+// Storage engine tuning; the engine itself is chosen in menuconfig
+#define SLOT_PARTITION_LABEL "notes"
+#define LOG_SEGMENT_SIZE (256 * 1024)
+#define LOG_MAX_SEGMENTS 64
+#define LOG_COMPACT_THRESHOLD_PCT 50  // Compact sealed segments at least this % dead
 
 // Error handling
 #define ERROR_LED_GPIO 2  // Built-in LED on most ESP32-S3 boards
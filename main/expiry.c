@@ -0,0 +1,143 @@
+#include "expiry.h"
+#include "catalog.h"
+#include "esp_log.h"
+#include "esp_heap_caps.h"
+#include <string.h>
+#include <stdlib.h>
+
+#define EXPIRY_INITIAL_CAPACITY 64
+
+typedef struct {
+    uint64_t expires_at;
+    uint32_t id;
+} expiry_entry_t;
+
+static const char *TAG = "expiry";
+
+// Binary min-heap on expires_at: the sweeper touches only notes that are due
+static expiry_entry_t *g_heap = NULL;
+static size_t g_count = 0;
+static size_t g_capacity = 0;
+
+static esp_err_t ensure_capacity(size_t needed)
+{
+    if (needed <= g_capacity) {
+        return ESP_OK;
+    }
+
+    size_t capacity = g_capacity ? g_capacity * 2 : EXPIRY_INITIAL_CAPACITY;
+    while (capacity < needed) {
+        capacity *= 2;
+    }
+    expiry_entry_t *heap = heap_caps_realloc_prefer(g_heap, capacity * sizeof(expiry_entry_t), 2,
+                                                    MALLOC_CAP_SPIRAM, MALLOC_CAP_DEFAULT);
+    if (!heap) {
+        ESP_LOGE(TAG, "Failed to grow expiry queue to %zu entries", capacity);
+        return ESP_ERR_NO_MEM;
+    }
+    g_heap = heap;
+    g_capacity = capacity;
+    return ESP_OK;
+}
+
+static void swap(size_t a, size_t b)
+{
+    expiry_entry_t tmp = g_heap[a];
+    g_heap[a] = g_heap[b];
+    g_heap[b] = tmp;
+}
+
+static void sift_up(size_t i)
+{
+    while (i > 0) {
+        size_t parent = (i - 1) / 2;
+        if (g_heap[parent].expires_at <= g_heap[i].expires_at) {
+            break;
+        }
+        swap(parent, i);
+        i = parent;
+    }
+}
+
+static void sift_down(size_t i)
+{
+    while (1) {
+        size_t smallest = i;
+        size_t left = 2 * i + 1, right = left + 1;
+        if (left < g_count && g_heap[left].expires_at < g_heap[smallest].expires_at) {
+            smallest = left;
+        }
+        if (right < g_count && g_heap[right].expires_at < g_heap[smallest].expires_at) {
+            smallest = right;
+        }
+        if (smallest == i) {
+            break;
+        }
+        swap(i, smallest);
+        i = smallest;
+    }
+}
+
+esp_err_t expiry_init(void)
+{
+    g_count = 0;
+    for (size_t i = 0; i < catalog_count(); i++) {
+        const note_metadata_t *meta = catalog_at(i);
+        if (meta->expires_at == 0) {
+            continue;
+        }
+        esp_err_t err = ensure_capacity(g_count + 1);
+        if (err != ESP_OK) {
+            return err;
+        }
+        g_heap[g_count++] = (expiry_entry_t){
+            .expires_at = meta->expires_at, .id = (uint32_t)strtoul(meta->id, NULL, 16)
+        };
+    }
+
+    // Bottom-up heapify is linear in the number of expiring notes
+    for (size_t i = g_count / 2; i-- > 0;) {
+        sift_down(i);
+    }
+
+    if (g_count > 0) {
+        ESP_LOGI(TAG, "Tracking %zu expiring notes", g_count);
+    }
+    return ESP_OK;
+}
+
+esp_err_t expiry_add(const note_metadata_t *meta)
+{
+    if (meta->expires_at == 0) {
+        return ESP_OK;
+    }
+
+    esp_err_t err = ensure_capacity(g_count + 1);
+    if (err != ESP_OK) {
+        return err;
+    }
+    g_heap[g_count] = (expiry_entry_t){
+        .expires_at = meta->expires_at, .id = (uint32_t)strtoul(meta->id, NULL, 16)
+    };
+    sift_up(g_count++);
+    return ESP_OK;
+}
+
+bool expiry_peek(uint64_t *expires_at, uint32_t *note_id)
+{
+    if (g_count == 0) {
+        return false;
+    }
+    *expires_at = g_heap[0].expires_at;
+    *note_id = g_heap[0].id;
+    return true;
+}
+
+void expiry_pop(void)
+{
+    if (g_count == 0) {
+        return;
+    }
+    g_heap[0] = g_heap[--g_count];
+    sift_down(0);
+}
@@ -0,0 +1,39 @@
+#ifndef EXPIRY_H
+#define EXPIRY_H
+
+#include "esp_err.h"
+#include "storage.h"
+#include <stdint.h>
+#include <stdbool.h>
+
+/**
+ * Rebuild the expiry queue from every cataloged note that has an expiry time
+ *
+ * @return ESP_OK on success, ESP_ERR_NO_MEM
+ */
+esp_err_t expiry_init(void);
+
+/**
+ * Track a note's expiry time (notes without one are ignored)
+ *
+ * @param meta Note metadata
+ * @return ESP_OK on success, ESP_ERR_NO_MEM
+ */
+esp_err_t expiry_add(const note_metadata_t *meta);
+
+/**
+ * Earliest tracked expiry. Entries are not removed when a note is deleted,
+ * so callers must check the note still exists with the same expiry time.
+ *
+ * @param expires_at Output: expiry time
+ * @param note_id Output: numeric note ID
+ * @return true if anything is tracked
+ */
+bool expiry_peek(uint64_t *expires_at, uint32_t *note_id);
+
+/**
+ * Drop the entry returned by expiry_peek
+ */
+void expiry_pop(void);
+
+#endif // EXPIRY_H
@@ -30,6 +30,9 @@ static void on_ble_connect(void)
     ESP_LOGI(TAG, "BLE connected");
     ble_connected = true;
 
+    // A client is coming; keep flash free for its requests
+    storage_set_maintenance(false);
+
     // Cancel grace period if it's running
     if (xTimerIsTimerActive(grace_period_timer)) {
         xTimerStop(grace_period_timer, 0);
@@ -86,6 +89,9 @@ static void enable_wifi(void)
 
     wifi_active = true;
     ESP_LOGI(TAG, "WiFi AP enabled");
+
+    // Clients usually open recent notes first
+    storage_warm_cache();
     ESP_LOGI(TAG, "Connect to WiFi: %s", WIFI_AP_SSID);
     ESP_LOGI(TAG, "Open browser to: https://%s", WIFI_AP_IP);
 }
@@ -107,6 +113,9 @@ static void disable_wifi(void)
 
     wifi_active = false;
     ESP_LOGI(TAG, "Returned to BLE-only mode");
+
+    // Nobody is around until the next BLE connection
+    storage_set_maintenance(true);
 }
 
 void app_main(void)
@@ -122,7 +131,7 @@ void app_main(void)
     error_init();
     ESP_LOGI(TAG, "Error handler initialized");
 
-    // Initialize storage (NVS + SPIFFS)
+    // Initialize storage (NVS + storage filesystem)
     if (storage_init() != ESP_OK) {
         error_halt("Failed to initialize storage");
     }
@@ -154,6 +163,8 @@ void app_main(void)
     ble_set_connect_callback(on_ble_connect);
     ble_set_disconnect_callback(on_ble_disconnect);
 
+    storage_set_maintenance(true);
+
     ESP_LOGI(TAG, "=== DeadDrop Ready (BLE-only mode) ===");
     ESP_LOGI(TAG, "Connect via BLE to '%s' to enable WiFi AP", DEVICE_NAME_BLE);
 
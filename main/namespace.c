@@ -0,0 +1,120 @@
+#include "namespace.h"
+#include "constants.h"
+#include "esp_log.h"
+#include <string.h>
+#include <stdio.h>
+#include <unistd.h>
+#include <errno.h>
+
+#define NAMESPACE_PATH STORAGE_BASE_PATH "/namespaces.tbl"
+#define NAMESPACE_TMP_PATH STORAGE_BASE_PATH "/namespaces.tmp"
+
+static const char *TAG = "namespace";
+
+// Names by number; an empty name is a free slot. The file holds the same
+// table, rewritten whole when a namespace is added (rare).
+static char g_names[NAMESPACE_MAX][NAMESPACE_NAME_LEN];
+
+static bool valid_name(const char *name)
+{
+    size_t len = strlen(name);
+    if (len == 0 || len >= NAMESPACE_NAME_LEN) {
+        return false;
+    }
+    for (size_t i = 0; i < len; i++) {
+        char c = name[i];
+        if (!((c >= 'a' && c <= 'z') || (c >= '0' && c <= '9') || c == '-' || c == '_')) {
+            return false;
+        }
+    }
+    return true;
+}
+
+esp_err_t namespace_init(void)
+{
+    memset(g_names, 0, sizeof(g_names));
+
+    // A power cut between the unlink and the rename leaves only the new table
+    FILE *f = fopen(NAMESPACE_PATH, "rb");
+    if (!f && rename(NAMESPACE_TMP_PATH, NAMESPACE_PATH) == 0) {
+        f = fopen(NAMESPACE_PATH, "rb");
+    }
+    if (f) {
+        size_t len = fread(g_names, 1, sizeof(g_names), f);
+        fclose(f);
+        if (len % NAMESPACE_NAME_LEN != 0) {
+            ESP_LOGW(TAG, "Namespace table truncated at %zu bytes", len);
+        }
+    }
+    unlink(NAMESPACE_TMP_PATH);
+
+    size_t count = 0;
+    for (size_t i = 1; i < NAMESPACE_MAX; i++) {
+        g_names[i][NAMESPACE_NAME_LEN - 1] = '\0';
+        if (g_names[i][0] != '\0') {
+            count++;
+        }
+    }
+    strcpy(g_names[0], NAMESPACE_DEFAULT_NAME);
+    if (count > 0) {
+        ESP_LOGI(TAG, "%zu namespaces besides the default one", count);
+    }
+    return ESP_OK;
+}
+
+static esp_err_t save_names(void)
+{
+    FILE *f = fopen(NAMESPACE_TMP_PATH, "wb");
+    if (!f) {
+        ESP_LOGE(TAG, "Failed to create %s (errno=%d)", NAMESPACE_TMP_PATH, errno);
+        return ESP_FAIL;
+    }
+    size_t written = fwrite(g_names, 1, sizeof(g_names), f);
+    if (fclose(f) != 0 || written != sizeof(g_names)) {
+        unlink(NAMESPACE_TMP_PATH);
+        return ESP_FAIL;
+    }
+
+    unlink(NAMESPACE_PATH);
+    if (rename(NAMESPACE_TMP_PATH, NAMESPACE_PATH) != 0) {
+        ESP_LOGE(TAG, "Failed to rename %s (errno=%d)", NAMESPACE_TMP_PATH, errno);
+        return ESP_FAIL;
+    }
+    return ESP_OK;
+}
+
+esp_err_t namespace_find(const char *name, bool create, uint8_t *ns)
+{
+    if (!name || !valid_name(name)) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    int free_slot = -1;
+    for (int i = 0; i < NAMESPACE_MAX; i++) {
+        if (strcmp(g_names[i], name) == 0) {
+            *ns = (uint8_t)i;
+            return ESP_OK;
+        }
+        if (g_names[i][0] == '\0' && free_slot < 0) {
+            free_slot = i;
+        }
+    }
+    if (!create) {
+        return ESP_ERR_NOT_FOUND;
+    }
+    if (free_slot < 0) {
+        ESP_LOGE(TAG, "All %d namespaces are in use", NAMESPACE_MAX);
+        return ESP_ERR_NO_MEM;
+    }
+
+    // Saved before any note can refer to it
+    strcpy(g_names[free_slot], name);
+    esp_err_t err = save_names();
+    if (err != ESP_OK) {
+        g_names[free_slot][0] = '\0';
+        return err;
+    }
+    ESP_LOGI(TAG, "Created namespace %s (%d)", name, free_slot);
+    *ns = (uint8_t)free_slot;
+    return ESP_OK;
+}
@@ -0,0 +1,34 @@
+#ifndef NAMESPACE_H
+#define NAMESPACE_H
+
+#include "esp_err.h"
+#include <stdint.h>
+#include <stdbool.h>
+
+// Name of namespace 0 (STORAGE_NS_DEFAULT), which holds every note created
+// without one
+#define NAMESPACE_DEFAULT_NAME "default"
+
+/**
+ * Load the namespace names from the storage filesystem
+ *
+ * @return ESP_OK on success (also when none were created yet)
+ */
+esp_err_t namespace_init(void);
+
+/**
+ * Map a namespace name to its number, optionally creating it. Names are 1 to
+ * NAMESPACE_NAME_LEN - 1 characters from a-z, 0-9, '-' and '_'. A created
+ * namespace is saved before this returns.
+ *
+ * @param name Namespace name
+ * @param create Create the namespace if it does not exist
+ * @param ns Output: namespace number
+ * @return ESP_OK on success, ESP_ERR_INVALID_ARG for a malformed name,
+ *         ESP_ERR_NOT_FOUND if it does not exist and create is false,
+ *         ESP_ERR_NO_MEM if NAMESPACE_MAX namespaces exist, ESP_FAIL if it
+ *         could not be saved
+ */
+esp_err_t namespace_find(const char *name, bool create, uint8_t *ns);
+
+#endif // NAMESPACE_H
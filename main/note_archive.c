@@ -0,0 +1,398 @@
+#include "note_archive.h"
+#include "note_meta.h"
+#include "constants.h"
+#include "esp_log.h"
+#include "esp_rom_crc.h"
+#include <string.h>
+#include <stdlib.h>
+#include <time.h>
+#include <inttypes.h>
+
+#define EXPORT_PAGE_NOTES 8
+
+typedef enum {
+    EXPORT_HEADER,
+    EXPORT_NEXT,  // Open the next note and emit its metadata
+    EXPORT_BODY,
+    EXPORT_DONE,
+} export_state_t;
+
+struct note_export {
+    uint8_t ns;
+    export_state_t state;
+    note_metadata_t page[EXPORT_PAGE_NOTES];
+    size_t page_count;
+    size_t page_pos;
+    char cursor[STORAGE_CURSOR_LEN];
+    bool listed_all;
+
+    storage_reader_t reader;
+    bool reader_open;
+    uint32_t remaining;
+    uint32_t crc;
+    uint32_t count;
+
+    // Fixed-size pieces (header, metadata, CRC, end) waiting to be copied out
+    uint8_t pending[sizeof(note_meta_record_t)];
+    size_t pending_len;
+    size_t pending_pos;
+};
+
+typedef enum {
+    IMPORT_HEADER,
+    IMPORT_MAGIC,  // Metadata record or end marker, told apart by the magic
+    IMPORT_META,
+    IMPORT_BODY,
+    IMPORT_CRC,
+    IMPORT_END,
+    IMPORT_DONE,
+} import_state_t;
+
+struct note_import {
+    uint8_t ns;
+    import_state_t state;
+    uint8_t stage[sizeof(note_meta_record_t)];
+    size_t staged;
+
+    note_metadata_t meta;
+    bool skip;  // Expired: body is checked but not stored
+    uint32_t remaining;
+    uint32_t crc;
+    uint32_t seen;
+
+    // Finished notes waiting for a batched commit; the next slot is the one being written
+    storage_writer_t batch[IMPORT_BATCH_NOTES];
+    size_t batch_count;
+    bool writing;
+
+    uint32_t imported;
+    uint32_t skipped;
+};
+
+static const char *TAG = "note_archive";
+
+// Export
+
+esp_err_t note_export_begin(uint8_t ns, note_export_t **exp)
+{
+    *exp = calloc(1, sizeof(note_export_t));
+    if (!*exp) {
+        return ESP_ERR_NO_MEM;
+    }
+    (*exp)->ns = ns;
+    return ESP_OK;
+}
+
+static void export_stage(note_export_t *exp, const void *data, size_t len)
+{
+    memcpy(exp->pending, data, len);
+    exp->pending_len = len;
+    exp->pending_pos = 0;
+}
+
+// Open the next listed note; *opened stays false once every note has been exported
+static esp_err_t export_open_next(note_export_t *exp, bool *opened)
+{
+    *opened = false;
+    while (!*opened) {
+        if (exp->page_pos == exp->page_count) {
+            if (exp->listed_all) {
+                return ESP_OK;
+            }
+            esp_err_t err = storage_list_notes(exp->ns, STORAGE_ORDER_OLDEST_FIRST, exp->cursor,
+                                               exp->page, EXPORT_PAGE_NOTES, &exp->page_count,
+                                               exp->cursor);
+            if (err != ESP_OK) {
+                return err;
+            }
+            exp->page_pos = 0;
+            exp->listed_all = exp->cursor[0] == '\0';
+            continue;
+        }
+
+        // Notes deleted since the page was listed are left out
+        note_metadata_t meta;
+        esp_err_t err = storage_open_note(exp->ns, exp->page[exp->page_pos++].id, &meta,
+                                          &exp->reader);
+        if (err == ESP_ERR_NOT_FOUND) {
+            continue;
+        }
+        if (err != ESP_OK) {
+            return err;
+        }
+
+        // The body is exported as read, i.e. decompressed
+        meta.compressed = false;
+        note_meta_record_t rec;
+        note_meta_encode(&meta, &rec);
+        export_stage(exp, &rec, sizeof(rec));
+        exp->reader_open = true;
+        exp->remaining = meta.size;
+        exp->crc = 0;
+        *opened = true;
+    }
+    return ESP_OK;
+}
+
+esp_err_t note_export_read(note_export_t *exp, char *buf, size_t buf_len, size_t *len)
+{
+    size_t produced = 0;
+    esp_err_t err = ESP_OK;
+
+    while (produced < buf_len && err == ESP_OK) {
+        if (exp->pending_pos < exp->pending_len) {
+            size_t n = exp->pending_len - exp->pending_pos;
+            n = n < buf_len - produced ? n : buf_len - produced;
+            memcpy(buf + produced, exp->pending + exp->pending_pos, n);
+            exp->pending_pos += n;
+            produced += n;
+            continue;
+        }
+
+        if (exp->state == EXPORT_HEADER) {
+            note_archive_header_t header = {
+                .magic = NOTE_ARCHIVE_MAGIC, .version = NOTE_ARCHIVE_VERSION
+            };
+            export_stage(exp, &header, sizeof(header));
+            exp->state = EXPORT_NEXT;
+        } else if (exp->state == EXPORT_NEXT) {
+            bool opened;
+            err = export_open_next(exp, &opened);
+            if (err == ESP_OK && opened) {
+                exp->state = EXPORT_BODY;
+            } else if (err == ESP_OK) {
+                note_archive_end_t end = { .magic = NOTE_ARCHIVE_END_MAGIC, .count = exp->count };
+                export_stage(exp, &end, sizeof(end));
+                exp->state = EXPORT_DONE;
+            }
+        } else if (exp->state == EXPORT_BODY && exp->remaining == 0) {
+            storage_close_note(&exp->reader);
+            exp->reader_open = false;
+            export_stage(exp, &exp->crc, sizeof(exp->crc));
+            exp->count++;
+            exp->state = EXPORT_NEXT;
+        } else if (exp->state == EXPORT_BODY) {
+            size_t want = exp->remaining < buf_len - produced ? exp->remaining : buf_len - produced;
+            size_t n = 0;
+            err = storage_read_chunk(&exp->reader, buf + produced, want, &n);
+            if (err == ESP_OK && n == 0) {
+                err = ESP_FAIL;  // Body shorter than its metadata says
+            }
+            if (err == ESP_OK) {
+                exp->crc = esp_rom_crc32_le(exp->crc, (const uint8_t *)buf + produced, n);
+                exp->remaining -= n;
+                produced += n;
+            }
+        } else {
+            break;  // EXPORT_DONE
+        }
+    }
+
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Export failed after %" PRIu32 " notes: %s", exp->count, esp_err_to_name(err));
+    }
+    *len = produced;
+    return err;
+}
+
+uint32_t note_export_count(const note_export_t *exp)
+{
+    return exp->count;
+}
+
+void note_export_free(note_export_t *exp)
+{
+    if (exp && exp->reader_open) {
+        storage_close_note(&exp->reader);
+    }
+    free(exp);
+}
+
+// Import
+
+esp_err_t note_import_begin(uint8_t ns, note_import_t **imp)
+{
+    *imp = calloc(1, sizeof(note_import_t));
+    if (!*imp) {
+        return ESP_ERR_NO_MEM;
+    }
+    (*imp)->ns = ns;
+    return ESP_OK;
+}
+
+static esp_err_t import_commit(note_import_t *imp)
+{
+    if (imp->batch_count == 0) {
+        return ESP_OK;
+    }
+    size_t committed = 0;
+    esp_err_t err = storage_commit_notes(imp->batch, imp->batch_count, &committed);
+    imp->imported += committed;
+    imp->batch_count = 0;
+    return err;
+}
+
+// Gather need bytes of a fixed-size piece; true once it is complete
+static bool import_stage(note_import_t *imp, size_t need, const char **data, size_t *len)
+{
+    size_t n = need - imp->staged;
+    n = n < *len ? n : *len;
+    memcpy(imp->stage + imp->staged, *data, n);
+    imp->staged += n;
+    *data += n;
+    *len -= n;
+    if (imp->staged < need) {
+        return false;
+    }
+    imp->staged = 0;
+    return true;
+}
+
+static esp_err_t import_begin_note(note_import_t *imp)
+{
+    note_meta_record_t rec;
+    memcpy(&rec, imp->stage, sizeof(rec));
+    bool outdated;
+    esp_err_t err = note_meta_decode(&rec, sizeof(rec), &imp->meta, &outdated);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Bad note metadata in archive: %s", esp_err_to_name(err));
+        return err == ESP_ERR_INVALID_CRC ? err : ESP_ERR_INVALID_RESPONSE;
+    }
+    imp->meta.compressed = false;
+    imp->meta.ns = imp->ns;  // Notes land in the namespace imported into
+    imp->remaining = imp->meta.size;
+    imp->crc = 0;
+    imp->seen++;
+
+    imp->skip = imp->meta.expires_at != 0 && imp->meta.expires_at <= (uint64_t)time(NULL);
+    if (imp->skip) {
+        imp->skipped++;
+        return ESP_OK;
+    }
+
+    if (imp->batch_count == IMPORT_BATCH_NOTES) {
+        err = import_commit(imp);
+        if (err != ESP_OK) {
+            return err;
+        }
+    }
+    err = storage_begin_import(&imp->meta, &imp->batch[imp->batch_count]);
+    imp->writing = err == ESP_OK;
+    return err;
+}
+
+static void import_abort_note(note_import_t *imp)
+{
+    if (imp->writing) {
+        storage_abort_note(&imp->batch[imp->batch_count]);
+        imp->writing = false;
+    }
+}
+
+esp_err_t note_import_feed(note_import_t *imp, const char *data, size_t len)
+{
+    esp_err_t err = ESP_OK;
+    while (len > 0 && err == ESP_OK) {
+        switch (imp->state) {
+        case IMPORT_HEADER:
+            if (import_stage(imp, sizeof(note_archive_header_t), &data, &len)) {
+                const note_archive_header_t *header = (const note_archive_header_t *)imp->stage;
+                if (header->magic != NOTE_ARCHIVE_MAGIC ||
+                    header->version != NOTE_ARCHIVE_VERSION) {
+                    err = ESP_ERR_INVALID_RESPONSE;
+                }
+                imp->state = IMPORT_MAGIC;
+            }
+            break;
+
+        case IMPORT_MAGIC:
+            if (import_stage(imp, sizeof(uint32_t), &data, &len)) {
+                uint32_t magic;
+                memcpy(&magic, imp->stage, sizeof(magic));
+                imp->staged = sizeof(magic);  // Part of what follows
+                if (magic == NOTE_META_MAGIC) {
+                    imp->state = IMPORT_META;
+                } else if (magic == NOTE_ARCHIVE_END_MAGIC) {
+                    imp->state = IMPORT_END;
+                } else {
+                    err = ESP_ERR_INVALID_RESPONSE;
+                }
+            }
+            break;
+
+        case IMPORT_META:
+            if (import_stage(imp, sizeof(note_meta_record_t), &data, &len)) {
+                err = import_begin_note(imp);
+                imp->state = imp->remaining > 0 ? IMPORT_BODY : IMPORT_CRC;
+            }
+            break;
+
+        case IMPORT_BODY: {
+            size_t n = len < imp->remaining ? len : imp->remaining;
+            if (!imp->skip) {
+                err = storage_write_chunk(&imp->batch[imp->batch_count], data, n);
+            }
+            imp->crc = esp_rom_crc32_le(imp->crc, (const uint8_t *)data, n);
+            imp->remaining -= n;
+            data += n;
+            len -= n;
+            if (imp->remaining == 0) {
+                imp->state = IMPORT_CRC;
+            }
+            break;
+        }
+
+        case IMPORT_CRC:
+            if (import_stage(imp, sizeof(uint32_t), &data, &len)) {
+                uint32_t crc;
+                memcpy(&crc, imp->stage, sizeof(crc));
+                if (crc != imp->crc) {
+                    ESP_LOGE(TAG, "Body checksum mismatch for archived note %s", imp->meta.id);
+                    err = ESP_ERR_INVALID_CRC;
+                } else if (imp->writing) {
+                    imp->writing = false;
+                    imp->batch_count++;
+                }
+                imp->state = IMPORT_MAGIC;
+            }
+            break;
+
+        case IMPORT_END:
+            if (import_stage(imp, sizeof(note_archive_end_t), &data, &len)) {
+                const note_archive_end_t *end = (const note_archive_end_t *)imp->stage;
+                err = end->count == imp->seen ? ESP_OK : ESP_ERR_INVALID_RESPONSE;
+                imp->state = IMPORT_DONE;
+            }
+            break;
+
+        case IMPORT_DONE:
+            err = ESP_ERR_INVALID_RESPONSE;  // Trailing bytes
+            break;
+        }
+    }
+
+    if (err != ESP_OK) {
+        import_abort_note(imp);
+    }
+    return err;
+}
+
+esp_err_t note_import_finish(note_import_t *imp, uint32_t *imported, uint32_t *skipped)
+{
+    esp_err_t err = imp->state == IMPORT_DONE ? import_commit(imp) : ESP_ERR_INVALID_SIZE;
+    *imported = imp->imported;
+    *skipped = imp->skipped;
+    return err;
+}
+
+void note_import_free(note_import_t *imp)
+{
+    if (!imp) {
+        return;
+    }
+    import_abort_note(imp);
+    for (size_t i = 0; i < imp->batch_count; i++) {
+        storage_abort_note(&imp->batch[i]);
+    }
+    free(imp);
+}
@@ -0,0 +1,101 @@
+#ifndef NOTE_ARCHIVE_H
+#define NOTE_ARCHIVE_H
+
+#include "esp_err.h"
+#include "storage.h"
+#include <stdint.h>
+#include <stddef.h>
+
+// Archive of every note in a namespace (GET /api/export, POST /api/import,
+// and the same under /api/ns/{name}/), little-endian:
+//   note_archive_header_t
+//   per note: note_meta_record_t (size = body length), body, uint32_t body CRC32
+//   note_archive_end_t
+// Bodies are exported as read through storage_read_chunk: plaintext is
+// decompressed, ciphertext is passed through untouched.
+#define NOTE_ARCHIVE_MAGIC 0x52414444      // "DDAR"
+#define NOTE_ARCHIVE_END_MAGIC 0x45414444  // "DDAE"
+#define NOTE_ARCHIVE_VERSION 1
+
+typedef struct __attribute__((packed)) {
+    uint32_t magic;
+    uint8_t version;
+    uint8_t reserved[3];
+} note_archive_header_t;
+
+typedef struct __attribute__((packed)) {
+    uint32_t magic;
+    uint32_t count;  // Notes in the archive
+} note_archive_end_t;
+
+typedef struct note_export note_export_t;
+typedef struct note_import note_import_t;
+
+/**
+ * Start exporting every note of a namespace, oldest first
+ *
+ * @param ns Namespace
+ * @param exp Output: exporter, released by note_export_free
+ * @return ESP_OK on success, ESP_ERR_NO_MEM
+ */
+esp_err_t note_export_begin(uint8_t ns, note_export_t **exp);
+
+/**
+ * Produce the next piece of the archive. Memory use is constant: notes are
+ * listed a page at a time and their bodies streamed.
+ *
+ * @param exp Exporter
+ * @param buf Output buffer
+ * @param buf_len Size of buf
+ * @param len Output: bytes produced, 0 once the archive is complete
+ * @return ESP_OK on success, ESP_FAIL if a note could not be read (the
+ *         archive is then truncated and will be rejected on import)
+ */
+esp_err_t note_export_read(note_export_t *exp, char *buf, size_t buf_len, size_t *len);
+
+/**
+ * Number of notes exported so far
+ */
+uint32_t note_export_count(const note_export_t *exp);
+
+void note_export_free(note_export_t *exp);
+
+/**
+ * Start importing an archive into a namespace (whatever namespace the
+ * notes were exported from)
+ *
+ * @param ns Namespace
+ * @param imp Output: importer, released by note_import_free
+ * @return ESP_OK on success, ESP_ERR_NO_MEM
+ */
+esp_err_t note_import_begin(uint8_t ns, note_import_t **imp);
+
+/**
+ * Feed the next piece of an archive. Notes are written as their bodies
+ * arrive and committed in batches of IMPORT_BATCH_NOTES.
+ *
+ * @param imp Importer
+ * @param data Archive bytes
+ * @param len Number of bytes
+ * @return ESP_OK on success, ESP_ERR_INVALID_RESPONSE for a malformed archive,
+ *         ESP_ERR_INVALID_CRC for a corrupt note, or a storage error
+ */
+esp_err_t note_import_feed(note_import_t *imp, const char *data, size_t len);
+
+/**
+ * Commit the last batch once the whole archive has been fed
+ *
+ * @param imp Importer
+ * @param imported Output: notes stored
+ * @param skipped Output: notes left out because they had already expired
+ * @return ESP_OK on success, ESP_ERR_INVALID_SIZE if the archive was truncated
+ */
+esp_err_t note_import_finish(note_import_t *imp, uint32_t *imported, uint32_t *skipped);
+
+/**
+ * Release an importer, discarding notes not yet committed (notes from
+ * earlier batches stay stored)
+ */
+void note_import_free(note_import_t *imp);
+
+#endif // NOTE_ARCHIVE_H
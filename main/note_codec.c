@@ -0,0 +1,245 @@
+#include "note_codec.h"
+#include "esp_log.h"
+#include "esp_heap_caps.h"
+#include "rom/miniz.h"
+#include <string.h>
+#include <stdlib.h>
+#include <stdbool.h>
+
+// Greedy parsing with a short match search: most of the ratio of the default
+// level at a fraction of the time on a 240 MHz core
+#define DEFLATE_FLAGS (32 | TDEFL_GREEDY_PARSING_FLAG)
+
+struct note_encoder {
+    char in[NOTE_CODEC_FRAME_SIZE];
+    size_t len;
+    uint32_t stored;
+};
+
+struct note_decoder {
+    char out[NOTE_CODEC_FRAME_SIZE];
+    size_t len;
+    size_t pos;
+    bool done;
+};
+
+static const char *TAG = "note_codec";
+
+// Only the storage task runs the codec, so the (large) miniz state and the
+// frame buffer are shared by every encoder and decoder
+static tdefl_compressor *g_deflate = NULL;
+static tinfl_decompressor *g_inflate = NULL;
+static uint8_t *g_frame = NULL;
+
+static void *alloc_prefer_psram(size_t size)
+{
+    return heap_caps_malloc_prefer(size, 2, MALLOC_CAP_SPIRAM, MALLOC_CAP_DEFAULT);
+}
+
+static esp_err_t ensure_frame_buffer(void)
+{
+    if (!g_frame) {
+        g_frame = alloc_prefer_psram(sizeof(note_codec_frame_t) + NOTE_CODEC_FRAME_SIZE);
+    }
+    return g_frame ? ESP_OK : ESP_ERR_NO_MEM;
+}
+
+esp_err_t note_encoder_create(note_encoder_t **enc)
+{
+    if (!g_deflate) {
+        g_deflate = alloc_prefer_psram(sizeof(tdefl_compressor));
+    }
+    if (!g_deflate || ensure_frame_buffer() != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to allocate compressor");
+        return ESP_ERR_NO_MEM;
+    }
+
+    *enc = alloc_prefer_psram(sizeof(note_encoder_t));
+    if (!*enc) {
+        return ESP_ERR_NO_MEM;
+    }
+    (*enc)->len = 0;
+    (*enc)->stored = 0;
+    return ESP_OK;
+}
+
+static esp_err_t emit_frame(note_encoder_t *enc, note_codec_sink_t sink, void *ctx)
+{
+    note_codec_frame_t *hdr = (note_codec_frame_t *)g_frame;
+    uint8_t *payload = g_frame + sizeof(*hdr);
+
+    // Output space one byte short of the input: deflate only counts if it shrinks
+    size_t in_size = enc->len;
+    size_t out_size = enc->len - 1;
+    tdefl_init(g_deflate, NULL, NULL, DEFLATE_FLAGS);
+    if (enc->len > 1 &&
+        tdefl_compress(g_deflate, enc->in, &in_size, payload, &out_size, TDEFL_FINISH) ==
+            TDEFL_STATUS_DONE) {
+        hdr->stored_len = (uint16_t)out_size;
+    } else {
+        memcpy(payload, enc->in, enc->len);
+        hdr->stored_len = (uint16_t)enc->len;
+    }
+    hdr->raw_len = (uint16_t)enc->len;
+
+    size_t len = sizeof(*hdr) + hdr->stored_len;
+    esp_err_t err = sink(ctx, (const char *)g_frame, len);
+    if (err == ESP_OK) {
+        enc->stored += len;
+        enc->len = 0;
+    }
+    return err;
+}
+
+esp_err_t note_encoder_write(note_encoder_t *enc, const char *data, size_t len,
+                             note_codec_sink_t sink, void *ctx)
+{
+    while (len > 0) {
+        size_t n = NOTE_CODEC_FRAME_SIZE - enc->len;
+        if (n > len) {
+            n = len;
+        }
+        memcpy(enc->in + enc->len, data, n);
+        enc->len += n;
+        data += n;
+        len -= n;
+
+        if (enc->len == NOTE_CODEC_FRAME_SIZE) {
+            esp_err_t err = emit_frame(enc, sink, ctx);
+            if (err != ESP_OK) {
+                return err;
+            }
+        }
+    }
+    return ESP_OK;
+}
+
+esp_err_t note_encoder_finish(note_encoder_t *enc, note_codec_sink_t sink, void *ctx,
+                              uint32_t *stored)
+{
+    esp_err_t err = enc->len > 0 ? emit_frame(enc, sink, ctx) : ESP_OK;
+    if (stored) {
+        *stored = enc->stored;
+    }
+    return err;
+}
+
+void note_encoder_free(note_encoder_t *enc)
+{
+    free(enc);
+}
+
+esp_err_t note_decoder_create(note_decoder_t **dec)
+{
+    if (!g_inflate) {
+        g_inflate = alloc_prefer_psram(sizeof(tinfl_decompressor));
+    }
+    if (!g_inflate || ensure_frame_buffer() != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to allocate decompressor");
+        return ESP_ERR_NO_MEM;
+    }
+
+    *dec = alloc_prefer_psram(sizeof(note_decoder_t));
+    if (!*dec) {
+        return ESP_ERR_NO_MEM;
+    }
+    (*dec)->len = 0;
+    (*dec)->pos = 0;
+    (*dec)->done = false;
+    return ESP_OK;
+}
+
+// Engines may return short reads, so keep asking until len bytes arrived
+static esp_err_t read_full(note_codec_source_t source, void *ctx, uint8_t *buf, size_t len,
+                           size_t *got)
+{
+    *got = 0;
+    while (*got < len) {
+        size_t n = 0;
+        esp_err_t err = source(ctx, (char *)buf + *got, len - *got, &n);
+        if (err != ESP_OK) {
+            return err;
+        }
+        if (n == 0) {
+            break;
+        }
+        *got += n;
+    }
+    return ESP_OK;
+}
+
+static esp_err_t load_frame(note_decoder_t *dec, note_codec_source_t source, void *ctx)
+{
+    note_codec_frame_t hdr;
+    size_t got;
+    esp_err_t err = read_full(source, ctx, (uint8_t *)&hdr, sizeof(hdr), &got);
+    if (err != ESP_OK) {
+        return err;
+    }
+    if (got == 0) {
+        dec->done = true;
+        return ESP_OK;
+    }
+    if (got != sizeof(hdr) || hdr.raw_len == 0 || hdr.raw_len > NOTE_CODEC_FRAME_SIZE ||
+        hdr.stored_len > hdr.raw_len) {
+        ESP_LOGE(TAG, "Corrupt frame header");
+        return ESP_ERR_INVALID_RESPONSE;
+    }
+
+    // Plain frames go straight to the output buffer
+    uint8_t *in = hdr.stored_len == hdr.raw_len ? (uint8_t *)dec->out : g_frame;
+    err = read_full(source, ctx, in, hdr.stored_len, &got);
+    if (err != ESP_OK) {
+        return err;
+    }
+    if (got != hdr.stored_len) {
+        ESP_LOGE(TAG, "Truncated frame");
+        return ESP_ERR_INVALID_RESPONSE;
+    }
+
+    if (in == g_frame) {
+        size_t in_size = hdr.stored_len;
+        size_t out_size = hdr.raw_len;
+        tinfl_init(g_inflate);
+        tinfl_status status = tinfl_decompress(g_inflate, in, &in_size, (uint8_t *)dec->out,
+                                               (uint8_t *)dec->out, &out_size,
+                                               TINFL_FLAG_USING_NON_WRAPPING_OUTPUT_BUF);
+        if (status != TINFL_STATUS_DONE || out_size != hdr.raw_len) {
+            ESP_LOGE(TAG, "Corrupt deflate frame (status=%d)", status);
+            return ESP_ERR_INVALID_RESPONSE;
+        }
+    }
+
+    dec->len = hdr.raw_len;
+    dec->pos = 0;
+    return ESP_OK;
+}
+
+esp_err_t note_decoder_read(note_decoder_t *dec, note_codec_source_t source, void *ctx,
+                            char *buf, size_t buf_len, size_t *read_len)
+{
+    *read_len = 0;
+    while (*read_len < buf_len && !dec->done) {
+        if (dec->pos == dec->len) {
+            esp_err_t err = load_frame(dec, source, ctx);
+            if (err != ESP_OK) {
+                return err;
+            }
+            continue;
+        }
+
+        size_t n = dec->len - dec->pos;
+        if (n > buf_len - *read_len) {
+            n = buf_len - *read_len;
+        }
+        memcpy(buf + *read_len, dec->out + dec->pos, n);
+        dec->pos += n;
+        *read_len += n;
+    }
+    return ESP_OK;
+}
+
+void note_decoder_free(note_decoder_t *dec)
+{
+    free(dec);
+}
@@ -0,0 +1,95 @@
+#ifndef NOTE_CODEC_H
+#define NOTE_CODEC_H
+
+#include "esp_err.h"
+#include <stdint.h>
+#include <stddef.h>
+
+// Compressed bodies are a sequence of independent frames: a frame header,
+// then raw deflate data (or the plain bytes, if deflate did not shrink them).
+// Independent frames keep both directions to one frame buffer of RAM.
+#define NOTE_CODEC_FRAME_SIZE 4096  // Uncompressed bytes per frame
+
+typedef struct __attribute__((packed)) {
+    uint16_t raw_len;     // Uncompressed length, at most NOTE_CODEC_FRAME_SIZE
+    uint16_t stored_len;  // Bytes that follow; equal to raw_len for a plain frame
+} note_codec_frame_t;
+
+// Largest stored body for size uncompressed bytes
+#define NOTE_CODEC_BOUND(size) \
+    ((size) + ((size) / NOTE_CODEC_FRAME_SIZE + 1) * sizeof(note_codec_frame_t))
+
+/**
+ * Receives encoded bytes (same shape as storage_engine_t.append)
+ */
+typedef esp_err_t (*note_codec_sink_t)(void *ctx, const char *data, size_t len);
+
+/**
+ * Supplies encoded bytes; *read_len is 0 at the end (same shape as storage_engine_t.read)
+ */
+typedef esp_err_t (*note_codec_source_t)(void *ctx, char *buf, size_t buf_len, size_t *read_len);
+
+typedef struct note_encoder note_encoder_t;
+typedef struct note_decoder note_decoder_t;
+
+/**
+ * Start compressing a body
+ *
+ * @param enc Output: encoder, released by note_encoder_free
+ * @return ESP_OK on success, ESP_ERR_NO_MEM
+ */
+esp_err_t note_encoder_create(note_encoder_t **enc);
+
+/**
+ * Compress the next chunk of body, passing complete frames to sink
+ *
+ * @param enc Encoder
+ * @param data Uncompressed bytes
+ * @param len Number of bytes
+ * @param sink Destination of encoded frames
+ * @param ctx Passed to sink
+ * @return ESP_OK on success, or the sink's error
+ */
+esp_err_t note_encoder_write(note_encoder_t *enc, const char *data, size_t len,
+                             note_codec_sink_t sink, void *ctx);
+
+/**
+ * Emit the last, partial frame
+ *
+ * @param enc Encoder
+ * @param sink Destination of encoded frames
+ * @param ctx Passed to sink
+ * @param stored Output: total encoded bytes passed to sink (may be NULL)
+ * @return ESP_OK on success, or the sink's error
+ */
+esp_err_t note_encoder_finish(note_encoder_t *enc, note_codec_sink_t sink, void *ctx,
+                              uint32_t *stored);
+
+void note_encoder_free(note_encoder_t *enc);
+
+/**
+ * Start decompressing a body
+ *
+ * @param dec Output: decoder, released by note_decoder_free
+ * @return ESP_OK on success, ESP_ERR_NO_MEM
+ */
+esp_err_t note_decoder_create(note_decoder_t **dec);
+
+/**
+ * Read the next chunk of uncompressed body
+ *
+ * @param dec Decoder
+ * @param source Supplier of encoded frames
+ * @param ctx Passed to source
+ * @param buf Output buffer
+ * @param buf_len Size of buf
+ * @param read_len Output: bytes placed in buf, 0 at the end of the body
+ * @return ESP_OK on success, ESP_ERR_INVALID_RESPONSE on a corrupt frame,
+ *         or the source's error
+ */
+esp_err_t note_decoder_read(note_decoder_t *dec, note_codec_source_t source, void *ctx,
+                            char *buf, size_t buf_len, size_t *read_len);
+
+void note_decoder_free(note_decoder_t *dec);
+
+#endif // NOTE_CODEC_H
@@ -0,0 +1,77 @@
+#include "note_meta.h"
+#include "esp_rom_crc.h"
+#include <string.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <inttypes.h>
+
+static uint32_t record_crc(const note_meta_record_t *rec, size_t crc_offset)
+{
+    return esp_rom_crc32_le(0, (const uint8_t *)rec, crc_offset);
+}
+
+void note_meta_encode(const note_metadata_t *meta, note_meta_record_t *rec)
+{
+    memset(rec, 0, sizeof(*rec));
+    rec->magic = NOTE_META_MAGIC;
+    rec->version = NOTE_META_VERSION;
+    rec->flags = (meta->encrypted ? NOTE_META_FLAG_ENCRYPTED : 0) |
+                 (meta->compressed ? NOTE_META_FLAG_COMPRESSED : 0);
+    rec->title_len = (uint8_t)strnlen(meta->title, MAX_TITLE_LENGTH - 1);
+    rec->ns = meta->ns;
+    rec->id = (uint32_t)strtoul(meta->id, NULL, 16);
+    rec->timestamp = meta->timestamp;
+    memcpy(rec->title, meta->title, rec->title_len);
+    rec->size = meta->size;
+    rec->expires_at = meta->expires_at;
+    rec->crc = record_crc(rec, offsetof(note_meta_record_t, crc));
+}
+
+void note_meta_mark_deleted(note_meta_record_t *rec)
+{
+    rec->flags |= NOTE_META_FLAG_DELETED;
+    rec->crc = record_crc(rec, offsetof(note_meta_record_t, crc));
+}
+
+esp_err_t note_meta_decode(const note_meta_record_t *rec, size_t len,
+                           note_metadata_t *meta, bool *outdated)
+{
+    if (len < sizeof(uint32_t) || rec->magic != NOTE_META_MAGIC) {
+        return ESP_ERR_INVALID_RESPONSE;
+    }
+
+    // Each version ended with the CRC where the next one added a field
+    size_t crc_offset;
+    if (rec->version == 1) {
+        crc_offset = offsetof(note_meta_record_t, size);
+    } else if (rec->version == 2) {
+        crc_offset = offsetof(note_meta_record_t, expires_at);
+    } else if (rec->version == NOTE_META_VERSION) {
+        crc_offset = offsetof(note_meta_record_t, crc);
+    } else {
+        return ESP_ERR_INVALID_VERSION;
+    }
+    if (len != crc_offset + sizeof(uint32_t)) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+
+    uint32_t stored_crc;
+    memcpy(&stored_crc, (const uint8_t *)rec + crc_offset, sizeof(stored_crc));
+
+    if (stored_crc != record_crc(rec, crc_offset) || rec->title_len >= MAX_TITLE_LENGTH) {
+        return ESP_ERR_INVALID_CRC;
+    }
+
+    memset(meta, 0, sizeof(*meta));
+    snprintf(meta->id, sizeof(meta->id), "%08" PRIx32, rec->id);
+    memcpy(meta->title, rec->title, rec->title_len);
+    meta->timestamp = rec->timestamp;
+    meta->encrypted = rec->flags & NOTE_META_FLAG_ENCRYPTED;
+    meta->compressed = rec->flags & NOTE_META_FLAG_COMPRESSED;
+    meta->ns = rec->ns;
+    meta->size = rec->version >= 2 ? rec->size : 0;
+    meta->expires_at = rec->version >= 3 ? rec->expires_at : 0;
+    *outdated = rec->version != NOTE_META_VERSION;
+    return ESP_OK;
+}
@@ -0,0 +1,60 @@
+#ifndef NOTE_META_H
+#define NOTE_META_H
+
+#include "esp_err.h"
+#include "storage.h"
+#include <stdint.h>
+
+#define NOTE_META_MAGIC 0x544D4444  // "DDMT"
+#define NOTE_META_VERSION 3
+#define NOTE_META_FLAG_ENCRYPTED 0x01
+#define NOTE_META_FLAG_COMPRESSED 0x02  // Body stored as note_codec frames
+#define NOTE_META_FLAG_DELETED 0x80  // Journal entry recording a delete
+
+// Fixed-layout on-flash metadata record (little-endian)
+typedef struct __attribute__((packed)) {
+    uint32_t magic;
+    uint8_t version;
+    uint8_t flags;
+    uint8_t title_len;
+    uint8_t ns;           // Namespace (reserved and always 0 before namespaces existed)
+    uint32_t id;
+    uint64_t timestamp;
+    char title[MAX_TITLE_LENGTH];
+    uint32_t size;        // Message length (added in version 2)
+    uint64_t expires_at;  // Unix time, 0 = never (added in version 3)
+    uint32_t crc;         // CRC32 of all preceding bytes
+} note_meta_record_t;
+
+/**
+ * Encode note metadata into an on-flash record
+ *
+ * @param meta Note metadata (ID must be a hex note counter)
+ * @param rec Output record
+ */
+void note_meta_encode(const note_metadata_t *meta, note_meta_record_t *rec);
+
+/**
+ * Turn an encoded record into a delete marker (used by the index journal)
+ *
+ * @param rec Record produced by note_meta_encode
+ */
+void note_meta_mark_deleted(note_meta_record_t *rec);
+
+/**
+ * Decode and validate an on-flash record. Older versions decode with the
+ * fields they lack zeroed (size for version 1, expires_at for versions 1-2)
+ * and *outdated set.
+ *
+ * @param rec Record as read from flash
+ * @param len Number of bytes read into rec
+ * @param meta Output: note metadata
+ * @param outdated Output: true if the record should be rewritten in the current version
+ * @return ESP_OK on success, ESP_ERR_INVALID_RESPONSE if the magic does not match,
+ *         ESP_ERR_INVALID_VERSION for unknown versions, ESP_ERR_INVALID_SIZE if truncated,
+ *         ESP_ERR_INVALID_CRC on corruption
+ */
+esp_err_t note_meta_decode(const note_meta_record_t *rec, size_t len,
+                           note_metadata_t *meta, bool *outdated);
+
+#endif // NOTE_META_H
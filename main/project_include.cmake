@@ -0,0 +1,10 @@
+# The partition table follows the storage engine chosen in menuconfig: the
+# slot engine needs the raw "notes" partition. Included after the
+# partition_table component has resolved CONFIG_PARTITION_TABLE_FILENAME, so
+# this path is the one the table is built and flashed from.
+idf_build_get_property(deaddrop_project_dir PROJECT_DIR)
+if(CONFIG_DEADDROP_STORAGE_ENGINE_SLOTS)
+    set(PARTITION_CSV_PATH "${deaddrop_project_dir}/partitions_slots.csv")
+else()
+    set(PARTITION_CSV_PATH "${deaddrop_project_dir}/partitions.csv")
+endif()
@@ -0,0 +1,134 @@
+#include "reclaim.h"
+#include "note_meta.h"
+#include "constants.h"
+#include "esp_log.h"
+#include "esp_heap_caps.h"
+#include <string.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <unistd.h>
+#include <errno.h>
+
+#define RECLAIM_PATH STORAGE_BASE_PATH "/reclaim.lst"
+#define RECLAIM_INITIAL_CAPACITY 16
+
+static const char *TAG = "reclaim";
+
+// The list on flash is a sequence of note_meta_record_t marked deleted. It
+// only ever grows until every entry is removed, then it is dropped whole.
+static FILE *g_file = NULL;
+
+// Pending removals in the order they were queued; [g_head, g_count) remain
+static note_metadata_t *g_pending = NULL;
+static size_t g_head = 0;
+static size_t g_count = 0;
+static size_t g_capacity = 0;
+
+static esp_err_t push(const note_metadata_t *meta)
+{
+    if (g_count == g_capacity) {
+        size_t capacity = g_capacity ? g_capacity * 2 : RECLAIM_INITIAL_CAPACITY;
+        note_metadata_t *pending = heap_caps_realloc_prefer(
+            g_pending, capacity * sizeof(note_metadata_t), 2, MALLOC_CAP_SPIRAM, MALLOC_CAP_DEFAULT);
+        if (!pending) {
+            return ESP_ERR_NO_MEM;
+        }
+        g_pending = pending;
+        g_capacity = capacity;
+    }
+    g_pending[g_count++] = *meta;
+    return ESP_OK;
+}
+
+esp_err_t reclaim_init(void)
+{
+    g_head = g_count = 0;
+
+    FILE *f = fopen(RECLAIM_PATH, "rb");
+    if (!f) {
+        return ESP_OK;
+    }
+
+    // A torn last entry (power cut mid-append) belongs to a delete that never returned
+    note_meta_record_t rec;
+    esp_err_t err = ESP_OK;
+    while (err == ESP_OK && fread(&rec, 1, sizeof(rec), f) == sizeof(rec)) {
+        note_metadata_t meta;
+        bool outdated;
+        if (note_meta_decode(&rec, sizeof(rec), &meta, &outdated) != ESP_OK ||
+            !(rec.flags & NOTE_META_FLAG_DELETED)) {
+            break;
+        }
+        err = push(&meta);
+    }
+    fclose(f);
+
+    if (g_count > 0) {
+        ESP_LOGI(TAG, "%zu deleted notes still to be removed", g_count);
+    }
+    return err;
+}
+
+esp_err_t reclaim_add(const note_metadata_t *meta)
+{
+    esp_err_t err = push(meta);
+    if (err != ESP_OK) {
+        return err;
+    }
+
+    if (!g_file) {
+        g_file = fopen(RECLAIM_PATH, "ab");
+    }
+    note_meta_record_t rec;
+    note_meta_encode(meta, &rec);
+    note_meta_mark_deleted(&rec);
+    if (!g_file || fwrite(&rec, 1, sizeof(rec), g_file) != sizeof(rec) ||
+        fflush(g_file) != 0 || fsync(fileno(g_file)) != 0) {
+        ESP_LOGE(TAG, "Failed to record delete of note %s (errno=%d)", meta->id, errno);
+        g_count--;
+        return ESP_FAIL;
+    }
+    return ESP_OK;
+}
+
+bool reclaim_pending(uint32_t note_id)
+{
+    for (size_t i = g_head; i < g_count; i++) {
+        if ((uint32_t)strtoul(g_pending[i].id, NULL, 16) == note_id) {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool reclaim_peek(note_metadata_t *meta)
+{
+    if (g_head == g_count) {
+        return false;
+    }
+    *meta = g_pending[g_head];
+    return true;
+}
+
+void reclaim_pop(void)
+{
+    if (g_head == g_count) {
+        return;
+    }
+    if (++g_head < g_count) {
+        return;
+    }
+
+    // Everything queued is gone from the engine
+    g_head = g_count = 0;
+    if (g_file) {
+        fclose(g_file);
+        g_file = NULL;
+    }
+    unlink(RECLAIM_PATH);
+}
+
+size_t reclaim_count(void)
+{
+    return g_count - g_head;
+}
@@ -0,0 +1,54 @@
+#ifndef RECLAIM_H
+#define RECLAIM_H
+
+#include "esp_err.h"
+#include "storage.h"
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+/**
+ * Load the notes whose removal from the engine is still pending
+ * (persisted across reboots in a list on the storage filesystem)
+ *
+ * @return ESP_OK on success, ESP_ERR_NO_MEM
+ */
+esp_err_t reclaim_init(void);
+
+/**
+ * Queue a deleted note for removal (durable when this returns)
+ *
+ * @param meta Metadata of the deleted note
+ * @return ESP_OK on success, ESP_FAIL if the list could not be written
+ */
+esp_err_t reclaim_add(const note_metadata_t *meta);
+
+/**
+ * Check whether a note was deleted but not yet removed, so engine loads
+ * and recovery can leave it out
+ *
+ * @param note_id Numeric note ID
+ * @return true if removal is pending
+ */
+bool reclaim_pending(uint32_t note_id);
+
+/**
+ * Oldest pending removal
+ *
+ * @param meta Output: metadata of the deleted note
+ * @return true if anything is pending
+ */
+bool reclaim_peek(note_metadata_t *meta);
+
+/**
+ * Mark the note returned by reclaim_peek as removed; the list on flash is
+ * dropped once it is empty
+ */
+void reclaim_pop(void);
+
+/**
+ * Number of pending removals
+ */
+size_t reclaim_count(void);
+
+#endif // RECLAIM_H
@@ -0,0 +1,726 @@
+#include "search_index.h"
+#include "catalog.h"
+#include "constants.h"
+#include "esp_log.h"
+#include "esp_heap_caps.h"
+#include "esp_rom_crc.h"
+#include <string.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <errno.h>
+#include <unistd.h>
+#include <inttypes.h>
+
+#define SEARCH_FILE_MAGIC 0x49534444  // "DDSI"
+#define SEARCH_FILE_VERSION 1
+#define SEARCH_PATH STORAGE_BASE_PATH "/search.idx"
+#define SEARCH_TMP_PATH STORAGE_BASE_PATH "/search.tmp"
+#define SEARCH_GROWN_PATH STORAGE_BASE_PATH "/search.grw"
+#define SEARCH_INITIAL_TERMS 1024
+#define SEARCH_MIN_WORD_LEN 2
+#define SEARCH_DOC_SLOTS (SEARCH_MAX_WORDS_PER_NOTE * 2)  // Keeps the seen-set half empty
+#define SEARCH_COMPACT_MIN 64  // Deleted notes tolerated in posting lists
+
+// One indexed word: its hash and the IDs of the notes containing it, stored
+// as ascending varint deltas. Hash 0 marks an empty table slot.
+typedef struct {
+    uint32_t hash;
+    uint32_t count;
+    uint32_t last_id;
+    uint32_t len;
+    uint32_t capacity;
+    uint8_t *postings;
+} search_term_t;
+
+typedef struct __attribute__((packed)) {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t term_count;
+    uint32_t covered_id;
+    uint32_t crc;  // CRC32 of everything after the header
+} search_file_header_t;
+
+typedef struct __attribute__((packed)) {
+    uint32_t hash;
+    uint32_t count;
+    uint32_t last_id;
+    uint32_t len;
+} search_file_term_t;
+
+struct search_doc {
+    uint32_t note_id;
+    bool indexed;        // Already counted in g_docs
+    uint32_t word_hash;  // Word being read, FNV-1a
+    uint32_t word_len;
+    uint32_t count;
+    uint32_t words[SEARCH_DOC_SLOTS];  // Distinct word hashes, 0 = free
+};
+
+// Reads a posting list in order
+typedef struct {
+    const search_term_t *term;
+    uint32_t pos;
+    uint32_t id;
+} posting_cursor_t;
+
+static const char *TAG = "search";
+
+// Open-addressing hash table of terms, in PSRAM where available
+static search_term_t *g_terms = NULL;
+static size_t g_term_capacity = 0;
+static size_t g_term_count = 0;
+static uint32_t g_docs = 0;     // Notes in the index, including deleted ones
+static uint32_t g_dead = 0;     // Deleted notes still in posting lists
+static uint32_t g_changes = 0;  // Since the last load/save
+static uint32_t g_saved_covered = 0;  // covered_id of the index on flash
+
+// Notes the saved index covers whose words grew since (appends), also kept
+// in a list on flash of uint32_t IDs until the next save
+static uint32_t *g_grown = NULL;
+static size_t g_grown_count = 0;
+static size_t g_grown_capacity = 0;
+
+static void *alloc_prefer_psram(size_t size)
+{
+    return heap_caps_malloc_prefer(size, 2, MALLOC_CAP_SPIRAM, MALLOC_CAP_DEFAULT);
+}
+
+static void *realloc_prefer_psram(void *ptr, size_t size)
+{
+    return heap_caps_realloc_prefer(ptr, size, 2, MALLOC_CAP_SPIRAM, MALLOC_CAP_DEFAULT);
+}
+
+// Tokenizer: runs of ASCII letters/digits and UTF-8 sequences, lowercased
+
+static bool is_word_byte(uint8_t c)
+{
+    return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') || c >= 0x80;
+}
+
+static uint32_t hash_byte(uint32_t hash, uint8_t c)
+{
+    if (c >= 'A' && c <= 'Z') {
+        c += 'a' - 'A';
+    }
+    return (hash ^ c) * 16777619u;
+}
+
+#define HASH_SEED 2166136261u
+
+static uint32_t finish_hash(uint32_t hash)
+{
+    return hash ? hash : 1;
+}
+
+// Postings
+
+static size_t put_varint(uint8_t *buf, uint32_t value)
+{
+    size_t n = 0;
+    while (value >= 0x80) {
+        buf[n++] = (uint8_t)(value | 0x80);
+        value >>= 7;
+    }
+    buf[n++] = (uint8_t)value;
+    return n;
+}
+
+static bool cursor_next(posting_cursor_t *cur)
+{
+    const search_term_t *term = cur->term;
+    uint32_t delta = 0;
+    int shift = 0;
+    while (cur->pos < term->len) {
+        uint8_t b = term->postings[cur->pos++];
+        delta |= (uint32_t)(b & 0x7F) << shift;
+        if (!(b & 0x80)) {
+            cur->id += delta;
+            return true;
+        }
+        shift += 7;
+    }
+    return false;
+}
+
+static esp_err_t term_reserve(search_term_t *term, size_t extra)
+{
+    if (term->len + extra <= term->capacity) {
+        return ESP_OK;
+    }
+
+    size_t capacity = term->capacity ? term->capacity * 2 : 8;
+    while (capacity < term->len + extra) {
+        capacity *= 2;
+    }
+    uint8_t *postings = realloc_prefer_psram(term->postings, capacity);
+    if (!postings) {
+        return ESP_ERR_NO_MEM;
+    }
+    term->postings = postings;
+    term->capacity = capacity;
+    return ESP_OK;
+}
+
+// Caller has reserved room for one more varint
+static void term_append(search_term_t *term, uint32_t note_id)
+{
+    term->len += put_varint(term->postings + term->len, note_id - term->last_id);
+    term->last_id = note_id;
+    term->count++;
+}
+
+// Re-encode a list with note_id inserted; only needed when uploads finish
+// out of ID order
+static esp_err_t term_insert_sorted(search_term_t *term, uint32_t note_id)
+{
+    search_term_t fresh = { .hash = term->hash };
+    esp_err_t err = term_reserve(&fresh, term->len + 5);
+    if (err != ESP_OK) {
+        return err;
+    }
+
+    posting_cursor_t cur = { .term = term };
+    bool inserted = false;
+    while (cursor_next(&cur)) {
+        if (!inserted && note_id <= cur.id) {
+            if (note_id < cur.id) {
+                term_append(&fresh, note_id);
+            }
+            inserted = true;
+        }
+        term_append(&fresh, cur.id);
+    }
+
+    free(term->postings);
+    *term = fresh;
+    return ESP_OK;
+}
+
+static esp_err_t term_add(search_term_t *term, uint32_t note_id)
+{
+    if (note_id == term->last_id) {
+        return ESP_OK;
+    }
+    if (note_id < term->last_id) {
+        return term_insert_sorted(term, note_id);
+    }
+
+    esp_err_t err = term_reserve(term, 5);
+    if (err == ESP_OK) {
+        term_append(term, note_id);
+    }
+    return err;
+}
+
+// Term table
+
+static search_term_t *term_slot(uint32_t hash)
+{
+    size_t mask = g_term_capacity - 1;
+    size_t i = hash & mask;
+    while (g_terms[i].hash != 0 && g_terms[i].hash != hash) {
+        i = (i + 1) & mask;
+    }
+    return &g_terms[i];
+}
+
+static const search_term_t *term_find(uint32_t hash)
+{
+    search_term_t *term = term_slot(hash);
+    return term->hash == hash ? term : NULL;
+}
+
+static esp_err_t table_grow(size_t capacity)
+{
+    search_term_t *terms = alloc_prefer_psram(capacity * sizeof(search_term_t));
+    if (!terms) {
+        ESP_LOGE(TAG, "Failed to grow index to %zu terms", capacity);
+        return ESP_ERR_NO_MEM;
+    }
+    memset(terms, 0, capacity * sizeof(search_term_t));
+
+    search_term_t *old = g_terms;
+    size_t old_capacity = g_term_capacity;
+    g_terms = terms;
+    g_term_capacity = capacity;
+    for (size_t i = 0; i < old_capacity; i++) {
+        if (old[i].hash != 0) {
+            *term_slot(old[i].hash) = old[i];
+        }
+    }
+    free(old);
+    return ESP_OK;
+}
+
+static search_term_t *term_get(uint32_t hash)
+{
+    search_term_t *term = term_slot(hash);
+    if (term->hash == hash) {
+        return term;
+    }
+
+    // Keep the table at most 3/4 full
+    if ((g_term_count + 1) * 4 > g_term_capacity * 3) {
+        if (table_grow(g_term_capacity * 2) != ESP_OK) {
+            return NULL;
+        }
+        term = term_slot(hash);
+    }
+    term->hash = hash;
+    g_term_count++;
+    return term;
+}
+
+static void table_clear(void)
+{
+    for (size_t i = 0; i < g_term_capacity; i++) {
+        free(g_terms[i].postings);
+    }
+    memset(g_terms, 0, g_term_capacity * sizeof(search_term_t));
+    g_term_count = 0;
+    g_docs = 0;
+    g_dead = 0;
+    g_changes = 0;
+}
+
+esp_err_t search_init(void)
+{
+    if (g_terms) {
+        table_clear();
+        return ESP_OK;
+    }
+    return table_grow(SEARCH_INITIAL_TERMS);
+}
+
+// Documents
+
+esp_err_t search_doc_begin(uint32_t note_id, bool indexed, search_doc_t **doc)
+{
+    *doc = alloc_prefer_psram(sizeof(search_doc_t));
+    if (!*doc) {
+        return ESP_ERR_NO_MEM;
+    }
+    memset(*doc, 0, sizeof(search_doc_t));
+    (*doc)->note_id = note_id;
+    (*doc)->indexed = indexed;
+    (*doc)->word_hash = HASH_SEED;
+    return ESP_OK;
+}
+
+void search_doc_break(search_doc_t *doc)
+{
+    if (doc->word_len >= SEARCH_MIN_WORD_LEN && doc->count < SEARCH_MAX_WORDS_PER_NOTE) {
+        uint32_t hash = finish_hash(doc->word_hash);
+        size_t i = hash & (SEARCH_DOC_SLOTS - 1);
+        while (doc->words[i] != 0 && doc->words[i] != hash) {
+            i = (i + 1) & (SEARCH_DOC_SLOTS - 1);
+        }
+        if (doc->words[i] == 0) {
+            doc->words[i] = hash;
+            doc->count++;
+        }
+    }
+    doc->word_hash = HASH_SEED;
+    doc->word_len = 0;
+}
+
+void search_doc_feed(search_doc_t *doc, const char *text, size_t len)
+{
+    // Past the word limit the rest of a long body adds nothing
+    for (size_t i = 0; i < len && doc->count < SEARCH_MAX_WORDS_PER_NOTE; i++) {
+        uint8_t c = (uint8_t)text[i];
+        if (is_word_byte(c)) {
+            doc->word_hash = hash_byte(doc->word_hash, c);
+            doc->word_len++;
+        } else if (doc->word_len > 0) {
+            search_doc_break(doc);
+        }
+    }
+}
+
+esp_err_t search_doc_commit(search_doc_t *doc)
+{
+    search_doc_break(doc);
+
+    esp_err_t err = ESP_OK;
+    for (size_t i = 0; i < SEARCH_DOC_SLOTS && err == ESP_OK; i++) {
+        if (doc->words[i] == 0) {
+            continue;
+        }
+        search_term_t *term = term_get(doc->words[i]);
+        err = term ? term_add(term, doc->note_id) : ESP_ERR_NO_MEM;
+    }
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to index note %08" PRIx32, doc->note_id);
+    }
+
+    if (!doc->indexed) {
+        g_docs++;
+    }
+    g_changes++;
+    free(doc);
+    return err;
+}
+
+void search_doc_discard(search_doc_t *doc)
+{
+    free(doc);
+}
+
+// Deletes
+
+static const note_metadata_t *note_find(uint32_t note_id)
+{
+    char id[16];
+    snprintf(id, sizeof(id), "%08" PRIx32, note_id);
+    return catalog_find(id);
+}
+
+static bool note_live(uint32_t note_id)
+{
+    return note_find(note_id) != NULL;
+}
+
+// Postings are shared by every namespace; matches are narrowed down here
+static bool note_in_ns(uint32_t note_id, uint8_t ns)
+{
+    const note_metadata_t *meta = note_find(note_id);
+    return meta && meta->ns == ns;
+}
+
+// Drop postings of notes no longer in the catalog. Merging two deltas never
+// needs more varint bytes than the pair did, so lists shrink in place.
+static void compact_postings(void)
+{
+    for (size_t i = 0; i < g_term_capacity; i++) {
+        search_term_t *term = &g_terms[i];
+        if (term->hash == 0) {
+            continue;
+        }
+
+        posting_cursor_t cur = { .term = term };
+        uint32_t len = 0, count = 0, last_id = 0;
+        while (cursor_next(&cur)) {
+            if (note_live(cur.id)) {
+                len += put_varint(term->postings + len, cur.id - last_id);
+                last_id = cur.id;
+                count++;
+            }
+        }
+        term->len = len;
+        term->count = count;
+        term->last_id = last_id;
+    }
+
+    ESP_LOGI(TAG, "Dropped %" PRIu32 " deleted notes from the index", g_dead);
+    g_docs = g_docs > g_dead ? g_docs - g_dead : 0;
+    g_dead = 0;
+}
+
+void search_remove(uint32_t note_id)
+{
+    // Queries skip notes missing from the catalog, so postings can be
+    // dropped in batches instead of rewriting every list per delete
+    g_dead++;
+    g_changes++;
+    uint32_t threshold = g_docs / 8;
+    if (threshold < SEARCH_COMPACT_MIN) {
+        threshold = SEARCH_COMPACT_MIN;
+    }
+    if (g_dead >= threshold) {
+        compact_postings();
+    }
+}
+
+// Queries
+
+size_t search_query(uint8_t ns, const char *query, uint32_t *ids, size_t max_ids, bool *more)
+{
+    *more = false;
+    if (max_ids == 0) {
+        return 0;
+    }
+
+    // Look up each distinct query word; any unknown word means no match
+    posting_cursor_t cursors[SEARCH_MAX_QUERY_WORDS];
+    size_t n = 0;
+    search_doc_t *words;
+    if (search_doc_begin(0, false, &words) != ESP_OK) {
+        return 0;
+    }
+    search_doc_feed(words, query, strlen(query));
+    search_doc_break(words);
+    for (size_t i = 0; i < SEARCH_DOC_SLOTS && n < SEARCH_MAX_QUERY_WORDS; i++) {
+        if (words->words[i] == 0) {
+            continue;
+        }
+        const search_term_t *term = term_find(words->words[i]);
+        if (!term || term->count == 0) {
+            search_doc_discard(words);
+            return 0;
+        }
+        cursors[n++] = (posting_cursor_t){ .term = term };
+    }
+    search_doc_discard(words);
+    if (n == 0) {
+        return 0;
+    }
+
+    // Lead with the shortest list; work is bounded by the lists' lengths
+    for (size_t i = 1; i < n; i++) {
+        if (cursors[i].term->count < cursors[0].term->count) {
+            posting_cursor_t tmp = cursors[0];
+            cursors[0] = cursors[i];
+            cursors[i] = tmp;
+        }
+    }
+
+    // Matches arrive oldest first; keep the newest max_ids in a ring
+    size_t matched = 0;
+    while (cursor_next(&cursors[0])) {
+        uint32_t target = cursors[0].id;
+        bool all = true;
+        for (size_t i = 1; i < n && all; i++) {
+            while (cursors[i].id < target) {
+                if (!cursor_next(&cursors[i])) {
+                    goto done;
+                }
+            }
+            all = cursors[i].id == target;
+        }
+        if (all && note_in_ns(target, ns)) {
+            ids[matched % max_ids] = target;
+            matched++;
+        }
+    }
+
+done:;
+    size_t count = matched < max_ids ? matched : max_ids;
+    *more = matched > max_ids;
+
+    // Unroll the ring newest first: rotate the oldest kept match to the
+    // front, then reverse
+    size_t start = matched > max_ids ? matched % max_ids : 0;
+    for (size_t i = 0; i < start; i++) {
+        uint32_t first = ids[0];
+        memmove(&ids[0], &ids[1], (count - 1) * sizeof(uint32_t));
+        ids[count - 1] = first;
+    }
+    for (size_t i = 0; i < count / 2; i++) {
+        uint32_t tmp = ids[i];
+        ids[i] = ids[count - 1 - i];
+        ids[count - 1 - i] = tmp;
+    }
+    return count;
+}
+
+// Persistence
+
+static bool grown_contains(uint32_t note_id)
+{
+    for (size_t i = 0; i < g_grown_count; i++) {
+        if (g_grown[i] == note_id) {
+            return true;
+        }
+    }
+    return false;
+}
+
+static esp_err_t grown_push(uint32_t note_id)
+{
+    if (g_grown_count == g_grown_capacity) {
+        size_t capacity = g_grown_capacity ? g_grown_capacity * 2 : 16;
+        uint32_t *grown = realloc_prefer_psram(g_grown, capacity * sizeof(uint32_t));
+        if (!grown) {
+            return ESP_ERR_NO_MEM;
+        }
+        g_grown = grown;
+        g_grown_capacity = capacity;
+    }
+    g_grown[g_grown_count++] = note_id;
+    return ESP_OK;
+}
+
+static void grown_load(void)
+{
+    g_grown_count = 0;
+    FILE *f = fopen(SEARCH_GROWN_PATH, "rb");
+    if (!f) {
+        return;
+    }
+
+    // A torn last entry belongs to an append that never returned
+    uint32_t note_id;
+    while (fread(&note_id, 1, sizeof(note_id), f) == sizeof(note_id) &&
+           (grown_contains(note_id) || grown_push(note_id) == ESP_OK)) {
+    }
+    fclose(f);
+
+    if (g_grown_count > 0) {
+        ESP_LOGI(TAG, "%zu notes grew since the index was saved", g_grown_count);
+    }
+}
+
+esp_err_t search_mark_grown(uint32_t note_id)
+{
+    // Notes after the saved index are indexed from scratch at boot anyway
+    if (note_id > g_saved_covered || grown_contains(note_id)) {
+        return ESP_OK;
+    }
+    esp_err_t err = grown_push(note_id);
+    if (err != ESP_OK) {
+        return err;
+    }
+
+    FILE *f = fopen(SEARCH_GROWN_PATH, "ab");
+    bool ok = f && fwrite(&note_id, 1, sizeof(note_id), f) == sizeof(note_id) &&
+              fflush(f) == 0 && fsync(fileno(f)) == 0;
+    if (f) {
+        ok = fclose(f) == 0 && ok;
+    }
+    if (!ok) {
+        ESP_LOGE(TAG, "Failed to record note %08" PRIx32 " in %s (errno=%d)",
+                 note_id, SEARCH_GROWN_PATH, errno);
+        g_grown_count--;
+        return ESP_FAIL;
+    }
+    return ESP_OK;
+}
+
+size_t search_grown_notes(const uint32_t **ids)
+{
+    *ids = g_grown;
+    return g_grown_count;
+}
+
+uint32_t search_unsaved_changes(void)
+{
+    return g_changes;
+}
+
+esp_err_t search_save(uint32_t covered_id)
+{
+    FILE *f = fopen(SEARCH_TMP_PATH, "wb");
+    if (!f) {
+        ESP_LOGE(TAG, "Failed to create %s (errno=%d)", SEARCH_TMP_PATH, errno);
+        return ESP_FAIL;
+    }
+
+    // The placeholder header has no magic, so a torn save is never loaded
+    search_file_header_t hdr = {
+        .version = SEARCH_FILE_VERSION,
+        .covered_id = covered_id,
+    };
+    bool ok = fwrite(&hdr, 1, sizeof(hdr), f) == sizeof(hdr);
+    for (size_t i = 0; i < g_term_capacity && ok; i++) {
+        const search_term_t *term = &g_terms[i];
+        if (term->hash == 0 || term->count == 0) {
+            continue;
+        }
+        search_file_term_t rec = {
+            .hash = term->hash, .count = term->count, .last_id = term->last_id, .len = term->len
+        };
+        hdr.crc = esp_rom_crc32_le(hdr.crc, (const uint8_t *)&rec, sizeof(rec));
+        hdr.crc = esp_rom_crc32_le(hdr.crc, term->postings, term->len);
+        hdr.term_count++;
+        ok = fwrite(&rec, 1, sizeof(rec), f) == sizeof(rec) &&
+             fwrite(term->postings, 1, term->len, f) == term->len;
+    }
+
+    // Real header last, once everything it describes is written
+    long size = ftell(f);
+    hdr.magic = SEARCH_FILE_MAGIC;
+    ok = ok && fseek(f, 0, SEEK_SET) == 0 && fwrite(&hdr, 1, sizeof(hdr), f) == sizeof(hdr) &&
+         fflush(f) == 0 && fsync(fileno(f)) == 0;
+    ok = fclose(f) == 0 && ok;
+    if (!ok) {
+        ESP_LOGE(TAG, "Failed to write %s (errno=%d)", SEARCH_TMP_PATH, errno);
+        unlink(SEARCH_TMP_PATH);
+        return ESP_FAIL;
+    }
+
+    unlink(SEARCH_PATH);
+    if (rename(SEARCH_TMP_PATH, SEARCH_PATH) != 0) {
+        ESP_LOGE(TAG, "Failed to rename %s (errno=%d)", SEARCH_TMP_PATH, errno);
+        return ESP_FAIL;
+    }
+
+    g_changes = 0;
+    g_saved_covered = covered_id;
+
+    // The saved index has the grown notes' new words
+    g_grown_count = 0;
+    unlink(SEARCH_GROWN_PATH);
+
+    ESP_LOGI(TAG, "Saved %" PRIu32 " terms (%ld bytes)", hdr.term_count, size);
+    return ESP_OK;
+}
+
+esp_err_t search_load(uint32_t *covered_id)
+{
+    // Only the temporary file is left if a save lost power mid-rename
+    FILE *f = fopen(SEARCH_PATH, "rb");
+    if (!f && rename(SEARCH_TMP_PATH, SEARCH_PATH) == 0) {
+        f = fopen(SEARCH_PATH, "rb");
+    }
+    if (!f) {
+        return ESP_ERR_NOT_FOUND;
+    }
+
+    search_file_header_t hdr;
+    if (fread(&hdr, 1, sizeof(hdr), f) != sizeof(hdr) || hdr.magic != SEARCH_FILE_MAGIC ||
+        hdr.version != SEARCH_FILE_VERSION) {
+        fclose(f);
+        return ESP_ERR_NOT_FOUND;
+    }
+
+    table_clear();
+    esp_err_t err = ESP_OK;
+    uint32_t crc = 0;
+    for (uint32_t i = 0; i < hdr.term_count && err == ESP_OK; i++) {
+        search_file_term_t rec;
+        if (fread(&rec, 1, sizeof(rec), f) != sizeof(rec) || rec.hash == 0 ||
+            rec.len > rec.count * 5) {
+            err = ESP_ERR_INVALID_SIZE;
+            break;
+        }
+        search_term_t *term = term_get(rec.hash);
+        if (!term || term_reserve(term, rec.len) != ESP_OK) {
+            err = ESP_ERR_NO_MEM;
+            break;
+        }
+        if (fread(term->postings, 1, rec.len, f) != rec.len) {
+            err = ESP_ERR_INVALID_SIZE;
+            break;
+        }
+        term->count = rec.count;
+        term->last_id = rec.last_id;
+        term->len = rec.len;
+        crc = esp_rom_crc32_le(crc, (const uint8_t *)&rec, sizeof(rec));
+        crc = esp_rom_crc32_le(crc, term->postings, rec.len);
+    }
+    fclose(f);
+
+    if (err == ESP_OK && crc != hdr.crc) {
+        err = ESP_ERR_INVALID_CRC;
+    }
+    if (err != ESP_OK) {
+        ESP_LOGW(TAG, "Ignoring unreadable search index: %s", esp_err_to_name(err));
+        table_clear();
+        return ESP_ERR_NOT_FOUND;
+    }
+
+    // Deleted notes may linger in the saved lists; queries filter them out.
+    // Notes after covered_id are counted as they are indexed.
+    g_docs = 0;
+    for (size_t i = 0; i < catalog_count(); i++) {
+        if ((uint32_t)strtoul(catalog_at(i)->id, NULL, 16) <= hdr.covered_id) {
+            g_docs++;
+        }
+    }
+    g_saved_covered = hdr.covered_id;
+    grown_load();
+    *covered_id = hdr.covered_id;
+    ESP_LOGI(TAG, "Loaded %" PRIu32 " terms", hdr.term_count);
+    return ESP_OK;
+}
@@ -0,0 +1,111 @@
+#ifndef SEARCH_INDEX_H
+#define SEARCH_INDEX_H
+
+#include "esp_err.h"
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+// Words of one note being indexed; text arrives in chunks
+typedef struct search_doc search_doc_t;
+
+/**
+ * Start with an empty index
+ *
+ * @return ESP_OK on success, ESP_ERR_NO_MEM
+ */
+esp_err_t search_init(void);
+
+/**
+ * Replace the index with the one saved on flash
+ *
+ * @param covered_id Output: every note with an ID up to this one is indexed
+ * @return ESP_OK on success, ESP_ERR_NOT_FOUND if there is no usable saved index
+ */
+esp_err_t search_load(uint32_t *covered_id);
+
+/**
+ * Save the index to flash
+ *
+ * @param covered_id Every note with an ID up to this one is indexed
+ * @return ESP_OK on success
+ */
+esp_err_t search_save(uint32_t covered_id);
+
+/**
+ * Record that words were added to a note the saved index covers (appends),
+ * so it is indexed again after a reboot if the index is not saved before.
+ * Durable when this returns; search_save drops the list.
+ *
+ * @param note_id Numeric note ID
+ * @return ESP_OK on success (also when nothing needs recording), ESP_FAIL
+ */
+esp_err_t search_mark_grown(uint32_t note_id);
+
+/**
+ * Notes recorded by search_mark_grown before the reboot, as loaded by
+ * search_load; re-indexing a note adds nothing twice
+ *
+ * @param ids Output: numeric note IDs, valid until the next search_save
+ * @return Number of notes
+ */
+size_t search_grown_notes(const uint32_t **ids);
+
+/**
+ * Number of index changes since the last search_load/search_save
+ */
+uint32_t search_unsaved_changes(void);
+
+/**
+ * Start indexing a note
+ *
+ * @param note_id Numeric note ID
+ * @param indexed The note is in the index already and only gains words
+ * @param doc Output: document to feed, then commit or discard
+ * @return ESP_OK on success, ESP_ERR_NO_MEM
+ */
+esp_err_t search_doc_begin(uint32_t note_id, bool indexed, search_doc_t **doc);
+
+/**
+ * Feed the next piece of searchable text (words never span two fields;
+ * call search_doc_break between them)
+ */
+void search_doc_feed(search_doc_t *doc, const char *text, size_t len);
+
+/**
+ * End the current word, e.g. between the title and the body
+ */
+void search_doc_break(search_doc_t *doc);
+
+/**
+ * Add the document's words to the index and release it
+ *
+ * @return ESP_OK on success, ESP_ERR_NO_MEM (the note is then not searchable)
+ */
+esp_err_t search_doc_commit(search_doc_t *doc);
+
+/**
+ * Release a document without indexing it (NULL is ignored)
+ */
+void search_doc_discard(search_doc_t *doc);
+
+/**
+ * Forget a note that was removed from the catalog
+ *
+ * @param note_id Numeric note ID
+ */
+void search_remove(uint32_t note_id);
+
+/**
+ * Find cataloged notes of a namespace containing every word of query
+ *
+ * @param ns Namespace
+ * @param query Words to match (case-insensitive, whole words)
+ * @param ids Output: matching note IDs, newest first
+ * @param max_ids Size of ids
+ * @param more Output: true if more notes matched than fit
+ * @return Number of IDs written
+ */
+size_t search_query(uint8_t ns, const char *query, uint32_t *ids, size_t max_ids, bool *more);
+
+#endif // SEARCH_INDEX_H
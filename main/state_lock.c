@@ -0,0 +1,56 @@
+#include "state_lock.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+
+// The first reader in takes g_free for all of them and the last one out
+// gives it back. A waiting writer holds the turnstile, so a steady stream of
+// readers cannot starve it.
+static SemaphoreHandle_t g_turnstile = NULL;
+static SemaphoreHandle_t g_count_lock = NULL;  // Guards g_readers
+static SemaphoreHandle_t g_free = NULL;  // Held by the writer, or by the first reader for all
+static int g_readers = 0;
+
+esp_err_t state_lock_init(void)
+{
+    g_turnstile = xSemaphoreCreateMutex();
+    g_count_lock = xSemaphoreCreateMutex();
+    g_free = xSemaphoreCreateBinary();
+    if (!g_turnstile || !g_count_lock || !g_free) {
+        return ESP_ERR_NO_MEM;
+    }
+    xSemaphoreGive(g_free);
+    return ESP_OK;
+}
+
+void state_read_lock(void)
+{
+    xSemaphoreTake(g_turnstile, portMAX_DELAY);
+    xSemaphoreGive(g_turnstile);
+
+    xSemaphoreTake(g_count_lock, portMAX_DELAY);
+    if (++g_readers == 1) {
+        xSemaphoreTake(g_free, portMAX_DELAY);
+    }
+    xSemaphoreGive(g_count_lock);
+}
+
+void state_read_unlock(void)
+{
+    xSemaphoreTake(g_count_lock, portMAX_DELAY);
+    if (--g_readers == 0) {
+        xSemaphoreGive(g_free);
+    }
+    xSemaphoreGive(g_count_lock);
+}
+
+void state_write_lock(void)
+{
+    xSemaphoreTake(g_turnstile, portMAX_DELAY);
+    xSemaphoreTake(g_free, portMAX_DELAY);
+}
+
+void state_write_unlock(void)
+{
+    xSemaphoreGive(g_free);
+    xSemaphoreGive(g_turnstile);
+}
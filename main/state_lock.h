@@ -0,0 +1,36 @@
+#ifndef STATE_LOCK_H
+#define STATE_LOCK_H
+
+#include "esp_err.h"
+
+/**
+ * Create the reader/writer lock guarding the in-memory indexes (catalog,
+ * search postings, namespace names)
+ *
+ * @return ESP_OK on success, ESP_ERR_NO_MEM
+ */
+esp_err_t state_lock_init(void);
+
+/**
+ * Shared lock, for any task but the storage worker. Readers run side by
+ * side; a waiting writer keeps new readers out until it is done.
+ */
+void state_read_lock(void);
+
+/**
+ * Release a shared lock
+ */
+void state_read_unlock(void);
+
+/**
+ * Exclusive lock, taken by the storage worker only to change the indexes
+ * (it reads them without locking, as nobody else writes)
+ */
+void state_write_lock(void);
+
+/**
+ * Release the exclusive lock
+ */
+void state_write_unlock(void);
+
+#endif // STATE_LOCK_H
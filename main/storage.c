@@ -1,24 +1,177 @@
 #include "storage.h"
+#include "catalog.h"
+#include "storage_engine.h"
+#include "storage_fs.h"
+#include "checkpoint.h"
+#include "note_codec.h"
+#include "search_index.h"
+#include "state_lock.h"
+#include "expiry.h"
+#include "body_cache.h"
+#include "reclaim.h"
+#include "namespace.h"
+#include "esp_heap_caps.h"
 #include "esp_log.h"
-#include "esp_spiffs.h"
+#include "esp_timer.h"
+#include "esp_random.h"
+#include "sdkconfig.h"
+#if CONFIG_SPI_FLASH_ENABLE_COUNTERS
+#include "esp_flash.h"
+#endif
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/queue.h"
+#include "freertos/semphr.h"
 #include "nvs_flash.h"
 #include "nvs.h"
-#include "cJSON.h"
 #include <string.h>
+#include <stdlib.h>
 #include <sys/stat.h>
 #include <dirent.h>
 #include <time.h>
-#include <unistd.h>
 #include <inttypes.h>
-#include <errno.h>
 
 static const char *TAG = "storage";
 static nvs_handle_t g_nvs_handle;
+static uint32_t g_next_id = 1;
+static uint32_t g_reserved_id = 0;
+
+#if CONFIG_DEADDROP_STORAGE_FS_LITTLEFS
+static const storage_fs_t *g_fs = &storage_fs_littlefs;
+#else
+static const storage_fs_t *g_fs = &storage_fs_spiffs;
+#endif
+
+#if CONFIG_DEADDROP_STORAGE_ENGINE_SLOTS
+static const storage_engine_t *g_engine = &storage_engine_slots;
+#elif CONFIG_DEADDROP_STORAGE_ENGINE_LOG
+static const storage_engine_t *g_engine = &storage_engine_log;
+#else
+static const storage_engine_t *g_engine = &storage_engine_files;
+#endif
+
+// Every storage operation that touches flash runs on one worker task. Callers
+// queue an op and block until it completes; body reads jump the queue so they
+// never wait behind a backlog of writes.
+typedef esp_err_t (*storage_op_fn_t)(void *ctx);
+
+typedef struct {
+    storage_op_fn_t fn;
+    storage_op_fn_t publish;  // Set for note commits: runs after the batch is synced
+    void *ctx;
+    esp_err_t result;
+    SemaphoreHandle_t done;   // NULL for background ops nobody waits for
+    StaticSemaphore_t done_buf;
+} storage_op_t;
+
+static QueueHandle_t g_queue = NULL;
+
+// The in-memory indexes (catalog, search postings, namespace names) are read
+// on the caller's task under a shared lock (state_lock.c), so lists, searches
+// and stats from several tasks run side by side on either core. The worker is
+// their only writer; it takes the lock exclusively just around each change,
+// never while a note is written or synced.
+
+// Notes between begin and commit/abort. Their IDs are already allocated, so a
+// checkpoint taken now could not promise every lower ID is settled.
+static uint32_t g_open_writers = 0;
+
+// Notes with an append in progress; a second append to one is refused
+static uint32_t g_appending[STORAGE_MAX_APPENDS];
+
+// Notes up to this ID were in the saved search index; the rest are indexed
+// by the worker before it takes the first request
+static uint32_t g_search_covered = 0;
+
+// Flash wear accounting. Writes and erases since the last switch are charged
+// to g_wear_kind; only the storage task switches. g_counters_lock lets stats
+// read these and the commit latencies from other tasks.
+static portMUX_TYPE g_counters_lock = portMUX_INITIALIZER_UNLOCKED;
+static storage_wear_t g_wear[STORAGE_WEAR_COUNT];
+static storage_wear_kind_t g_wear_kind = STORAGE_WEAR_BACKGROUND;
+static uint32_t g_wear_written = 0;  // Counter values at the last switch
+static uint32_t g_wear_erased = 0;
+
+// Idle-time filesystem GC. Paused while clients may be around so a create
+// never queues behind it; g_gc_pending is set whenever notes were written
+// or removed since GC last reached FS_GC_HEADROOM.
+static volatile bool g_maintenance = false;
+static bool g_gc_pending = true;
+static size_t g_gc_size = 0;  // Space asked of the filesystem so far in this pass
+
+// Bumped by the worker whenever the notes a list or stats response is built
+// from change; random at boot so validators from before a reboot never match
+static volatile uint32_t g_generation = 0;
+
+// Commit latency histogram, STORAGE_LATENCY_BUCKETS log2 buckets of ms
+static uint32_t g_commit_hist[STORAGE_LATENCY_BUCKETS];
+static uint32_t g_commit_max_ms = 0;
+
+static esp_err_t load_catalog(bool *checkpointed);
+static void write_checkpoint(void);
+
+static esp_err_t init_note_ids(void);
+static void storage_task(void *arg);
+
+// Space available to notes: the engine's own partition, or the filesystem
+static esp_err_t space_info(size_t *total, size_t *used)
+{
+    return g_engine->info ? g_engine->info(total, used) : g_fs->info(total, used);
+}
+
+static void wear_sample(uint32_t *written, uint32_t *erased)
+{
+#if CONFIG_SPI_FLASH_ENABLE_COUNTERS
+    esp_flash_counters_t counters;
+    esp_flash_get_counters(&counters);
+    *written = counters.write.bytes;
+    *erased = counters.erase.bytes;
+#else
+    *written = 0;
+    *erased = 0;
+#endif
+}
+
+// Charge flash activity since the last switch, then start charging kind.
+// Returns the previous kind so nested work can switch back.
+static storage_wear_kind_t wear_switch(storage_wear_kind_t kind)
+{
+    taskENTER_CRITICAL(&g_counters_lock);
+    uint32_t written, erased;
+    wear_sample(&written, &erased);
+
+    // Unsigned differences stay correct across a 32-bit counter wrap
+    g_wear[g_wear_kind].written_bytes += written - g_wear_written;
+    g_wear[g_wear_kind].erased_bytes += erased - g_wear_erased;
+    g_wear_written = written;
+    g_wear_erased = erased;
+
+    storage_wear_kind_t prev = g_wear_kind;
+    g_wear_kind = kind;
+    taskEXIT_CRITICAL(&g_counters_lock);
+    return prev;
+}
+
+static void wear_count(storage_wear_kind_t kind, uint32_t logical_bytes)
+{
+    taskENTER_CRITICAL(&g_counters_lock);
+    g_wear[kind].ops++;
+    g_wear[kind].logical_bytes += logical_bytes;
+    taskEXIT_CRITICAL(&g_counters_lock);
+}
 
 esp_err_t storage_init(void)
 {
+    wear_sample(&g_wear_written, &g_wear_erased);
+    g_generation = esp_random();
+
+    esp_err_t err = state_lock_init();
+    if (err != ESP_OK) {
+        return err;
+    }
+
     // Initialize NVS
-    esp_err_t err = nvs_flash_init();
+    err = nvs_flash_init();
     if (err == ESP_ERR_NVS_NO_FREE_PAGES || err == ESP_ERR_NVS_NEW_VERSION_FOUND) {
         ESP_LOGW(TAG, "NVS partition was truncated, erasing...");
         ESP_ERROR_CHECK(nvs_flash_erase());
@@ -36,298 +189,1793 @@ esp_err_t storage_init(void)
         return err;
     }
 
-    // Configure SPIFFS
-    esp_vfs_spiffs_conf_t conf = {
-        .base_path = SPIFFS_BASE_PATH,
-        .partition_label = SPIFFS_PARTITION_LABEL,
-        .max_files = SPIFFS_MAX_FILES,
-        .format_if_mount_failed = true
-    };
-
-    // Mount SPIFFS
-    err = esp_vfs_spiffs_register(&conf);
+    // Mount the storage partition
+    err = g_fs->mount();
     if (err != ESP_OK) {
-        ESP_LOGE(TAG, "Failed to mount SPIFFS: %s", esp_err_to_name(err));
         return err;
     }
 
-    // Check SPIFFS info
+    // Check filesystem info
     size_t total = 0, used = 0;
-    err = esp_spiffs_info(SPIFFS_PARTITION_LABEL, &total, &used);
+    err = g_fs->info(&total, &used);
     if (err == ESP_OK) {
-        ESP_LOGI(TAG, "SPIFFS: %d KB total, %d KB used", total / 1024, used / 1024);
+        ESP_LOGI(TAG, "%s: %d KB total, %d KB used", g_fs->name, total / 1024, used / 1024);
     } else {
-        ESP_LOGE(TAG, "Failed to get SPIFFS info: %s", esp_err_to_name(err));
+        ESP_LOGE(TAG, "Failed to get %s info: %s", g_fs->name, esp_err_to_name(err));
     }
 
-    // Verify SPIFFS is writable by testing directory access
-    DIR *dir = opendir(SPIFFS_BASE_PATH);
+    // Verify the filesystem is writable by testing directory access
+    DIR *dir = opendir(STORAGE_BASE_PATH);
     if (dir) {
         closedir(dir);
-        ESP_LOGI(TAG, "SPIFFS directory accessible");
+        ESP_LOGI(TAG, "Storage directory accessible");
     } else {
-        ESP_LOGE(TAG, "Cannot access SPIFFS directory: %s", SPIFFS_BASE_PATH);
+        ESP_LOGE(TAG, "Cannot access storage directory: %s", STORAGE_BASE_PATH);
+    }
+
+    // Deletes whose removal was still pending must not come back
+    err = reclaim_init();
+    if (err != ESP_OK) {
+        return err;
+    }
+    err = namespace_init();
+    if (err != ESP_OK) {
+        return err;
+    }
+
+    // Build the in-memory catalog once; list/read/delete consult it afterwards
+    ESP_LOGI(TAG, "Using %s storage engine", g_engine->name);
+    int64_t load_start = esp_timer_get_time();
+    bool checkpointed = false;
+    err = load_catalog(&checkpointed);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to build note catalog: %s", esp_err_to_name(err));
+        return err;
+    }
+    ESP_LOGI(TAG, "Cataloged %zu notes in %lld ms (%s)", catalog_count(),
+             (long long)((esp_timer_get_time() - load_start) / 1000),
+             checkpointed ? "checkpoint" : "full scan");
+
+    err = init_note_ids();
+    if (err != ESP_OK) {
+        return err;
+    }
+
+    // Start a fresh checkpoint after a full scan or a long journal replay
+    if (g_engine->recover && (!checkpointed || checkpoint_due())) {
+        write_checkpoint();
+    }
+
+    err = expiry_init();
+    if (err != ESP_OK) {
+        return err;
+    }
+
+    err = search_init();
+    if (err != ESP_OK) {
+        return err;
+    }
+    if (search_load(&g_search_covered) != ESP_OK) {
+        g_search_covered = 0;
+    }
+
+    // Keep flash I/O off the WiFi/BLE core and off the HTTPS server task
+    g_queue = xQueueCreate(STORAGE_QUEUE_LENGTH, sizeof(storage_op_t *));
+    if (!g_queue) {
+        return ESP_ERR_NO_MEM;
+    }
+    if (xTaskCreatePinnedToCore(storage_task, "storage", STORAGE_TASK_STACK_SIZE, NULL,
+                                STORAGE_TASK_PRIORITY, NULL, STORAGE_TASK_CORE) != pdPASS) {
+        ESP_LOGE(TAG, "Failed to start storage task");
+        vQueueDelete(g_queue);
+        g_queue = NULL;
+        return ESP_FAIL;
     }
 
     ESP_LOGI(TAG, "Storage initialized");
     return ESP_OK;
 }
 
-static uint32_t get_next_note_id(void)
+// IDs are handed out from a block reserved in NVS with a single commit.
+// "note_counter" holds the highest ID that may have been used, so after a
+// reboot allocation resumes past the whole block and unused IDs are skipped.
+static esp_err_t reserve_note_ids(uint32_t from)
+{
+    uint32_t limit = from + NOTE_ID_BLOCK_SIZE - 1;
+    storage_wear_kind_t prev = wear_switch(STORAGE_WEAR_NOTE_IDS);
+    esp_err_t err = nvs_set_u32(g_nvs_handle, "note_counter", limit);
+    if (err == ESP_OK) {
+        err = nvs_commit(g_nvs_handle);
+    }
+    wear_count(STORAGE_WEAR_NOTE_IDS, sizeof(limit));
+    wear_switch(prev);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to reserve note IDs: %s", esp_err_to_name(err));
+        return err;
+    }
+
+    g_reserved_id = limit;
+    return ESP_OK;
+}
+
+static esp_err_t init_note_ids(void)
 {
     uint32_t counter = 0;
     nvs_get_u32(g_nvs_handle, "note_counter", &counter);
-    counter++;
-    nvs_set_u32(g_nvs_handle, "note_counter", counter);
-    nvs_commit(g_nvs_handle);
-    return counter;
+
+    // Never reuse an ID that is on flash, even if NVS was erased
+    const note_metadata_t *newest = catalog_at(catalog_count() - 1);
+    if (newest) {
+        uint32_t newest_id = (uint32_t)strtoul(newest->id, NULL, 16);
+        if (newest_id > counter) {
+            ESP_LOGW(TAG, "Note counter %" PRIu32 " behind stored notes, advancing to %" PRIu32,
+                     counter, newest_id);
+            counter = newest_id;
+        }
+    }
+
+    g_next_id = counter + 1;
+    g_reserved_id = counter;
+    return ESP_OK;
 }
 
-esp_err_t storage_create_note(const char *title, const char *message,
-                               bool encrypted, char *note_id)
+static void write_checkpoint(void)
 {
-    if (!title || !message || !note_id) {
-        return ESP_ERR_INVALID_ARG;
+    storage_wear_kind_t prev = wear_switch(STORAGE_WEAR_INDEX);
+    checkpoint_write(g_next_id);
+    wear_count(STORAGE_WEAR_INDEX, 0);
+    wear_switch(prev);
+}
+
+// Snapshot the catalog once the journal is long enough, unless an upload is
+// in flight: its ID is below g_next_id but the note is not cataloged yet
+static void maybe_checkpoint(void)
+{
+    if (g_engine->recover && g_open_writers == 0 && checkpoint_due()) {
+        write_checkpoint();
+    }
+}
+
+// Same rule for the search index: saving rewrites all of it, so wait for a
+// share of the catalog to change, and never with an upload in flight
+static void maybe_save_search(void)
+{
+    uint32_t threshold = catalog_count() / 4;
+    if (threshold < SEARCH_SAVE_MIN) {
+        threshold = SEARCH_SAVE_MIN;
+    } else if (threshold > SEARCH_SAVE_MAX) {
+        threshold = SEARCH_SAVE_MAX;
+    }
+    if (g_open_writers == 0 && search_unsaved_changes() >= threshold) {
+        storage_wear_kind_t prev = wear_switch(STORAGE_WEAR_INDEX);
+        search_save(g_next_id - 1);
+        wear_switch(prev);
+    }
+}
+
+static esp_err_t get_next_note_id(uint32_t *id)
+{
+    if (g_next_id > g_reserved_id) {
+        esp_err_t err = reserve_note_ids(g_next_id);
+        if (err != ESP_OK) {
+            return err;
+        }
+    }
+
+    *id = g_next_id++;
+    return ESP_OK;
+}
+
+// Worker task
+
+// Queue fn behind everything already queued, or ahead of it when urgent;
+// wait_op collects the result
+static esp_err_t queue_op(storage_op_t *op, storage_op_fn_t fn, storage_op_fn_t publish,
+                          void *ctx, bool urgent)
+{
+    *op = (storage_op_t){ .fn = fn, .publish = publish, .ctx = ctx };
+    op->done = xSemaphoreCreateBinaryStatic(&op->done_buf);
+
+    BaseType_t queued = urgent ? xQueueSendToFront(g_queue, &op, portMAX_DELAY)
+                               : xQueueSendToBack(g_queue, &op, portMAX_DELAY);
+    if (queued != pdTRUE) {
+        vSemaphoreDelete(op->done);
+        return ESP_FAIL;
+    }
+    return ESP_OK;
+}
+
+static esp_err_t wait_op(storage_op_t *op)
+{
+    xSemaphoreTake(op->done, portMAX_DELAY);
+    vSemaphoreDelete(op->done);
+    return op->result;
+}
+
+// Run fn once the worker has finished everything queued before it, or ahead
+// of everything queued when urgent
+static esp_err_t run_op(storage_op_fn_t fn, storage_op_fn_t publish, void *ctx, bool urgent)
+{
+    storage_op_t op;
+    esp_err_t err = queue_op(&op, fn, publish, ctx, urgent);
+    return err == ESP_OK ? wait_op(&op) : err;
+}
+
+// Run fn on the calling task; it may only read the in-memory indexes
+static esp_err_t run_read(storage_op_fn_t fn, void *ctx)
+{
+    state_read_lock();
+    esp_err_t err = fn(ctx);
+    state_read_unlock();
+    return err;
+}
+
+static void complete_op(storage_op_t *op)
+{
+    if (op->done) {
+        xSemaphoreGive(op->done);
+    }
+}
+
+static void index_missing_notes(void);
+static TickType_t sweep_expired(void);
+static TickType_t idle_wait(void);
+static void idle_work(void);
+
+static void commit_latency(int64_t us)
+{
+    uint32_t ms = (uint32_t)(us / 1000);
+    size_t bucket = 0;
+    while (bucket < STORAGE_LATENCY_BUCKETS - 1 && ms >= (1u << bucket)) {
+        bucket++;
+    }
+    taskENTER_CRITICAL(&g_counters_lock);
+    g_commit_hist[bucket]++;
+    if (ms > g_commit_max_ms) {
+        g_commit_max_ms = ms;
+    }
+    taskEXIT_CRITICAL(&g_counters_lock);
+}
+
+static void storage_task(void *arg)
+{
+    storage_op_t *batch[STORAGE_GROUP_COMMIT_MAX];
+
+    index_missing_notes();
+
+    while (1) {
+        // Expired notes are deleted between requests; the wait ends in time
+        // for the next one to expire, or for idle work once requests stop
+        TickType_t wait = sweep_expired();
+        TickType_t idle = idle_wait();
+        if (idle < wait) {
+            wait = idle;
+        }
+        storage_op_t *op;
+        if (xQueueReceive(g_queue, &op, wait) != pdTRUE) {
+            idle_work();
+            continue;
+        }
+        int64_t start = esp_timer_get_time();
+        op->result = op->fn(op->ctx);
+        if (!op->publish) {
+            complete_op(op);
+            wear_switch(STORAGE_WEAR_BACKGROUND);
+            continue;
+        }
+
+        // Group commit: note writes queued right behind this one share a
+        // single engine sync, after which all of them become visible. Urgent
+        // ops can jump to the front at any time, so the first op without a
+        // publish step ends the batch and runs once it is published.
+        size_t count = 0;
+        storage_op_t *next = NULL;
+        batch[count++] = op;
+        while (count < STORAGE_GROUP_COMMIT_MAX && xQueueReceive(g_queue, &op, 0) == pdTRUE) {
+            if (!op->publish) {
+                next = op;
+                break;
+            }
+            op->result = op->fn(op->ctx);
+            batch[count++] = op;
+        }
+
+        wear_switch(STORAGE_WEAR_NOTES);
+        esp_err_t err = g_engine->sync();
+        if (err != ESP_OK) {
+            ESP_LOGE(TAG, "Failed to sync %zu notes: %s", count, esp_err_to_name(err));
+        } else if (count > 1) {
+            ESP_LOGD(TAG, "Committed %zu notes with one sync", count);
+        }
+
+        int64_t elapsed = esp_timer_get_time() - start;
+        for (size_t i = 0; i < count; i++) {
+            op = batch[i];
+            if (op->result == ESP_OK) {
+                op->result = err == ESP_OK ? op->publish(op->ctx) : err;
+            }
+            commit_latency(elapsed);
+            complete_op(op);
+        }
+        g_gc_pending = true;
+
+        if (next) {
+            wear_switch(STORAGE_WEAR_BACKGROUND);
+            next->result = next->fn(next->ctx);
+            complete_op(next);
+        }
+
+        // The journal only speeds up the next boot, so callers need not wait
+        if (g_engine->recover) {
+            wear_switch(STORAGE_WEAR_INDEX);
+            checkpoint_sync();
+            maybe_checkpoint();
+        }
+        maybe_save_search();
+        wear_switch(STORAGE_WEAR_BACKGROUND);
+    }
+}
+
+// Note writes
+
+static esp_err_t begin_note(uint8_t ns, const char *title, bool encrypted, uint64_t timestamp,
+                            uint64_t expires_at, size_t size, storage_writer_t *writer)
+{
+    wear_switch(STORAGE_WEAR_NOTES);
+
+    // An expiry is only meaningful once the browser has set the clock
+    time_t now = time(NULL);
+    if (expires_at != 0) {
+        if (now < EXPIRY_CLOCK_VALID_AFTER) {
+            ESP_LOGW(TAG, "Clock not set, cannot create an expiring note");
+            return ESP_ERR_INVALID_STATE;
+        }
+        if (expires_at <= (uint64_t)now) {
+            return ESP_ERR_INVALID_ARG;
+        }
     }
 
     // Check max note count (if limit is set)
 #if MAX_NOTE_COUNT > 0
-    storage_stats_t stats;
-    storage_get_stats(&stats);
-    if (stats.count >= MAX_NOTE_COUNT) {
+    if (catalog_count() >= MAX_NOTE_COUNT) {
         ESP_LOGE(TAG, "Maximum note count reached");
         return ESP_ERR_NO_MEM;
     }
 #endif
 
-    // Check message size
-    size_t message_len = strlen(message);
-    if (message_len > MAX_NOTE_SIZE_BYTES) {
+    // Check message size, and reject early what cannot fit on the partition
+    if (size > MAX_UPLOAD_SIZE_BYTES) {
         ESP_LOGE(TAG, "Message too large");
         return ESP_ERR_INVALID_SIZE;
     }
+    size_t total = 0, used = 0;
+    // SPIFFS can report used > total after a power cut
+    if (space_info(&total, &used) == ESP_OK &&
+        (used >= total || size > total - used)) {
+        ESP_LOGE(TAG, "Not enough space for %zu byte message", size);
+        return ESP_ERR_NO_MEM;
+    }
 
     // Generate note ID
-    uint32_t id_num = get_next_note_id();
-    snprintf(note_id, 16, "%08" PRIx32, id_num);
+    uint32_t id_num;
+    esp_err_t err = get_next_note_id(&id_num);
+    if (err != ESP_OK) {
+        return err;
+    }
 
     // Create metadata
-    note_metadata_t meta;
-    memset(&meta, 0, sizeof(meta));
-    strncpy(meta.id, note_id, sizeof(meta.id) - 1);
-    strncpy(meta.title, title, sizeof(meta.title) - 1);
-    meta.timestamp = (uint64_t)time(NULL);
-    meta.encrypted = encrypted;
-
-    // Save metadata file
-    char meta_path[64];
-    snprintf(meta_path, sizeof(meta_path), "%s/note_%s.meta", SPIFFS_BASE_PATH, note_id);
-
-    cJSON *json = cJSON_CreateObject();
-    cJSON_AddStringToObject(json, "id", meta.id);
-    cJSON_AddStringToObject(json, "title", meta.title);
-    cJSON_AddNumberToObject(json, "timestamp", (double)meta.timestamp);
-    cJSON_AddBoolToObject(json, "encrypted", meta.encrypted);
-
-    char *json_str = cJSON_PrintUnformatted(json);
-    cJSON_Delete(json);
-
-    FILE *f = fopen(meta_path, "w");
-    if (!f) {
-        ESP_LOGE(TAG, "Failed to create metadata file: %s (errno=%d)", meta_path, errno);
-        free(json_str);
-        return ESP_FAIL;
-    }
-    fprintf(f, "%s", json_str);
-    fclose(f);
-    free(json_str);
+    note_metadata_t *meta = &writer->meta;
+    memset(meta, 0, sizeof(*meta));
+    snprintf(meta->id, sizeof(meta->id), "%08" PRIx32, id_num);
+    strncpy(meta->title, title, sizeof(meta->title) - 1);
+    meta->ns = ns;
+    meta->timestamp = timestamp ? timestamp : (uint64_t)now;
+    meta->expires_at = expires_at;
+    meta->size = (uint32_t)size;
+    meta->encrypted = encrypted;
+    writer->written = 0;
+    writer->append = false;
+    writer->base = 0;
+    writer->codec = NULL;
+    writer->search = NULL;
 
-    // Save message content file (plain or encrypted, as received from client)
-    char msg_path[64];
-    snprintf(msg_path, sizeof(msg_path), "%s/note_%s.txt", SPIFFS_BASE_PATH, note_id);
+    // Ciphertext never compresses; plaintext is usually text that does
+#if STORAGE_COMPRESS_PLAINTEXT
+    if (!encrypted && size >= STORAGE_COMPRESS_MIN_SIZE &&
+        note_encoder_create((note_encoder_t **)&writer->codec) == ESP_OK) {
+        meta->compressed = true;
+    }
+#endif
 
-    f = fopen(msg_path, "w");
-    if (!f) {
-        ESP_LOGE(TAG, "Failed to create message file: %s (errno=%d)", msg_path, errno);
-        return ESP_FAIL;
+    err = g_engine->create(meta, &writer->handle);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to start note %s: %s", meta->id, esp_err_to_name(err));
+        note_encoder_free(writer->codec);
+        writer->codec = NULL;
+        writer->handle = NULL;
+        return err;
     }
-    fprintf(f, "%s", message);
-    fclose(f);
+    g_open_writers++;
 
-    ESP_LOGI(TAG, "Created note %s: meta=%s, msg=%s, encrypted=%d", 
-             note_id, meta_path, msg_path, encrypted);
+    // Without a document the note is stored but not searchable
+    if (search_doc_begin(id_num, false, (search_doc_t **)&writer->search) == ESP_OK) {
+        search_doc_feed(writer->search, meta->title, strlen(meta->title));
+        search_doc_break(writer->search);
+    } else {
+        writer->search = NULL;
+    }
     return ESP_OK;
 }
 
-static esp_err_t load_metadata(const char *note_id, note_metadata_t *meta)
+static esp_err_t write_chunk(storage_writer_t *writer, const char *data, size_t len)
 {
-    char meta_path[64];
-    snprintf(meta_path, sizeof(meta_path), "%s/note_%s.meta", SPIFFS_BASE_PATH, note_id);
+    wear_switch(STORAGE_WEAR_NOTES);
+    if (len > writer->meta.size - writer->written) {
+        return ESP_ERR_INVALID_SIZE;
+    }
 
-    FILE *f = fopen(meta_path, "r");
-    if (!f) {
-        ESP_LOGW(TAG, "Metadata file not found: %s", meta_path);
-        return ESP_ERR_NOT_FOUND;
+    esp_err_t err = writer->codec
+                        ? note_encoder_write(writer->codec, data, len, g_engine->append,
+                                             writer->handle)
+                        : g_engine->append(writer->handle, data, len);
+    if (err == ESP_OK) {
+        writer->written += len;
+        if (writer->search && !writer->meta.encrypted) {
+            search_doc_feed(writer->search, data, len);
+        }
     }
+    return err;
+}
 
-    fseek(f, 0, SEEK_END);
-    long fsize = ftell(f);
-    fseek(f, 0, SEEK_SET);
+static esp_err_t begin_append(uint8_t ns, const char *note_id, size_t size,
+                              storage_writer_t *writer)
+{
+    wear_switch(STORAGE_WEAR_NOTES);
 
-    char *json_str = malloc(fsize + 1);
-    if (!json_str) {
-        fclose(f);
+    const note_metadata_t *cached = catalog_find(note_id);
+    time_t now = time(NULL);
+    if (!cached || cached->ns != ns || (cached->expires_at != 0 && cached->expires_at <= (uint64_t)now)) {
+        return ESP_ERR_NOT_FOUND;
+    }
+    if (!g_engine->extend) {
+        return ESP_ERR_NOT_SUPPORTED;
+    }
+    if (size > MAX_UPLOAD_SIZE_BYTES - cached->size) {
+        ESP_LOGE(TAG, "Note %s would grow too large", note_id);
+        return ESP_ERR_INVALID_SIZE;
+    }
+    size_t total = 0, used = 0;
+    if (space_info(&total, &used) == ESP_OK && (used >= total || size > total - used)) {
+        ESP_LOGE(TAG, "Not enough space to append %zu bytes", size);
         return ESP_ERR_NO_MEM;
     }
 
-    fread(json_str, 1, fsize, f);
-    fclose(f);
-    json_str[fsize] = 0;
+    uint32_t id_num = (uint32_t)strtoul(note_id, NULL, 16);
+    uint32_t *slot = NULL;
+    for (size_t i = 0; i < STORAGE_MAX_APPENDS; i++) {
+        if (g_appending[i] == id_num) {
+            return ESP_ERR_INVALID_STATE;
+        }
+        if (g_appending[i] == 0 && !slot) {
+            slot = &g_appending[i];
+        }
+    }
+    if (!slot) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    note_metadata_t *meta = &writer->meta;
+    *meta = *cached;
+    meta->size += (uint32_t)size;
+    meta->timestamp = (uint64_t)now;
+    writer->written = cached->size;
+    writer->append = true;
+    writer->base = cached->size;
+    writer->codec = NULL;
+    writer->search = NULL;
 
-    cJSON *json = cJSON_Parse(json_str);
-    free(json_str);
+    // Compressed bodies are independent frames, so new ones simply follow
+    if (meta->compressed) {
+        esp_err_t err = note_encoder_create((note_encoder_t **)&writer->codec);
+        if (err != ESP_OK) {
+            return err;
+        }
+    }
 
-    if (!json) {
-        ESP_LOGE(TAG, "Failed to parse metadata JSON for note %s", note_id);
-        return ESP_FAIL;
+    esp_err_t err = g_engine->extend(meta, writer->base, &writer->handle);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to extend note %s: %s", meta->id, esp_err_to_name(err));
+        note_encoder_free(writer->codec);
+        writer->codec = NULL;
+        writer->handle = NULL;
+        return err;
     }
+    g_open_writers++;
+    *slot = id_num;
 
-    memset(meta, 0, sizeof(note_metadata_t));
-    
-    cJSON *item = cJSON_GetObjectItem(json, "id");
-    if (item) strncpy(meta->id, item->valuestring, sizeof(meta->id) - 1);
-    
-    item = cJSON_GetObjectItem(json, "title");
-    if (item) strncpy(meta->title, item->valuestring, sizeof(meta->title) - 1);
-    
-    item = cJSON_GetObjectItem(json, "timestamp");
-    if (item) meta->timestamp = (uint64_t)item->valuedouble;
+    // The title is indexed already; only new body words are added
+    if (meta->encrypted ||
+        search_doc_begin(id_num, true, (search_doc_t **)&writer->search) != ESP_OK) {
+        writer->search = NULL;
+    }
+    return ESP_OK;
+}
 
-    item = cJSON_GetObjectItem(json, "encrypted");
-    if (item) meta->encrypted = cJSON_IsTrue(item);
+static void append_done(storage_writer_t *writer)
+{
+    uint32_t id_num = (uint32_t)strtoul(writer->meta.id, NULL, 16);
+    for (size_t i = 0; i < STORAGE_MAX_APPENDS; i++) {
+        if (g_appending[i] == id_num) {
+            g_appending[i] = 0;
+        }
+    }
+}
 
-    cJSON_Delete(json);
-    return ESP_OK;
+static void abort_note(storage_writer_t *writer)
+{
+    wear_switch(STORAGE_WEAR_NOTES);
+    if (writer->append && writer->handle) {
+        append_done(writer);
+    }
+    if (writer->handle) {
+        g_engine->abort(writer->handle);
+        writer->handle = NULL;
+        g_open_writers--;
+    }
+    note_encoder_free(writer->codec);
+    writer->codec = NULL;
+    search_doc_discard(writer->search);
+    writer->search = NULL;
 }
 
-esp_err_t storage_list_notes(note_metadata_t *notes, size_t max_notes, size_t *count)
+typedef struct {
+    storage_writer_t *writer;
+    char *note_id;
+} commit_ctx_t;
+
+// First half of a commit: hand the note to the engine (not yet durable)
+static esp_err_t commit_write(void *arg)
 {
-    if (!notes || !count) {
-        return ESP_ERR_INVALID_ARG;
+    commit_ctx_t *ctx = arg;
+    storage_writer_t *writer = ctx->writer;
+    const note_metadata_t *meta = &writer->meta;
+    wear_switch(STORAGE_WEAR_NOTES);
+
+    // Deleted (or expired) while the append was under way
+    if (writer->append && !catalog_find(meta->id)) {
+        abort_note(writer);
+        return ESP_ERR_NOT_FOUND;
     }
 
-    *count = 0;
-    DIR *dir = opendir(SPIFFS_BASE_PATH);
-    if (!dir) {
-        ESP_LOGE(TAG, "Failed to open SPIFFS directory: %s (errno=%d)", SPIFFS_BASE_PATH, errno);
-        return ESP_FAIL;
+    if (writer->written != meta->size) {
+        ESP_LOGE(TAG, "Note %s truncated (%" PRIu32 " of %" PRIu32 " bytes)",
+                 meta->id, writer->written, meta->size);
+        abort_note(writer);
+        return ESP_ERR_INVALID_SIZE;
     }
 
-    ESP_LOGI(TAG, "Scanning for notes in %s", SPIFFS_BASE_PATH);
-    struct dirent *entry;
-    while ((entry = readdir(dir)) != NULL && *count < max_notes) {
-        // Look for .meta files
-        if (strstr(entry->d_name, ".meta")) {
-            ESP_LOGI(TAG, "Found metadata file: %s", entry->d_name);
-            // Extract note ID
-            char note_id[16];
-            sscanf(entry->d_name, "note_%[^.].meta", note_id);
-            
-            if (load_metadata(note_id, &notes[*count]) == ESP_OK) {
-                ESP_LOGI(TAG, "Loaded note: id=%s, title=%s", notes[*count].id, notes[*count].title);
-                (*count)++;
-            } else {
-                ESP_LOGW(TAG, "Failed to load metadata for %s", note_id);
-            }
+    if (writer->codec) {
+        uint32_t stored = 0;
+        esp_err_t err = note_encoder_finish(writer->codec, g_engine->append, writer->handle,
+                                            &stored);
+        if (err != ESP_OK) {
+            ESP_LOGE(TAG, "Failed to compress note %s: %s", meta->id, esp_err_to_name(err));
+            abort_note(writer);
+            return err;
         }
+        ESP_LOGI(TAG, "Note %s compressed to %" PRIu32 " of %" PRIu32 " bytes",
+                 meta->id, stored, meta->size);
+        note_encoder_free(writer->codec);
+        writer->codec = NULL;
     }
 
-    closedir(dir);
-    ESP_LOGI(TAG, "Found %d notes", *count);
-    return ESP_OK;
+    // Persist metadata and message (plain or encrypted, as received from client)
+    if (writer->append) {
+        append_done(writer);
+    }
+    esp_err_t err = g_engine->commit(writer->handle);
+    writer->handle = NULL;
+    g_open_writers--;
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to store note %s: %s", meta->id, esp_err_to_name(err));
+    }
+    return err;
 }
 
-esp_err_t storage_read_note(const char *note_id, char *message, size_t *message_len,
-                            note_metadata_t *metadata)
+// Second half, after the engine sync: make the note visible
+static esp_err_t commit_publish(void *arg)
 {
-    if (!note_id || !message || !message_len || !metadata) {
-        return ESP_ERR_INVALID_ARG;
-    }
+    commit_ctx_t *ctx = arg;
+    const note_metadata_t *meta = &ctx->writer->meta;
 
-    // Load metadata
-    esp_err_t err = load_metadata(note_id, metadata);
+    bool indexed = ctx->writer->search != NULL;
+    state_write_lock();
+    esp_err_t err = catalog_insert(meta);
+    if (err == ESP_OK && ctx->writer->search) {
+        search_doc_commit(ctx->writer->search);
+        ctx->writer->search = NULL;
+    }
+    if (err == ESP_OK) {
+        g_generation++;
+    }
+    state_write_unlock();
     if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to catalog note %s", meta->id);
+        g_engine->remove(meta);
         return err;
     }
 
-    // Load message content (plain or encrypted)
-    char msg_path[64];
-    snprintf(msg_path, sizeof(msg_path), "%s/note_%s.txt", SPIFFS_BASE_PATH, note_id);
-
-    FILE *f = fopen(msg_path, "r");
-    if (!f) {
-        ESP_LOGE(TAG, "Failed to open message file: %s", msg_path);
-        return ESP_ERR_NOT_FOUND;
+    if (g_engine->recover) {
+        checkpoint_log_put(meta);
     }
+    strncpy(ctx->note_id, meta->id, 16);
 
-    fseek(f, 0, SEEK_END);
-    long fsize = ftell(f);
-    fseek(f, 0, SEEK_SET);
-
-    if (fsize > (long)*message_len) {
-        fclose(f);
-        ESP_LOGE(TAG, "Message buffer too small");
-        return ESP_ERR_INVALID_SIZE;
+    if (ctx->writer->append) {
+        // The saved index may already cover this note without its new words
+        if (indexed) {
+            storage_wear_kind_t prev = wear_switch(STORAGE_WEAR_INDEX);
+            if (search_mark_grown((uint32_t)strtoul(meta->id, NULL, 16)) != ESP_OK) {
+                ESP_LOGW(TAG, "Words appended to note %s are not searchable after a reboot",
+                         meta->id);
+            }
+            wear_switch(prev);
+        }
+        body_cache_remove((uint32_t)strtoul(meta->id, NULL, 16));
+        wear_count(STORAGE_WEAR_NOTES, meta->size - ctx->writer->base);
+        ESP_LOGI(TAG, "Appended %" PRIu32 " bytes to note %s (now %" PRIu32 " bytes)",
+                 meta->size - ctx->writer->base, meta->id, meta->size);
+        return ESP_OK;
     }
 
-    *message_len = fread(message, 1, fsize, f);
-    fclose(f);
-
-    message[*message_len] = '\0';  // Null-terminate
-    ESP_LOGI(TAG, "Read note %s (encrypted=%d)", note_id, metadata->encrypted);
+    if (expiry_add(meta) != ESP_OK) {
+        ESP_LOGW(TAG, "Note %s will not expire until the next boot", meta->id);
+    }
+    wear_count(STORAGE_WEAR_NOTES, meta->size);
+    ESP_LOGI(TAG, "Created note %s (%" PRIu32 " bytes, encrypted=%d)",
+             meta->id, meta->size, meta->encrypted);
     return ESP_OK;
 }
 
-esp_err_t storage_delete_note(const char *note_id)
+typedef struct {
+    uint8_t ns;
+    const char *title;
+    bool encrypted;
+    uint64_t timestamp;  // 0 = now
+    uint64_t expires_at;
+    size_t size;
+    const char *data;
+    storage_writer_t *writer;
+} write_ctx_t;
+
+static esp_err_t begin_op(void *arg)
 {
-    if (!note_id) {
-        return ESP_ERR_INVALID_ARG;
-    }
+    write_ctx_t *ctx = arg;
+    return begin_note(ctx->ns, ctx->title, ctx->encrypted, ctx->timestamp, ctx->expires_at,
+                      ctx->size, ctx->writer);
+}
 
-    char meta_path[64];
-    char msg_path[64];
-    snprintf(meta_path, sizeof(meta_path), "%s/note_%s.meta", SPIFFS_BASE_PATH, note_id);
-    snprintf(msg_path, sizeof(msg_path), "%s/note_%s.txt", SPIFFS_BASE_PATH, note_id);
+static esp_err_t write_op(void *arg)
+{
+    write_ctx_t *ctx = arg;
+    return write_chunk(ctx->writer, ctx->data, ctx->size);
+}
 
-    unlink(meta_path);
-    unlink(msg_path);
+static esp_err_t append_op(void *arg)
+{
+    write_ctx_t *ctx = arg;
+    return begin_append(ctx->ns, ctx->title, ctx->size, ctx->writer);
+}
 
-    ESP_LOGI(TAG, "Deleted note %s", note_id);
+static esp_err_t abort_op(void *arg)
+{
+    abort_note(arg);
     return ESP_OK;
 }
 
-esp_err_t storage_get_stats(storage_stats_t *stats)
+esp_err_t storage_begin_note(uint8_t ns, const char *title, bool encrypted, uint64_t expires_at,
+                             size_t size, storage_writer_t *writer)
 {
-    if (!stats) {
+    if (!title || !writer || ns >= NAMESPACE_MAX) {
         return ESP_ERR_INVALID_ARG;
     }
 
-    memset(stats, 0, sizeof(storage_stats_t));
+    write_ctx_t ctx = {
+        .ns = ns, .title = title, .encrypted = encrypted, .expires_at = expires_at, .size = size,
+        .writer = writer,
+    };
+    return run_op(begin_op, NULL, &ctx, false);
+}
 
-    // Get SPIFFS info
-    esp_spiffs_info(SPIFFS_PARTITION_LABEL, &stats->total, &stats->used);
+esp_err_t storage_begin_import(const note_metadata_t *meta, storage_writer_t *writer)
+{
+    if (!meta || !writer || meta->ns >= NAMESPACE_MAX) {
+        return ESP_ERR_INVALID_ARG;
+    }
 
-    // Count notes
-    DIR *dir = opendir(SPIFFS_BASE_PATH);
-    if (dir) {
-        struct dirent *entry;
-        while ((entry = readdir(dir)) != NULL) {
-            if (strstr(entry->d_name, ".meta")) {
-                stats->count++;
+    write_ctx_t ctx = {
+        .ns = meta->ns, .title = meta->title, .encrypted = meta->encrypted, .timestamp = meta->timestamp,
+        .expires_at = meta->expires_at, .size = meta->size, .writer = writer,
+    };
+    return run_op(begin_op, NULL, &ctx, false);
+}
+
+esp_err_t storage_begin_append(uint8_t ns, const char *note_id, size_t size,
+                               storage_writer_t *writer)
+{
+    if (!note_id || !writer) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    write_ctx_t ctx = { .ns = ns, .title = note_id, .size = size, .writer = writer };
+    return run_op(append_op, NULL, &ctx, false);
+}
+
+esp_err_t storage_write_chunk(storage_writer_t *writer, const char *data, size_t len)
+{
+    if (!writer || !writer->handle || (!data && len > 0)) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    write_ctx_t ctx = { .data = data, .size = len, .writer = writer };
+    return run_op(write_op, NULL, &ctx, false);
+}
+
+esp_err_t storage_commit_note(storage_writer_t *writer, char *note_id)
+{
+    if (!writer || !writer->handle || !note_id) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    commit_ctx_t ctx = { .writer = writer, .note_id = note_id };
+    esp_err_t err = run_op(commit_write, commit_publish, &ctx, false);
+
+    // Left over if the note failed before it was published
+    search_doc_discard(writer->search);
+    writer->search = NULL;
+    return err;
+}
+
+esp_err_t storage_commit_notes(storage_writer_t *writers, size_t count, size_t *committed)
+{
+    if (!writers || !committed || count > STORAGE_GROUP_COMMIT_MAX) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    typedef struct {
+        storage_op_t op;
+        commit_ctx_t commit;
+        char note_id[16];
+    } batch_entry_t;
+    batch_entry_t *batch = calloc(count, sizeof(batch_entry_t));
+    if (!batch) {
+        for (size_t i = 0; i < count; i++) {
+            storage_abort_note(&writers[i]);
+        }
+        return ESP_ERR_NO_MEM;
+    }
+
+    // Queued back to back, so the worker's group commit covers them with one sync
+    size_t queued = 0;
+    for (; queued < count; queued++) {
+        batch_entry_t *entry = &batch[queued];
+        entry->commit = (commit_ctx_t){ .writer = &writers[queued], .note_id = entry->note_id };
+        if (queue_op(&entry->op, commit_write, commit_publish, &entry->commit, false) != ESP_OK) {
+            break;
+        }
+    }
+
+    esp_err_t err = queued == count ? ESP_OK : ESP_FAIL;
+    *committed = 0;
+    for (size_t i = 0; i < count; i++) {
+        esp_err_t result = i < queued ? wait_op(&batch[i].op) : ESP_FAIL;
+        if (i >= queued) {
+            storage_abort_note(&writers[i]);
+        }
+        search_doc_discard(writers[i].search);
+        writers[i].search = NULL;
+        if (result == ESP_OK) {
+            (*committed)++;
+        } else if (err == ESP_OK) {
+            err = result;
+        }
+    }
+    free(batch);
+    return err;
+}
+
+void storage_abort_note(storage_writer_t *writer)
+{
+    if (writer && writer->handle) {
+        run_op(abort_op, NULL, writer, false);
+    }
+}
+
+typedef struct {
+    write_ctx_t write;
+    storage_writer_t writer;
+    commit_ctx_t commit;
+} create_ctx_t;
+
+static esp_err_t create_write(void *arg)
+{
+    create_ctx_t *ctx = arg;
+    esp_err_t err = begin_note(ctx->write.ns, ctx->write.title, ctx->write.encrypted, 0,
+                               ctx->write.expires_at, ctx->write.size, &ctx->writer);
+    if (err != ESP_OK) {
+        return err;
+    }
+
+    err = write_chunk(&ctx->writer, ctx->write.data, ctx->write.size);
+    if (err != ESP_OK) {
+        abort_note(&ctx->writer);
+        return err;
+    }
+    return commit_write(&ctx->commit);
+}
+
+static esp_err_t create_publish(void *arg)
+{
+    create_ctx_t *ctx = arg;
+    return commit_publish(&ctx->commit);
+}
+
+esp_err_t storage_create_note(uint8_t ns, const char *title, const char *message,
+                               bool encrypted, uint64_t expires_at, char *note_id)
+{
+    if (!title || !message || !note_id || ns >= NAMESPACE_MAX) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    // Check message size
+    size_t message_len = strlen(message);
+    if (message_len > MAX_NOTE_SIZE_BYTES) {
+        ESP_LOGE(TAG, "Message too large");
+        return ESP_ERR_INVALID_SIZE;
+    }
+
+    create_ctx_t ctx = {
+        .write = {
+            .ns = ns, .title = title, .encrypted = encrypted, .expires_at = expires_at,
+            .size = message_len, .data = message,
+        },
+    };
+    ctx.commit = (commit_ctx_t){ .writer = &ctx.writer, .note_id = note_id };
+    esp_err_t err = run_op(create_write, create_publish, &ctx, false);
+    search_doc_discard(ctx.writer.search);
+    return err;
+}
+
+// Settle every ID handed out since the checkpoint that the journal does not
+// mention: finished notes are cataloged, leftovers of unfinished ones removed
+static esp_err_t recover_notes(uint32_t from, uint32_t to)
+{
+    size_t recovered = 0;
+    for (uint32_t id = from; id != 0 && id <= to; id++) {
+        char note_id[16];
+        snprintf(note_id, sizeof(note_id), "%08" PRIx32, id);
+        if (catalog_find(note_id) || reclaim_pending(id)) {
+            continue;
+        }
+
+        note_metadata_t meta;
+        if (g_engine->recover(note_id, &meta) != ESP_OK) {
+            continue;
+        }
+        esp_err_t err = catalog_insert(&meta);
+        if (err != ESP_OK) {
+            return err;
+        }
+        checkpoint_log_put(&meta);
+        recovered++;
+    }
+
+    if (recovered > 0) {
+        ESP_LOGI(TAG, "Recovered %zu notes written after the last checkpoint", recovered);
+    }
+    return checkpoint_sync();
+}
+
+// Restore the catalog from the index checkpoint when the engine supports it
+static bool load_checkpoint(void)
+{
+    uint32_t probe_from = 0;
+    if (checkpoint_load(g_engine->remove, &probe_from) != ESP_OK) {
+        return false;
+    }
+
+    // IDs up to the NVS counter may have been used; a counter behind the
+    // snapshot means NVS was erased and only a full scan finds everything
+    uint32_t counter = 0;
+    nvs_get_u32(g_nvs_handle, "note_counter", &counter);
+    if (counter + 1 < probe_from) {
+        ESP_LOGW(TAG, "Note counter behind index checkpoint, rescanning");
+        return false;
+    }
+    return recover_notes(probe_from, counter) == ESP_OK;
+}
+
+static esp_err_t load_note(const note_metadata_t *meta)
+{
+    if (reclaim_pending((uint32_t)strtoul(meta->id, NULL, 16))) {
+        return ESP_OK;
+    }
+    return catalog_insert_unsorted(meta);
+}
+
+// Ask the engine for every stored note once at boot and build the catalog
+static esp_err_t load_catalog(bool *checkpointed)
+{
+    esp_err_t err = catalog_init();
+    if (err != ESP_OK) {
+        return err;
+    }
+
+    *checkpointed = g_engine->recover && load_checkpoint();
+    if (*checkpointed) {
+        return ESP_OK;
+    }
+
+    // Discard whatever a partial checkpoint load left behind
+    err = catalog_init();
+    if (err != ESP_OK) {
+        return err;
+    }
+    err = g_engine->load(load_note);
+    catalog_sort();
+    return err;
+}
+
+// Cursors are "<timestamp hex>-<note id>": the position of the last note
+// returned, so a page resumes there even if notes were added or deleted.
+static esp_err_t parse_cursor(const char *cursor, catalog_pos_t *pos)
+{
+    unsigned long long timestamp;
+    int consumed = 0;
+    memset(pos, 0, sizeof(*pos));
+    if (sscanf(cursor, "%16llx-%15[0-9a-f]%n", &timestamp, pos->id, &consumed) != 2 ||
+        cursor[consumed] != '\0') {
+        return ESP_ERR_INVALID_ARG;
+    }
+    pos->timestamp = timestamp;
+    return ESP_OK;
+}
+
+// Whole-body reads on the worker (search indexing, cache fills)
+
+typedef void (*body_sink_t)(void *ctx, const char *data, size_t len);
+
+// Pass a note's body, decompressed, to sink in pieces
+static esp_err_t read_body(const note_metadata_t *meta, body_sink_t sink, void *ctx)
+{
+    void *handle = NULL;
+    note_decoder_t *codec = NULL;
+    esp_err_t err = g_engine->open(meta, &handle);
+    if (err == ESP_OK && meta->compressed) {
+        err = note_decoder_create(&codec);
+    }
+
+    // Bytes past meta->size belong to an append that never committed
+    char buf[256];
+    size_t len = 0;
+    uint32_t remaining = meta->size;
+    while (handle && err == ESP_OK && remaining > 0) {
+        size_t want = remaining < sizeof(buf) ? remaining : sizeof(buf);
+        err = codec ? note_decoder_read(codec, g_engine->read, handle, buf, want, &len)
+                    : g_engine->read(handle, buf, want, &len);
+        if (err != ESP_OK || len == 0) {
+            break;
+        }
+        sink(ctx, buf, len);
+        remaining -= len;
+    }
+    note_decoder_free(codec);
+    if (handle) {
+        g_engine->close(handle);
+    }
+    return err;
+}
+
+// Search
+
+static void index_sink(void *ctx, const char *data, size_t len)
+{
+    search_doc_feed(ctx, data, len);
+}
+
+// Index a stored note from flash (title, plus the body if it is plaintext)
+static esp_err_t index_note(const note_metadata_t *meta, bool indexed)
+{
+    search_doc_t *doc;
+    esp_err_t err = search_doc_begin((uint32_t)strtoul(meta->id, NULL, 16), indexed, &doc);
+    if (err != ESP_OK) {
+        return err;
+    }
+    search_doc_feed(doc, meta->title, strlen(meta->title));
+    search_doc_break(doc);
+
+    if (!meta->encrypted) {
+        err = read_body(meta, index_sink, doc);
+    }
+    if (err != ESP_OK) {
+        search_doc_discard(doc);
+        return err;
+    }
+
+    state_write_lock();
+    err = search_doc_commit(doc);
+    state_write_unlock();
+    return err;
+}
+
+// Bring the index up to date with notes created after it was last saved,
+// or with every note when there was no saved index, and with notes appended
+// to since
+static void index_missing_notes(void)
+{
+    int64_t start = esp_timer_get_time();
+    size_t indexed = 0;
+    for (size_t i = 0; i < catalog_count(); i++) {
+        const note_metadata_t *meta = catalog_at(i);
+        if ((uint32_t)strtoul(meta->id, NULL, 16) <= g_search_covered) {
+            continue;
+        }
+        if (index_note(meta, false) != ESP_OK) {
+            ESP_LOGW(TAG, "Failed to index note %s", meta->id);
+        }
+        indexed++;
+    }
+
+    const uint32_t *grown;
+    size_t grown_count = search_grown_notes(&grown);
+    for (size_t i = 0; i < grown_count; i++) {
+        char note_id[16];
+        snprintf(note_id, sizeof(note_id), "%08" PRIx32, grown[i]);
+        const note_metadata_t *meta = catalog_find(note_id);
+        if (!meta) {
+            continue;  // Deleted since
+        }
+        if (index_note(meta, true) != ESP_OK) {
+            ESP_LOGW(TAG, "Failed to index note %s", meta->id);
+        }
+        indexed++;
+    }
+
+    if (indexed > 0) {
+        ESP_LOGI(TAG, "Indexed %zu notes for search in %lld ms", indexed,
+                 (long long)((esp_timer_get_time() - start) / 1000));
+        storage_wear_kind_t prev = wear_switch(STORAGE_WEAR_INDEX);
+        search_save(g_next_id - 1);
+        wear_switch(prev);
+    }
+}
+
+typedef struct {
+    uint8_t ns;
+    const char *query;
+    note_metadata_t *notes;
+    size_t max_notes;
+    size_t *count;
+    bool *more;
+} search_ctx_t;
+
+static esp_err_t search_op(void *arg)
+{
+    search_ctx_t *ctx = arg;
+    int64_t start = esp_timer_get_time();
+
+    uint32_t *ids = malloc(ctx->max_notes * sizeof(uint32_t));
+    if (!ids) {
+        return ESP_ERR_NO_MEM;
+    }
+    size_t found = search_query(ctx->ns, ctx->query, ids, ctx->max_notes, ctx->more);
+
+    // Matches are checked against the catalog, so every lookup succeeds
+    *ctx->count = 0;
+    for (size_t i = 0; i < found; i++) {
+        char note_id[16];
+        snprintf(note_id, sizeof(note_id), "%08" PRIx32, ids[i]);
+        const note_metadata_t *meta = catalog_find(note_id);
+        if (meta) {
+            ctx->notes[(*ctx->count)++] = *meta;
+        }
+    }
+    free(ids);
+
+    ESP_LOGI(TAG, "Search matched %zu notes in %lld us", *ctx->count,
+             (long long)(esp_timer_get_time() - start));
+    return ESP_OK;
+}
+
+esp_err_t storage_search_notes(uint8_t ns, const char *query, note_metadata_t *notes,
+                               size_t max_notes, size_t *count, bool *more)
+{
+    if (!query || !notes || !count || !more) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    *count = 0;
+    *more = false;
+    if (max_notes == 0) {
+        return ESP_OK;
+    }
+
+    search_ctx_t ctx = {
+        .ns = ns, .query = query, .notes = notes, .max_notes = max_notes, .count = count, .more = more
+    };
+    return run_read(search_op, &ctx);
+}
+
+// Body cache
+
+typedef struct {
+    char *buf;
+    size_t len;
+    size_t capacity;
+} cache_fill_t;
+
+static void cache_sink(void *ctx, const char *data, size_t len)
+{
+    cache_fill_t *fill = ctx;
+    size_t n = len < fill->capacity - fill->len ? len : fill->capacity - fill->len;
+    memcpy(fill->buf + fill->len, data, n);
+    fill->len += n;
+}
+
+// Read a small note's whole body into PSRAM and cache it; NULL if the note
+// is too large for the cache or cannot be read (it is then streamed)
+static body_cache_entry_t *cache_body(const note_metadata_t *meta)
+{
+    if (meta->size > BODY_CACHE_MAX_NOTE) {
+        return NULL;
+    }
+
+    cache_fill_t fill = {
+        .buf = heap_caps_malloc_prefer(meta->size ? meta->size : 1, 2,
+                                       MALLOC_CAP_SPIRAM, MALLOC_CAP_DEFAULT),
+        .capacity = meta->size,
+    };
+    if (!fill.buf) {
+        return NULL;
+    }
+
+    body_cache_entry_t *entry = NULL;
+    if (read_body(meta, cache_sink, &fill) == ESP_OK && fill.len == meta->size) {
+        entry = body_cache_put((uint32_t)strtoul(meta->id, NULL, 16), fill.buf, fill.len);
+    }
+    if (!entry) {
+        heap_caps_free(fill.buf);
+    }
+    return entry;
+}
+
+static storage_op_t g_warm_op;
+static volatile bool g_warm_queued = false;
+
+// Load the newest notes that fit, oldest of them first so the newest end
+// up most recently used
+static esp_err_t warm_op(void *arg)
+{
+    g_warm_queued = false;
+    int64_t start = esp_timer_get_time();
+
+    size_t count = catalog_count();
+    size_t first = count;
+    size_t picked = 0, bytes = 0;
+    while (first > 0 && picked < BODY_CACHE_WARM_NOTES) {
+        const note_metadata_t *meta = catalog_at(first - 1);
+        if (meta->size <= BODY_CACHE_MAX_NOTE) {
+            if (bytes + meta->size > BODY_CACHE_BYTES) {
+                break;
             }
+            bytes += meta->size;
+            picked++;
         }
-        closedir(dir);
+        first--;
+    }
+
+    size_t loaded = 0;
+    for (size_t i = first; i < catalog_count(); i++) {
+        const note_metadata_t *meta = catalog_at(i);
+        if (body_cache_contains((uint32_t)strtoul(meta->id, NULL, 16))) {
+            continue;
+        }
+        body_cache_entry_t *entry = cache_body(meta);
+        if (entry) {
+            body_cache_release(entry);
+            loaded++;
+        }
+    }
+
+    if (loaded > 0) {
+        ESP_LOGI(TAG, "Cached %zu recent notes in %lld ms", loaded,
+                 (long long)((esp_timer_get_time() - start) / 1000));
+    }
+    return ESP_OK;
+}
+
+void storage_warm_cache(void)
+{
+    if (!g_queue || g_warm_queued) {
+        return;
+    }
+
+    // Queued behind pending work, nobody waits for it
+    g_warm_op = (storage_op_t){ .fn = warm_op };
+    storage_op_t *ptr = &g_warm_op;
+    g_warm_queued = true;
+    if (xQueueSendToBack(g_queue, &ptr, 0) != pdTRUE) {
+        g_warm_queued = false;
+    }
+}
+
+// Note reads and deletes
+
+typedef struct {
+    uint8_t ns;
+    storage_order_t order;
+    const catalog_pos_t *after;
+    note_metadata_t *notes;
+    size_t max_notes;
+    size_t *count;
+    bool more;
+} list_ctx_t;
+
+static esp_err_t list_op(void *arg)
+{
+    list_ctx_t *ctx = arg;
+    *ctx->count = catalog_page(ctx->ns, ctx->order == STORAGE_ORDER_NEWEST_FIRST, ctx->after,
+                               ctx->notes, ctx->max_notes, &ctx->more);
+    ESP_LOGI(TAG, "Listed %zu of %zu notes", *ctx->count, catalog_count());
+    return ESP_OK;
+}
+
+esp_err_t storage_list_notes(uint8_t ns, storage_order_t order, const char *cursor,
+                             note_metadata_t *notes, size_t max_notes,
+                             size_t *count, char *next_cursor)
+{
+    if (!notes || !count || !next_cursor) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    catalog_pos_t after;
+    bool has_cursor = cursor && cursor[0] != '\0';
+    if (has_cursor && parse_cursor(cursor, &after) != ESP_OK) {
+        ESP_LOGW(TAG, "Malformed list cursor");
+        return ESP_ERR_INVALID_ARG;
+    }
+    after.ns = ns;
+
+    list_ctx_t ctx = {
+        .ns = ns,
+        .order = order,
+        .after = has_cursor ? &after : NULL,
+        .notes = notes,
+        .max_notes = max_notes,
+        .count = count,
+    };
+    esp_err_t err = run_read(list_op, &ctx);
+    if (err != ESP_OK) {
+        return err;
+    }
+
+    next_cursor[0] = '\0';
+    if (ctx.more && *count > 0) {
+        const note_metadata_t *last = &notes[*count - 1];
+        snprintf(next_cursor, STORAGE_CURSOR_LEN, "%llx-%s",
+                 (unsigned long long)last->timestamp, last->id);
+    }
+    return ESP_OK;
+}
+
+typedef struct {
+    uint8_t ns;
+    const char *note_id;
+    note_metadata_t *metadata;
+    storage_reader_t *reader;
+    char *buf;
+    size_t buf_len;
+    size_t *read_len;
+} read_ctx_t;
+
+static esp_err_t open_op(void *arg)
+{
+    read_ctx_t *ctx = arg;
+
+    // Metadata comes from the catalog; unknown IDs never touch flash
+    const note_metadata_t *cached = catalog_find(ctx->note_id);
+    if (!cached || cached->ns != ctx->ns) {
+        return ESP_ERR_NOT_FOUND;
+    }
+    // Expired but not yet swept (e.g. the sweeper is working through a batch)
+    if (cached->expires_at != 0 && cached->expires_at <= (uint64_t)time(NULL)) {
+        return ESP_ERR_NOT_FOUND;
+    }
+    *ctx->metadata = *cached;
+
+    // Small bodies are served from PSRAM, loaded there on the first read
+    uint32_t key = (uint32_t)strtoul(ctx->note_id, NULL, 16);
+    body_cache_entry_t *entry = body_cache_get(key);
+    if (!entry) {
+        entry = cache_body(ctx->metadata);
+    }
+    *ctx->reader = (storage_reader_t){ .cached = entry, .size = ctx->metadata->size };
+    if (entry) {
+        ESP_LOGI(TAG, "Opened note %s from cache (encrypted=%d)", ctx->note_id,
+                 ctx->metadata->encrypted);
+        return ESP_OK;
+    }
+
+    // Open message content (plain or encrypted)
+    esp_err_t err = g_engine->open(ctx->metadata, &ctx->reader->handle);
+    if (err != ESP_OK) {
+        return err;
+    }
+
+    if (ctx->metadata->compressed) {
+        err = note_decoder_create((note_decoder_t **)&ctx->reader->codec);
+        if (err != ESP_OK) {
+            g_engine->close(ctx->reader->handle);
+            ctx->reader->handle = NULL;
+            return err;
+        }
+    }
+
+    ESP_LOGI(TAG, "Opened note %s (encrypted=%d)", ctx->note_id, ctx->metadata->encrypted);
+    return ESP_OK;
+}
+
+static esp_err_t read_op(void *arg)
+{
+    read_ctx_t *ctx = arg;
+    storage_reader_t *reader = ctx->reader;
+    if (reader->cached) {
+        size_t len;
+        const char *data = body_cache_data(reader->cached, &len);
+        size_t n = len - reader->offset < ctx->buf_len ? len - reader->offset : ctx->buf_len;
+        memcpy(ctx->buf, data + reader->offset, n);
+        reader->offset += n;
+        *ctx->read_len = n;
+        return ESP_OK;
+    }
+
+    // Bytes past the size at open are an append in progress (or one that
+    // never committed)
+    size_t want = reader->size - reader->offset;
+    if (want > ctx->buf_len) {
+        want = ctx->buf_len;
+    }
+    *ctx->read_len = 0;
+    if (want == 0) {
+        return ESP_OK;
+    }
+    esp_err_t err = reader->codec
+                        ? note_decoder_read(reader->codec, g_engine->read, reader->handle,
+                                            ctx->buf, want, ctx->read_len)
+                        : g_engine->read(reader->handle, ctx->buf, want, ctx->read_len);
+    reader->offset += *ctx->read_len;
+    return err;
+}
+
+static esp_err_t close_op(void *arg)
+{
+    storage_reader_t *reader = arg;
+    if (reader->cached) {
+        body_cache_release(reader->cached);
+        reader->cached = NULL;
+        return ESP_OK;
+    }
+    g_engine->close(reader->handle);
+    reader->handle = NULL;
+    note_decoder_free(reader->codec);
+    reader->codec = NULL;
+    return ESP_OK;
+}
+
+esp_err_t storage_open_note(uint8_t ns, const char *note_id, note_metadata_t *metadata,
+                            storage_reader_t *reader)
+{
+    if (!note_id || !metadata || !reader) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    read_ctx_t ctx = { .ns = ns, .note_id = note_id, .metadata = metadata, .reader = reader };
+    return run_op(open_op, NULL, &ctx, true);
+}
+
+esp_err_t storage_read_chunk(storage_reader_t *reader, char *buf, size_t buf_len,
+                             size_t *read_len)
+{
+    if (!reader || (!reader->handle && !reader->cached) || !buf || !read_len) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    read_ctx_t ctx = { .reader = reader, .buf = buf, .buf_len = buf_len, .read_len = read_len };
+    return run_op(read_op, NULL, &ctx, true);
+}
+
+void storage_close_note(storage_reader_t *reader)
+{
+    if (reader && (reader->handle || reader->cached)) {
+        run_op(close_op, NULL, reader, true);
+    }
+}
+
+static esp_err_t delete_note(const char *note_id)
+{
+    const note_metadata_t *cached = catalog_find(note_id);
+    if (!cached) {
+        return ESP_ERR_NOT_FOUND;
+    }
+    note_metadata_t meta = *cached;
+
+    // Journal the delete before touching the note, or a power cut could
+    // leave it in the snapshot with its files gone
+    if (g_engine->recover) {
+        wear_switch(STORAGE_WEAR_INDEX);
+        if (checkpoint_log_delete(&meta) == ESP_OK) {
+            checkpoint_sync();
+        }
+    }
+    wear_switch(STORAGE_WEAR_DELETES);
+
+    // Removing the files (unlinks that can set off filesystem GC) waits for
+    // idle time; the tombstone in the reclaim list is one small append
+    esp_err_t err = reclaim_add(&meta);
+    if (err != ESP_OK) {
+        err = g_engine->remove(&meta);
+    }
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to remove note %s: %s", note_id, esp_err_to_name(err));
+        return err;
     }
+    state_write_lock();
+    catalog_remove(note_id);
+    search_remove((uint32_t)strtoul(note_id, NULL, 16));
+    g_generation++;
+    state_write_unlock();
+    body_cache_remove((uint32_t)strtoul(note_id, NULL, 16));
 
+    wear_count(STORAGE_WEAR_DELETES, 0);
+    ESP_LOGI(TAG, "Deleted note %s", note_id);
+    maybe_checkpoint();
+    maybe_save_search();
     return ESP_OK;
 }
+
+typedef struct {
+    uint8_t ns;
+    const char *note_id;
+} delete_ctx_t;
+
+static esp_err_t delete_op(void *arg)
+{
+    delete_ctx_t *ctx = arg;
+    const note_metadata_t *cached = catalog_find(ctx->note_id);
+    if (!cached || cached->ns != ctx->ns) {
+        return ESP_ERR_NOT_FOUND;
+    }
+    return delete_note(ctx->note_id);
+}
+
+// Remove a batch of deleted notes from the engine. Only called once the
+// queue has been idle, so requests never wait behind the unlinks.
+// Returns false if the oldest removal failed; it stays first in the list.
+static bool reclaim_deleted(void)
+{
+    note_metadata_t meta;
+    size_t removed = 0;
+    bool ok = true;
+    wear_switch(STORAGE_WEAR_DELETES);
+    while (removed < RECLAIM_BATCH && reclaim_peek(&meta)) {
+        esp_err_t err = g_engine->remove(&meta);
+        if (err != ESP_OK && err != ESP_ERR_NOT_FOUND) {
+            // Still on flash, where a full scan would find it: the list entry
+            // keeps it out of the catalog until a later idle period succeeds
+            ESP_LOGE(TAG, "Failed to remove deleted note %s: %s", meta.id, esp_err_to_name(err));
+            ok = false;
+            break;
+        }
+        reclaim_pop();
+        removed++;
+    }
+    wear_switch(STORAGE_WEAR_BACKGROUND);
+    if (removed > 0) {
+        g_generation++;  // Space used has dropped
+        g_gc_pending = true;
+        ESP_LOGD(TAG, "Reclaimed %zu deleted notes, %zu pending", removed, reclaim_count());
+    }
+    return ok;
+}
+
+esp_err_t storage_delete_note(uint8_t ns, const char *note_id)
+{
+    if (!note_id) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    delete_ctx_t ctx = { .ns = ns, .note_id = note_id };
+    return run_op(delete_op, NULL, &ctx, false);
+}
+
+// Delete notes whose time has come and return how long the worker may wait
+// for a request before checking again. Bounded per call so a backlog of
+// expired notes (after the clock is first set) never starves requests.
+static TickType_t sweep_expired(void)
+{
+    time_t now = time(NULL);
+    if (now < EXPIRY_CLOCK_VALID_AFTER) {
+        return portMAX_DELAY;  // storage_time_changed wakes the worker
+    }
+
+    uint64_t when;
+    uint32_t id;
+    size_t swept = 0;
+    while (expiry_peek(&when, &id) && when <= (uint64_t)now) {
+        if (swept == EXPIRY_SWEEP_BATCH) {
+            return 0;
+        }
+        expiry_pop();
+
+        // Entries outlive deleted notes; only act on a note that still has this expiry
+        char note_id[16];
+        snprintf(note_id, sizeof(note_id), "%08" PRIx32, id);
+        const note_metadata_t *meta = catalog_find(note_id);
+        if (!meta || meta->expires_at != when) {
+            continue;
+        }
+        if (delete_note(note_id) == ESP_OK) {
+            ESP_LOGI(TAG, "Note %s expired", note_id);
+        }
+        swept++;
+    }
+    if (swept > 0) {
+        wear_switch(STORAGE_WEAR_BACKGROUND);
+    }
+
+    if (!expiry_peek(&when, &id)) {
+        return portMAX_DELAY;
+    }
+    // Wake at least every EXPIRY_CHECK_MAX_S in case the clock is stepped
+    uint64_t wait_s = when - (uint64_t)now;
+    if (wait_s > EXPIRY_CHECK_MAX_S) {
+        wait_s = EXPIRY_CHECK_MAX_S;
+    }
+    return pdMS_TO_TICKS(wait_s * 1000);
+}
+
+static esp_err_t wake_op(void *arg)
+{
+    return ESP_OK;
+}
+
+void storage_time_changed(void)
+{
+    if (g_queue) {
+        run_op(wake_op, NULL, NULL, true);
+    }
+}
+
+// Idle maintenance
+
+static bool gc_due(void)
+{
+    return g_maintenance && g_gc_pending && g_fs->gc;
+}
+
+// Make FS_GC_HEADROOM writable without inline GC, FS_GC_STEP more per call
+// so the pass can stop between calls: once the budget is spent, a request
+// arrives or maintenance is paused. The next idle period picks up from there.
+static void collect_garbage(void)
+{
+    int64_t start = esp_timer_get_time();
+    int64_t deadline = start + FS_GC_BUDGET_MS * 1000LL;
+    size_t from = g_gc_size;
+    esp_err_t err = ESP_OK;
+
+    wear_switch(STORAGE_WEAR_BACKGROUND);
+    while (g_maintenance && uxQueueMessagesWaiting(g_queue) == 0 &&
+           esp_timer_get_time() < deadline) {
+        g_gc_size += FS_GC_STEP;
+        err = g_fs->gc(g_gc_size);
+        if (err != ESP_OK || g_gc_size >= FS_GC_HEADROOM) {
+            // ESP_ERR_NOT_FINISHED: too full for more, writes will have to GC inline
+            g_gc_pending = false;
+            break;
+        }
+    }
+    wear_switch(STORAGE_WEAR_BACKGROUND);
+
+    if (!g_gc_pending) {
+        ESP_LOGI(TAG, "%s GC done, %zu KB ready (%s)", g_fs->name, g_gc_size / 1024,
+                 esp_err_to_name(err));
+        g_gc_size = 0;
+    } else if (g_gc_size > from) {
+        ESP_LOGD(TAG, "%s GC at %zu KB after %lld ms", g_fs->name, g_gc_size / 1024,
+                 (long long)((esp_timer_get_time() - start) / 1000));
+    }
+}
+
+// How long the queue must stay empty before idle_work has something to do
+static TickType_t idle_wait(void)
+{
+    if (reclaim_count() > 0) {
+        return pdMS_TO_TICKS(RECLAIM_IDLE_MS);
+    }
+    return gc_due() ? pdMS_TO_TICKS(FS_GC_IDLE_MS) : portMAX_DELAY;
+}
+
+// Deleted notes go first: removing them is what leaves blocks for GC. A
+// removal that keeps failing does not hold GC up.
+static void idle_work(void)
+{
+    if (reclaim_count() > 0 && reclaim_deleted()) {
+        return;
+    }
+    if (gc_due()) {
+        collect_garbage();
+    }
+}
+
+static storage_op_t g_maintenance_op;
+static volatile bool g_maintenance_queued = false;
+
+static esp_err_t maintenance_op(void *arg)
+{
+    g_maintenance_queued = false;
+    return ESP_OK;
+}
+
+void storage_set_maintenance(bool allowed)
+{
+    g_maintenance = allowed;
+    if (!allowed || !g_queue || g_maintenance_queued) {
+        return;
+    }
+
+    // Wakes the worker so it recomputes its wait; nobody waits for it
+    g_maintenance_op = (storage_op_t){ .fn = maintenance_op };
+    storage_op_t *ptr = &g_maintenance_op;
+    g_maintenance_queued = true;
+    if (xQueueSendToBack(g_queue, &ptr, 0) != pdTRUE) {
+        g_maintenance_queued = false;
+    }
+}
+
+static esp_err_t stats_op(void *arg)
+{
+    storage_stats_t *stats = arg;
+
+    // Get filesystem (or raw note partition) info
+    space_info(&stats->total, &stats->used);
+
+    // Note counts and sizes are live counters kept by the catalog
+    catalog_totals_t totals;
+    catalog_get_totals(&totals);
+    stats->count = totals.count;
+    stats->encrypted_count = totals.encrypted_count;
+    stats->plain_count = totals.count - totals.encrypted_count;
+    stats->message_bytes = totals.bytes;
+    stats->encrypted_bytes = totals.encrypted_bytes;
+    stats->plain_bytes = totals.bytes - totals.encrypted_bytes;
+
+    // Charge activity since the last switch to the current kind in the copy;
+    // the worker's own counters are left alone
+    uint32_t hist[STORAGE_LATENCY_BUCKETS];
+    taskENTER_CRITICAL(&g_counters_lock);
+    uint32_t written, erased;
+    wear_sample(&written, &erased);
+    memcpy(stats->wear, g_wear, sizeof(stats->wear));
+    stats->wear[g_wear_kind].written_bytes += written - g_wear_written;
+    stats->wear[g_wear_kind].erased_bytes += erased - g_wear_erased;
+    memcpy(hist, g_commit_hist, sizeof(hist));
+    stats->commit_max_ms = g_commit_max_ms;
+    taskEXIT_CRITICAL(&g_counters_lock);
+#if CONFIG_SPI_FLASH_ENABLE_COUNTERS
+    stats->flash_counters = true;
+#endif
+
+    body_cache_stats_t cache;
+    body_cache_get_stats(&cache);
+    stats->cache_hits = cache.hits;
+    stats->cache_misses = cache.misses;
+    stats->cache_entries = cache.entries;
+    stats->cache_bytes = cache.bytes;
+
+    // Upper bound of the bucket holding the 99th percentile
+    uint32_t commits = 0;
+    for (size_t i = 0; i < STORAGE_LATENCY_BUCKETS; i++) {
+        commits += hist[i];
+    }
+    uint32_t seen = 0;
+    for (size_t i = 0; i < STORAGE_LATENCY_BUCKETS && commits > 0; i++) {
+        seen += hist[i];
+        if ((uint64_t)seen * 100 >= (uint64_t)commits * 99) {
+            stats->commit_p99_ms = 1u << i;
+            break;
+        }
+    }
+    return ESP_OK;
+}
+
+uint32_t storage_generation(void)
+{
+    return g_generation;
+}
+
+esp_err_t storage_get_stats(storage_stats_t *stats)
+{
+    if (!stats) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    memset(stats, 0, sizeof(storage_stats_t));
+    return run_read(stats_op, stats);
+}
+
+typedef struct {
+    uint8_t ns;
+    storage_ns_stats_t *stats;
+} ns_stats_ctx_t;
+
+static esp_err_t ns_stats_op(void *arg)
+{
+    ns_stats_ctx_t *ctx = arg;
+    catalog_totals_t totals;
+    catalog_get_ns_totals(ctx->ns, &totals);
+    ctx->stats->count = totals.count;
+    ctx->stats->encrypted_count = totals.encrypted_count;
+    ctx->stats->message_bytes = totals.bytes;
+    ctx->stats->encrypted_bytes = totals.encrypted_bytes;
+    return ESP_OK;
+}
+
+esp_err_t storage_get_ns_stats(uint8_t ns, storage_ns_stats_t *stats)
+{
+    if (!stats || ns >= NAMESPACE_MAX) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    ns_stats_ctx_t ctx = { .ns = ns, .stats = stats };
+    return run_read(ns_stats_op, &ctx);
+}
+
+// Namespaces
+
+typedef struct {
+    const char *name;
+    bool create;
+    uint8_t *ns;
+} namespace_ctx_t;
+
+static esp_err_t namespace_op(void *arg)
+{
+    namespace_ctx_t *ctx = arg;
+    return namespace_find(ctx->name, ctx->create, ctx->ns);
+}
+
+// Creating one writes the name table; that happens once per namespace, so
+// readers may wait behind it
+static esp_err_t create_namespace_op(void *arg)
+{
+    wear_switch(STORAGE_WEAR_INDEX);
+    state_write_lock();
+    esp_err_t err = namespace_op(arg);
+    state_write_unlock();
+    return err;
+}
+
+esp_err_t storage_find_namespace(const char *name, bool create, uint8_t *ns)
+{
+    if (!name || !ns) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    // Known names resolve on the caller's task; new ones are saved by the worker
+    namespace_ctx_t ctx = { .name = name, .create = false, .ns = ns };
+    esp_err_t err = run_read(namespace_op, &ctx);
+    if (err != ESP_ERR_NOT_FOUND || !create) {
+        return err;
+    }
+    ctx.create = true;
+    return run_op(create_namespace_op, NULL, &ctx, false);
+}
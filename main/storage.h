@@ -12,69 +12,326 @@ typedef struct {
     char id[16];
     char title[MAX_TITLE_LENGTH];
     uint64_t timestamp;
-    bool encrypted;  // Flag to indicate if message is encrypted
+    uint64_t expires_at;  // Unix time the note is deleted at, 0 = never
+    uint32_t size;    // Message length in bytes (before compression)
+    bool encrypted;   // Flag to indicate if message is encrypted
+    bool compressed;  // Body is stored as note_codec frames
+    uint8_t ns;       // Namespace (mailbox), STORAGE_NS_DEFAULT outside any
 } note_metadata_t;
 
+#define STORAGE_NS_DEFAULT 0
+
+// Where flash writes are charged. Flash counters are chip-wide, so bytes
+// are attributed to whatever the storage task was doing at the time.
+typedef enum {
+    STORAGE_WEAR_NOTES,       // Note creates: body, metadata, engine sync
+    STORAGE_WEAR_DELETES,     // Note deletes
+    STORAGE_WEAR_NOTE_IDS,    // "note_counter" commits (NVS partition)
+    STORAGE_WEAR_INDEX,       // Catalog checkpoint snapshot and journal
+    STORAGE_WEAR_BACKGROUND,  // Anything else: compaction, filesystem GC, other NVS users
+    STORAGE_WEAR_COUNT,
+} storage_wear_kind_t;
+
+typedef struct {
+    uint32_t ops;
+    uint64_t logical_bytes;  // Bytes callers asked to store
+    uint64_t written_bytes;  // Bytes programmed to flash
+    uint64_t erased_bytes;   // Bytes erased
+} storage_wear_t;
+
 // Storage statistics
 typedef struct {
     uint32_t count;
     size_t total;
     size_t used;
+    uint32_t encrypted_count;
+    uint32_t plain_count;
+    uint64_t message_bytes;    // Sum of all stored message lengths
+    uint64_t encrypted_bytes;
+    uint64_t plain_bytes;
+    bool flash_counters;  // written/erased are only tracked with CONFIG_SPI_FLASH_ENABLE_COUNTERS
+    storage_wear_t wear[STORAGE_WEAR_COUNT];  // Since boot
+    uint32_t cache_hits;     // Note opens served from the PSRAM body cache
+    uint32_t cache_misses;
+    uint32_t cache_entries;
+    size_t cache_bytes;
+    uint32_t commit_p99_ms;  // Storage task time per note commit, including the sync
+    uint32_t commit_max_ms;
 } storage_stats_t;
 
+// Listing order, by creation timestamp
+typedef enum {
+    STORAGE_ORDER_NEWEST_FIRST,
+    STORAGE_ORDER_OLDEST_FIRST,
+} storage_order_t;
+
+// Buffer size for an opaque listing cursor (including terminator)
+#define STORAGE_CURSOR_LEN 32
+
 /**
- * Initialize storage system (mount SPIFFS, init NVS)
+ * Initialize storage system (mount the storage filesystem, init NVS)
  */
 esp_err_t storage_init(void);
 
+/**
+ * Look up a namespace (mailbox) by name. Every call below that takes ns
+ * only sees the notes of that namespace; note IDs stay unique device-wide.
+ *
+ * @param name Namespace name (NAMESPACE_DEFAULT_NAME is STORAGE_NS_DEFAULT)
+ * @param create Create the namespace if it does not exist yet
+ * @param ns Output: namespace number
+ * @return ESP_OK on success, ESP_ERR_INVALID_ARG for a malformed name,
+ *         ESP_ERR_NOT_FOUND if unknown and create is false, ESP_ERR_NO_MEM
+ *         if NAMESPACE_MAX namespaces exist
+ */
+esp_err_t storage_find_namespace(const char *name, bool create, uint8_t *ns);
+
 /**
  * Create a new note (message is already encrypted client-side if password was used)
  * 
+ * @param ns Namespace
  * @param title Public title
  * @param message Message content (plain or encrypted)
  * @param encrypted Flag indicating if message is encrypted
+ * @param expires_at Unix time to delete the note at, 0 = never
  * @param note_id Output buffer for generated note ID (min 16 bytes)
- * @return ESP_OK on success
+ * @return ESP_OK on success, ESP_ERR_INVALID_STATE if expires_at is set but
+ *         the clock has not been set, ESP_ERR_INVALID_ARG if it already passed
  */
-esp_err_t storage_create_note(const char *title, const char *message, 
-                               bool encrypted, char *note_id);
+esp_err_t storage_create_note(uint8_t ns, const char *title, const char *message, 
+                               bool encrypted, uint64_t expires_at, char *note_id);
+
+// Note being written in chunks
+typedef struct {
+    void *handle;          // Engine-specific
+    void *codec;           // Compressor for plaintext bodies, NULL if stored as-is
+    void *search;          // Words collected for the search index
+    note_metadata_t meta;
+    uint32_t written;
+    bool append;           // Adds to an existing note (storage_begin_append)
+    uint32_t base;         // Body bytes the note had before an append
+} storage_writer_t;
 
 /**
- * Get list of all notes (metadata only)
+ * Start a note whose body arrives in chunks (for uploads too large to buffer)
  * 
- * @param notes Output array of note metadata
+ * @param ns Namespace
+ * @param title Public title
+ * @param encrypted Flag indicating if message is encrypted
+ * @param expires_at Unix time to delete the note at, 0 = never
+ * @param size Exact body length in bytes (at most MAX_UPLOAD_SIZE_BYTES)
+ * @param writer Output: writer to pass to storage_write_chunk and then to
+ *               storage_commit_note or storage_abort_note
+ * @return ESP_OK on success, ESP_ERR_INVALID_SIZE if too large,
+ *         ESP_ERR_NO_MEM if the note limit or the partition is full,
+ *         ESP_ERR_INVALID_STATE / ESP_ERR_INVALID_ARG as for storage_create_note
+ */
+esp_err_t storage_begin_note(uint8_t ns, const char *title, bool encrypted,
+                             uint64_t expires_at, size_t size, storage_writer_t *writer);
+
+/**
+ * Start a note restored from an archive: like storage_begin_note, but the
+ * note keeps meta's timestamp (its ID is newly assigned)
+ * 
+ * @param meta Namespace, title, flags, timestamp, expiry time and body size of the note
+ * @param writer Output: writer as for storage_begin_note
+ * @return As for storage_begin_note
+ */
+esp_err_t storage_begin_import(const note_metadata_t *meta, storage_writer_t *writer);
+
+/**
+ * Start adding size bytes to the end of an existing note. Only the new
+ * bytes are written; on commit the note's size and timestamp are updated.
+ * Write and commit/abort as for storage_begin_note. Bodies of encrypted
+ * notes are appended as given, so clients add separately encrypted segments.
+ *
+ * @param ns Namespace the note must be in
+ * @param note_id Note ID
+ * @param size Number of bytes to append
+ * @param writer Output: writer as for storage_begin_note
+ * @return ESP_OK on success, ESP_ERR_NOT_FOUND for unknown or expired notes,
+ *         ESP_ERR_INVALID_STATE if the note is already being appended to,
+ *         ESP_ERR_INVALID_SIZE if the note would exceed MAX_UPLOAD_SIZE_BYTES,
+ *         ESP_ERR_NO_MEM if the partition is full, ESP_ERR_NOT_SUPPORTED if
+ *         the storage engine cannot grow notes
+ */
+esp_err_t storage_begin_append(uint8_t ns, const char *note_id, size_t size,
+                               storage_writer_t *writer);
+
+/**
+ * Append the next chunk of body
+ * 
+ * @param writer Writer from storage_begin_note
+ * @param data Chunk contents
+ * @param len Chunk length
+ * @return ESP_OK on success, ESP_ERR_INVALID_SIZE past the declared size
+ */
+esp_err_t storage_write_chunk(storage_writer_t *writer, const char *data, size_t len);
+
+/**
+ * Finish a note once the whole body has been written
+ * 
+ * @param writer Writer from storage_begin_note (released even on failure)
+ * @param note_id Output buffer for the note ID (min 16 bytes)
+ * @return ESP_OK on success, ESP_ERR_INVALID_SIZE if the body is short
+ */
+esp_err_t storage_commit_note(storage_writer_t *writer, char *note_id);
+
+/**
+ * Finish several notes at once; they are made durable by a single engine
+ * sync instead of one each
+ * 
+ * @param writers Writers from storage_begin_note (all released, even on failure)
+ * @param count Number of writers, at most STORAGE_GROUP_COMMIT_MAX
+ * @param committed Output: number of notes stored
+ * @return ESP_OK if every note was stored, else the first error
+ */
+esp_err_t storage_commit_notes(storage_writer_t *writers, size_t count, size_t *committed);
+
+/**
+ * Discard a note that was not committed
+ * 
+ * @param writer Writer from storage_begin_note
+ */
+void storage_abort_note(storage_writer_t *writer);
+
+/**
+ * Find notes whose title or plaintext body contains every word of query
+ * (whole words, case-insensitive; encrypted bodies are never indexed).
+ * Runs on the calling task, in parallel with other lists and searches.
+ *
+ * @param ns Namespace
+ * @param query Words to match
+ * @param notes Output array of note metadata, newest first
  * @param max_notes Maximum number of notes to return
  * @param count Output: actual number of notes returned
+ * @param more Output: true if more notes matched than were returned
  * @return ESP_OK on success
  */
-esp_err_t storage_list_notes(note_metadata_t *notes, size_t max_notes, size_t *count);
+esp_err_t storage_search_notes(uint8_t ns, const char *query, note_metadata_t *notes,
+                               size_t max_notes, size_t *count, bool *more);
+
+/**
+ * Get one page of a namespace's notes (metadata only) in timestamp order.
+ * Runs on the calling task, in parallel with other lists and searches.
+ *
+ * @param ns Namespace
+ * @param order Sort order
+ * @param cursor Cursor from a previous call, or NULL/"" for the first page
+ * @param notes Output array of note metadata
+ * @param max_notes Maximum number of notes to return (page size)
+ * @param count Output: actual number of notes returned
+ * @param next_cursor Output buffer (STORAGE_CURSOR_LEN bytes): cursor for the
+ *                    next page, or "" when this is the last page
+ * @return ESP_OK on success, ESP_ERR_INVALID_ARG for a malformed cursor
+ */
+esp_err_t storage_list_notes(uint8_t ns, storage_order_t order, const char *cursor,
+                             note_metadata_t *notes, size_t max_notes,
+                             size_t *count, char *next_cursor);
+
+// Open note body being read in chunks
+typedef struct {
+    void *handle;   // Engine-specific, NULL when served from the body cache
+    void *codec;    // Decompressor, NULL if the body is stored as-is
+    void *cached;   // Body cache entry, NULL when reading from flash
+    uint32_t offset;
+    uint32_t size;  // Body length when opened; reads stop there
+} storage_reader_t;
 
 /**
- * Read a note (returns encrypted message if encrypted, plain if not)
+ * Open a note for streaming (body is encrypted if the note is, plain if not)
  * 
+ * @param ns Namespace the note must be in
  * @param note_id Note ID
- * @param message Output buffer for message content
- * @param message_len Size of output buffer / actual message length
  * @param metadata Output: note metadata
- * @return ESP_OK on success
+ * @param reader Output: reader to pass to storage_read_chunk/storage_close_note
+ * @return ESP_OK on success, ESP_ERR_NOT_FOUND for unknown IDs
+ */
+esp_err_t storage_open_note(uint8_t ns, const char *note_id, note_metadata_t *metadata,
+                            storage_reader_t *reader);
+
+/**
+ * Read the next chunk of an open note
+ * 
+ * @param reader Reader from storage_open_note
+ * @param buf Output buffer (not null-terminated)
+ * @param buf_len Size of buf
+ * @param read_len Output: bytes read, 0 once the whole body has been returned
+ * @return ESP_OK on success, ESP_FAIL on I/O or checksum errors
  */
-esp_err_t storage_read_note(const char *note_id, char *message, size_t *message_len,
-                             note_metadata_t *metadata);
+esp_err_t storage_read_chunk(storage_reader_t *reader, char *buf, size_t buf_len,
+                             size_t *read_len);
+
+/**
+ * Close a reader opened by storage_open_note
+ * 
+ * @param reader Reader to close
+ */
+void storage_close_note(storage_reader_t *reader);
 
 /**
  * Delete a note
  * 
+ * @param ns Namespace the note must be in
  * @param note_id Note ID
- * @return ESP_OK on success
+ * @return ESP_OK on success, ESP_ERR_NOT_FOUND for unknown IDs
  */
-esp_err_t storage_delete_note(const char *note_id);
+esp_err_t storage_delete_note(uint8_t ns, const char *note_id);
 
 /**
- * Get storage statistics
+ * Start loading the newest notes into the body cache in the background
+ * (returns immediately)
+ */
+void storage_warm_cache(void);
+
+/**
+ * Tell storage the wall clock was set, so notes whose expiry time has now
+ * passed are deleted straight away
+ */
+void storage_time_changed(void);
+
+/**
+ * Allow or pause idle-time maintenance (filesystem GC). Pausing takes
+ * effect within one GC step; allowing starts it once the worker is idle.
+ *
+ * @param allowed true while no client is expected (BLE-only mode)
+ */
+void storage_set_maintenance(bool allowed);
+
+/**
+ * Get storage statistics (constant time, on the calling task; counters are
+ * kept by create/delete, flash wear is accumulated since boot)
  * 
  * @param stats Output: storage statistics
  * @return ESP_OK on success
  */
 esp_err_t storage_get_stats(storage_stats_t *stats);
 
+/**
+ * Generation of the stored notes, for HTTP validators. Changes whenever a
+ * note is created, appended to or deleted and when deleted notes' space is
+ * reclaimed, and starts at a random value on every boot. Only reads a
+ * counter; the storage task is not involved.
+ *
+ * @return Current generation
+ */
+uint32_t storage_generation(void);
+
+// Note counters of one namespace
+typedef struct {
+    uint32_t count;
+    uint32_t encrypted_count;
+    uint64_t message_bytes;
+    uint64_t encrypted_bytes;
+} storage_ns_stats_t;
+
+/**
+ * Get one namespace's note counters (constant time, on the calling task)
+ *
+ * @param ns Namespace
+ * @param stats Output: counters
+ * @return ESP_OK on success
+ */
+esp_err_t storage_get_ns_stats(uint8_t ns, storage_ns_stats_t *stats);
+
 #endif // STORAGE_H
@@ -0,0 +1,109 @@
+#ifndef STORAGE_ENGINE_H
+#define STORAGE_ENGINE_H
+
+#include "esp_err.h"
+#include "storage.h"
+#include <stddef.h>
+
+/**
+ * Called once per stored note while an engine loads its on-flash state
+ */
+typedef esp_err_t (*storage_engine_load_cb_t)(const note_metadata_t *meta);
+
+/**
+ * On-flash note layout used underneath the storage_* API.
+ * The catalog owns metadata lookups; engines only persist and fetch notes.
+ */
+typedef struct {
+    const char *name;
+
+    /**
+     * Open the engine's on-flash state and report every stored note
+     */
+    esp_err_t (*load)(storage_engine_load_cb_t cb);
+
+    /**
+     * Start persisting a new note of meta->size body bytes; *handle is passed
+     * to append and then to exactly one of commit/abort. When meta->compressed
+     * is set the body is note_codec frames of at most NOTE_CODEC_BOUND(meta->size)
+     * bytes, and meta->size stays the uncompressed length.
+     */
+    esp_err_t (*create)(const note_metadata_t *meta, void **handle);
+
+    /**
+     * Optional. Reopen a stored note to add body bytes at its end; *handle
+     * is then used like one from create. meta is the updated metadata
+     * (meta->size includes the new bytes), old_size the body length before.
+     * The new bytes are appended as stored (note_codec frames when
+     * meta->compressed). Readers stop at the size they were opened with, so
+     * a note being extended stays readable. NULL if notes cannot grow.
+     */
+    esp_err_t (*extend)(const note_metadata_t *meta, uint32_t old_size, void **handle);
+
+    /**
+     * Append the next chunk of body
+     */
+    esp_err_t (*append)(void *handle, const char *data, size_t len);
+
+    /**
+     * Write out the note and release the handle (also on failure). The note
+     * need not be durable or readable until the next sync.
+     */
+    esp_err_t (*commit)(void *handle);
+
+    /**
+     * Make every note committed since the last sync durable and readable.
+     * On failure none of them may be reported again.
+     */
+    esp_err_t (*sync)(void);
+
+    /**
+     * Discard a partially written note and release the handle
+     */
+    void (*abort)(void *handle);
+
+    /**
+     * Open a note body for sequential reading; *handle is passed to read/close
+     */
+    esp_err_t (*open)(const note_metadata_t *meta, void **handle);
+
+    /**
+     * Read the next chunk of an open body; *read_len is 0 at the end
+     */
+    esp_err_t (*read)(void *handle, char *buf, size_t buf_len, size_t *read_len);
+
+    /**
+     * Release a handle returned by open
+     */
+    void (*close)(void *handle);
+
+    /**
+     * Remove a note
+     */
+    esp_err_t (*remove)(const note_metadata_t *meta);
+
+    /**
+     * Optional. Look up a single note without a full load so the catalog can
+     * be restored from a checkpoint; leftovers of an unfinished note are
+     * removed and reported as ESP_ERR_NOT_FOUND. NULL if the engine always
+     * rebuilds its state in load.
+     */
+    esp_err_t (*recover)(const char *note_id, note_metadata_t *meta);
+
+    /**
+     * Optional. Capacity and bytes in use of the space the engine manages
+     * itself; NULL if notes live on the storage filesystem.
+     */
+    esp_err_t (*info)(size_t *total, size_t *used);
+} storage_engine_t;
+
+// One .meta + .txt file pair per note
+extern const storage_engine_t storage_engine_files;
+
+// Length-prefixed records appended to segment files, compacted in the background
+extern const storage_engine_t storage_engine_log;
+
+// Size-classed slots on a raw partition, freed sectors erased in the background
+extern const storage_engine_t storage_engine_slots;
+
+#endif // STORAGE_ENGINE_H
@@ -0,0 +1,547 @@
+#include "storage_engine.h"
+#include "note_meta.h"
+#include "note_codec.h"
+#include "esp_log.h"
+#include "cJSON.h"
+#include <string.h>
+#include <stdlib.h>
+#include <dirent.h>
+#include <unistd.h>
+#include <errno.h>
+#include <sys/stat.h>
+
+static const char *TAG = "storage_files";
+
+static void meta_path_for(const char *note_id, char *path, size_t len)
+{
+    snprintf(path, len, "%s/note_%s.meta", STORAGE_BASE_PATH, note_id);
+}
+
+static void msg_path_for(const char *note_id, char *path, size_t len)
+{
+    snprintf(path, len, "%s/note_%s.txt", STORAGE_BASE_PATH, note_id);
+}
+
+static void tmp_path_for(const char *note_id, char *path, size_t len)
+{
+    snprintf(path, len, "%s/note_%s.mtmp", STORAGE_BASE_PATH, note_id);
+}
+
+static void part_path_for(const char *note_id, char *path, size_t len)
+{
+    snprintf(path, len, "%s/note_%s.part", STORAGE_BASE_PATH, note_id);
+}
+
+static bool has_suffix(const char *name, const char *suffix)
+{
+    size_t name_len = strlen(name), suffix_len = strlen(suffix);
+    return name_len > suffix_len && strcmp(name + name_len - suffix_len, suffix) == 0;
+}
+
+static esp_err_t write_metadata(const char *path, const note_metadata_t *meta)
+{
+    note_meta_record_t rec;
+    note_meta_encode(meta, &rec);
+
+    FILE *f = fopen(path, "wb");
+    if (!f) {
+        ESP_LOGE(TAG, "Failed to create metadata file: %s (errno=%d)", path, errno);
+        return ESP_FAIL;
+    }
+    size_t written = fwrite(&rec, 1, sizeof(rec), f);
+    fclose(f);
+
+    return written == sizeof(rec) ? ESP_OK : ESP_FAIL;
+}
+
+// Pre-binary notes stored their metadata as a JSON object
+static esp_err_t load_legacy_metadata(FILE *f, const char *note_id, note_metadata_t *meta)
+{
+    fseek(f, 0, SEEK_END);
+    long fsize = ftell(f);
+    fseek(f, 0, SEEK_SET);
+
+    char *json_str = malloc(fsize + 1);
+    if (!json_str) {
+        return ESP_ERR_NO_MEM;
+    }
+
+    fread(json_str, 1, fsize, f);
+    json_str[fsize] = 0;
+
+    cJSON *json = cJSON_Parse(json_str);
+    free(json_str);
+
+    if (!json) {
+        ESP_LOGE(TAG, "Failed to parse metadata JSON for note %s", note_id);
+        return ESP_FAIL;
+    }
+
+    memset(meta, 0, sizeof(note_metadata_t));
+
+    cJSON *item = cJSON_GetObjectItem(json, "id");
+    if (item) strncpy(meta->id, item->valuestring, sizeof(meta->id) - 1);
+
+    item = cJSON_GetObjectItem(json, "title");
+    if (item) strncpy(meta->title, item->valuestring, sizeof(meta->title) - 1);
+
+    item = cJSON_GetObjectItem(json, "timestamp");
+    if (item) meta->timestamp = (uint64_t)item->valuedouble;
+
+    item = cJSON_GetObjectItem(json, "encrypted");
+    if (item) meta->encrypted = cJSON_IsTrue(item);
+
+    cJSON_Delete(json);
+    return ESP_OK;
+}
+
+// *outdated is set for JSON and older binary records, which need rewriting
+static esp_err_t read_metadata(const char *path, const char *note_id,
+                               note_metadata_t *meta, bool *outdated)
+{
+    FILE *f = fopen(path, "rb");
+    if (!f) {
+        ESP_LOGW(TAG, "Metadata file not found: %s", path);
+        return ESP_ERR_NOT_FOUND;
+    }
+
+    note_meta_record_t rec;
+    size_t len = fread(&rec, 1, sizeof(rec), f);
+
+    esp_err_t err;
+    if (len > 0 && ((const char *)&rec)[0] == '{') {
+        *outdated = true;
+        err = load_legacy_metadata(f, note_id, meta);
+    } else {
+        err = note_meta_decode(&rec, len, meta, outdated);
+    }
+    fclose(f);
+
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Invalid metadata for note %s: %s", note_id, esp_err_to_name(err));
+        return err;
+    }
+
+    // Older formats did not record the message length
+    if (*outdated && meta->size == 0) {
+        char msg_path[64];
+        struct stat st;
+        msg_path_for(note_id, msg_path, sizeof(msg_path));
+        meta->size = stat(msg_path, &st) == 0 ? (uint32_t)st.st_size : 0;
+    }
+    return ESP_OK;
+}
+
+// Replace a note's metadata file (older formats, or a note that grew). The
+// record is written to a temporary file first so a power cut never leaves a
+// note without readable metadata; files_load() finishes interrupted renames.
+static esp_err_t replace_metadata(const note_metadata_t *meta)
+{
+    char meta_path[64];
+    char tmp_path[64];
+    meta_path_for(meta->id, meta_path, sizeof(meta_path));
+    tmp_path_for(meta->id, tmp_path, sizeof(tmp_path));
+
+    esp_err_t err = write_metadata(tmp_path, meta);
+    if (err != ESP_OK) {
+        unlink(tmp_path);
+        return err;
+    }
+
+    unlink(meta_path);
+    if (rename(tmp_path, meta_path) != 0) {
+        ESP_LOGE(TAG, "Failed to rename %s (errno=%d)", tmp_path, errno);
+        return ESP_FAIL;
+    }
+    return ESP_OK;
+}
+
+// Grow-only array used for work deferred until the directory scan finishes
+typedef struct {
+    note_metadata_t *items;
+    size_t count;
+    size_t capacity;
+} meta_list_t;
+
+static esp_err_t meta_list_push(meta_list_t *list, const note_metadata_t *meta)
+{
+    if (list->count == list->capacity) {
+        size_t capacity = list->capacity ? list->capacity * 2 : 16;
+        note_metadata_t *items = realloc(list->items, capacity * sizeof(note_metadata_t));
+        if (!items) {
+            return ESP_ERR_NO_MEM;
+        }
+        list->items = items;
+        list->capacity = capacity;
+    }
+    list->items[list->count++] = *meta;
+    return ESP_OK;
+}
+
+// Complete a migration interrupted between unlinking the old file and renaming
+static esp_err_t recover_migration(const char *note_id, storage_engine_load_cb_t cb)
+{
+    char meta_path[64];
+    char tmp_path[64];
+    meta_path_for(note_id, meta_path, sizeof(meta_path));
+    tmp_path_for(note_id, tmp_path, sizeof(tmp_path));
+
+    struct stat st;
+    if (stat(meta_path, &st) == 0) {
+        // The original is still there and was loaded by the scan
+        unlink(tmp_path);
+        return ESP_OK;
+    }
+
+    if (rename(tmp_path, meta_path) != 0) {
+        ESP_LOGE(TAG, "Failed to recover %s (errno=%d)", tmp_path, errno);
+        return ESP_OK;
+    }
+
+    note_metadata_t meta;
+    bool outdated;
+    if (read_metadata(meta_path, note_id, &meta, &outdated) != ESP_OK) {
+        return ESP_OK;
+    }
+    ESP_LOGI(TAG, "Recovered metadata for note %s", note_id);
+    return cb(&meta);
+}
+
+// Scan the flat storage directory and report every .meta file
+static esp_err_t files_load(storage_engine_load_cb_t cb)
+{
+    DIR *dir = opendir(STORAGE_BASE_PATH);
+    if (!dir) {
+        ESP_LOGE(TAG, "Failed to open storage directory: %s (errno=%d)", STORAGE_BASE_PATH, errno);
+        return ESP_FAIL;
+    }
+
+    meta_list_t outdated_notes = { 0 };
+    meta_list_t interrupted = { 0 };
+    meta_list_t partial = { 0 };
+    esp_err_t err = ESP_OK;
+    struct dirent *entry;
+    while ((entry = readdir(dir)) != NULL && err == ESP_OK) {
+        // Extract note ID
+        char note_id[16];
+        if (sscanf(entry->d_name, "note_%15[^.]", note_id) != 1) {
+            continue;
+        }
+
+        if (has_suffix(entry->d_name, ".mtmp")) {
+            note_metadata_t pending = { 0 };
+            strncpy(pending.id, note_id, sizeof(pending.id) - 1);
+            err = meta_list_push(&interrupted, &pending);
+            continue;
+        }
+        if (has_suffix(entry->d_name, ".part")) {
+            note_metadata_t pending = { 0 };
+            strncpy(pending.id, note_id, sizeof(pending.id) - 1);
+            err = meta_list_push(&partial, &pending);
+            continue;
+        }
+        if (!has_suffix(entry->d_name, ".meta")) {
+            continue;
+        }
+
+        char meta_path[64];
+        meta_path_for(note_id, meta_path, sizeof(meta_path));
+
+        note_metadata_t meta;
+        bool outdated;
+        if (read_metadata(meta_path, note_id, &meta, &outdated) != ESP_OK) {
+            ESP_LOGW(TAG, "Failed to load metadata for %s", note_id);
+            continue;
+        }
+
+        err = cb(&meta);
+        if (err == ESP_OK && outdated) {
+            err = meta_list_push(&outdated_notes, &meta);
+        }
+    }
+    closedir(dir);
+
+    // Never modify the directory while iterating it
+    for (size_t i = 0; i < interrupted.count && err == ESP_OK; i++) {
+        err = recover_migration(interrupted.items[i].id, cb);
+    }
+
+    // Uploads cut off by a reboot never got a .meta file
+    for (size_t i = 0; i < partial.count; i++) {
+        char part_path[64];
+        part_path_for(partial.items[i].id, part_path, sizeof(part_path));
+        ESP_LOGW(TAG, "Removing incomplete upload %s", part_path);
+        unlink(part_path);
+    }
+
+    if (outdated_notes.count > 0) {
+        ESP_LOGI(TAG, "Migrating %zu metadata files to binary v%d records",
+                 outdated_notes.count, NOTE_META_VERSION);
+    }
+    for (size_t i = 0; i < outdated_notes.count && err == ESP_OK; i++) {
+        if (replace_metadata(&outdated_notes.items[i]) != ESP_OK) {
+            ESP_LOGW(TAG, "Failed to migrate metadata for %s", outdated_notes.items[i].id);
+        }
+    }
+
+    free(outdated_notes.items);
+    free(interrupted.items);
+    free(partial.items);
+    return err;
+}
+
+// Note being uploaded; the body goes to a .part file that becomes the .txt
+// on commit. The .meta file is written last, so only complete notes load.
+// An extended note is appended to its .txt in place and its .meta replaced
+// on commit.
+typedef struct {
+    note_metadata_t meta;
+    FILE *f;
+    bool extending;
+    long base;  // Stored body length before an extension
+} files_writer_t;
+
+static esp_err_t files_create(const note_metadata_t *meta, void **handle)
+{
+    files_writer_t *writer = malloc(sizeof(files_writer_t));
+    if (!writer) {
+        return ESP_ERR_NO_MEM;
+    }
+    writer->meta = *meta;
+    writer->extending = false;
+
+    char part_path[64];
+    part_path_for(meta->id, part_path, sizeof(part_path));
+    writer->f = fopen(part_path, "wb");
+    if (!writer->f) {
+        ESP_LOGE(TAG, "Failed to create message file: %s (errno=%d)", part_path, errno);
+        free(writer);
+        return ESP_FAIL;
+    }
+
+    *handle = writer;
+    return ESP_OK;
+}
+
+// Stored length of the first size body bytes: the bytes themselves, or the
+// codec frames holding them (frame headers carry both lengths)
+static esp_err_t stored_length(FILE *f, const note_metadata_t *meta, uint32_t size, long *len)
+{
+    if (!meta->compressed) {
+        *len = size;
+        return ESP_OK;
+    }
+
+    uint32_t raw = 0;
+    long pos = 0;
+    while (raw < size) {
+        note_codec_frame_t hdr;
+        if (fseek(f, pos, SEEK_SET) != 0 || fread(&hdr, 1, sizeof(hdr), f) != sizeof(hdr) ||
+            hdr.raw_len == 0) {
+            return ESP_ERR_INVALID_SIZE;
+        }
+        raw += hdr.raw_len;
+        pos += sizeof(hdr) + hdr.stored_len;
+    }
+    *len = pos;
+    return ESP_OK;
+}
+
+static esp_err_t files_extend(const note_metadata_t *meta, uint32_t old_size, void **handle)
+{
+    files_writer_t *writer = malloc(sizeof(files_writer_t));
+    if (!writer) {
+        return ESP_ERR_NO_MEM;
+    }
+    writer->meta = *meta;
+    writer->extending = true;
+
+    char msg_path[64];
+    msg_path_for(meta->id, msg_path, sizeof(msg_path));
+    writer->f = fopen(msg_path, "r+b");
+    if (!writer->f) {
+        ESP_LOGE(TAG, "Failed to open message file: %s (errno=%d)", msg_path, errno);
+        free(writer);
+        return ESP_ERR_NOT_FOUND;
+    }
+
+    // Bytes of an extension cut off by a reboot may trail the body; the
+    // new ones go right after what the metadata accounts for
+    esp_err_t err = stored_length(writer->f, meta, old_size, &writer->base);
+    struct stat st;
+    if (err == ESP_OK && fstat(fileno(writer->f), &st) != 0) {
+        err = ESP_FAIL;
+    } else if (err == ESP_OK && st.st_size < writer->base) {
+        err = ESP_ERR_INVALID_SIZE;
+    } else if (err == ESP_OK &&
+               ((st.st_size > writer->base && ftruncate(fileno(writer->f), writer->base) != 0) ||
+                fseek(writer->f, writer->base, SEEK_SET) != 0)) {
+        err = ESP_FAIL;
+    }
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to extend note %s: %s", meta->id, esp_err_to_name(err));
+        fclose(writer->f);
+        free(writer);
+        return err;
+    }
+
+    *handle = writer;
+    return ESP_OK;
+}
+
+static esp_err_t files_append(void *handle, const char *data, size_t len)
+{
+    files_writer_t *writer = handle;
+    if (fwrite(data, 1, len, writer->f) != len) {
+        ESP_LOGE(TAG, "Failed to write message for note %s (errno=%d)", writer->meta.id, errno);
+        return ESP_FAIL;
+    }
+    return ESP_OK;
+}
+
+static esp_err_t files_commit(void *handle)
+{
+    files_writer_t *writer = handle;
+    const note_metadata_t *meta = &writer->meta;
+    char part_path[64];
+    char msg_path[64];
+    char meta_path[64];
+    part_path_for(meta->id, part_path, sizeof(part_path));
+    msg_path_for(meta->id, msg_path, sizeof(msg_path));
+    meta_path_for(meta->id, meta_path, sizeof(meta_path));
+
+    esp_err_t err = ESP_OK;
+    if (writer->extending) {
+        // Until the metadata is replaced the note reads as before
+        err = fclose(writer->f) == 0 ? replace_metadata(meta) : ESP_FAIL;
+        if (err != ESP_OK) {
+            ESP_LOGE(TAG, "Failed to extend note %s (errno=%d)", meta->id, errno);
+            truncate(msg_path, writer->base);
+        }
+    } else if (fclose(writer->f) != 0 || rename(part_path, msg_path) != 0) {
+        ESP_LOGE(TAG, "Failed to finish message file: %s (errno=%d)", msg_path, errno);
+        unlink(part_path);
+        err = ESP_FAIL;
+    } else {
+        err = write_metadata(meta_path, meta);
+        if (err != ESP_OK) {
+            unlink(meta_path);
+            unlink(msg_path);
+        }
+    }
+
+    free(writer);
+    return err;
+}
+
+// Each commit closes its own files, which flushes them to flash
+static esp_err_t files_sync(void)
+{
+    return ESP_OK;
+}
+
+static void files_abort(void *handle)
+{
+    files_writer_t *writer = handle;
+    char path[64];
+
+    fclose(writer->f);
+    if (writer->extending) {
+        msg_path_for(writer->meta.id, path, sizeof(path));
+        truncate(path, writer->base);
+    } else {
+        part_path_for(writer->meta.id, path, sizeof(path));
+        unlink(path);
+    }
+    free(writer);
+}
+
+static esp_err_t files_open(const note_metadata_t *meta, void **handle)
+{
+    char msg_path[64];
+    msg_path_for(meta->id, msg_path, sizeof(msg_path));
+
+    FILE *f = fopen(msg_path, "r");
+    if (!f) {
+        ESP_LOGE(TAG, "Failed to open message file: %s", msg_path);
+        return ESP_ERR_NOT_FOUND;
+    }
+
+    *handle = f;
+    return ESP_OK;
+}
+
+static esp_err_t files_read(void *handle, char *buf, size_t buf_len, size_t *read_len)
+{
+    FILE *f = handle;
+    *read_len = fread(buf, 1, buf_len, f);
+    return ferror(f) ? ESP_FAIL : ESP_OK;
+}
+
+static void files_close(void *handle)
+{
+    fclose(handle);
+}
+
+static esp_err_t files_remove(const note_metadata_t *meta)
+{
+    char meta_path[64];
+    char msg_path[64];
+    meta_path_for(meta->id, meta_path, sizeof(meta_path));
+    msg_path_for(meta->id, msg_path, sizeof(msg_path));
+
+    unlink(meta_path);
+    unlink(msg_path);
+    return ESP_OK;
+}
+
+// Settle a note the checkpoint does not know about. Commit renames the body
+// before writing the metadata, so a note is complete once its .meta reads back.
+static esp_err_t files_recover(const char *note_id, note_metadata_t *meta)
+{
+    char meta_path[64];
+    char msg_path[64];
+    char part_path[64];
+    meta_path_for(note_id, meta_path, sizeof(meta_path));
+    msg_path_for(note_id, msg_path, sizeof(msg_path));
+    part_path_for(note_id, part_path, sizeof(part_path));
+
+    struct stat st;
+    if (stat(part_path, &st) == 0) {
+        ESP_LOGW(TAG, "Removing incomplete upload %s", part_path);
+        unlink(part_path);
+    }
+
+    bool has_meta = stat(meta_path, &st) == 0;
+    bool has_msg = stat(msg_path, &st) == 0;
+    if (!has_meta && !has_msg) {
+        // ID was reserved but never used
+        return ESP_ERR_NOT_FOUND;
+    }
+
+    bool outdated;
+    if (has_msg && read_metadata(meta_path, note_id, meta, &outdated) == ESP_OK) {
+        return ESP_OK;
+    }
+
+    ESP_LOGW(TAG, "Removing incomplete note %s", note_id);
+    unlink(meta_path);
+    unlink(msg_path);
+    return ESP_ERR_NOT_FOUND;
+}
+
+const storage_engine_t storage_engine_files = {
+    .name = "files",
+    .load = files_load,
+    .create = files_create,
+    .extend = files_extend,
+    .append = files_append,
+    .commit = files_commit,
+    .sync = files_sync,
+    .abort = files_abort,
+    .open = files_open,
+    .read = files_read,
+    .close = files_close,
+    .remove = files_remove,
+    .recover = files_recover,
+};
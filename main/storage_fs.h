@@ -0,0 +1,41 @@
+#ifndef STORAGE_FS_H
+#define STORAGE_FS_H
+
+#include "esp_err.h"
+#include <stddef.h>
+
+/**
+ * Filesystem mounted at STORAGE_BASE_PATH on the storage partition.
+ * Storage engines only use POSIX file calls beneath the mount point;
+ * everything filesystem-specific goes through this table.
+ */
+typedef struct {
+    const char *name;
+
+    /**
+     * Mount the partition at STORAGE_BASE_PATH, formatting it if unreadable
+     */
+    esp_err_t (*mount)(void);
+
+    /**
+     * Report partition capacity and bytes in use
+     */
+    esp_err_t (*info)(size_t *total, size_t *used);
+
+    /**
+     * Optional: collect garbage until size bytes can be written without
+     * further GC. NULL if the filesystem has nothing to run ahead of time.
+     *
+     * @return ESP_OK once that much is ready, ESP_ERR_NOT_FINISHED if the
+     *         partition is too full
+     */
+    esp_err_t (*gc)(size_t size);
+} storage_fs_t;
+
+// SPIFFS: flat namespace, wear levelling by background GC
+extern const storage_fs_t storage_fs_spiffs;
+
+// LittleFS: power-loss safe, copy-on-write metadata
+extern const storage_fs_t storage_fs_littlefs;
+
+#endif // STORAGE_FS_H
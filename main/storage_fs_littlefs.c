@@ -0,0 +1,33 @@
+#include "storage_fs.h"
+#include "constants.h"
+#include "esp_log.h"
+#include "esp_littlefs.h"
+
+static const char *TAG = "storage_fs";
+
+static esp_err_t littlefs_mount(void)
+{
+    esp_vfs_littlefs_conf_t conf = {
+        .base_path = STORAGE_BASE_PATH,
+        .partition_label = STORAGE_PARTITION_LABEL,
+        .format_if_mount_failed = true,
+        .dont_mount = false,
+    };
+
+    esp_err_t err = esp_vfs_littlefs_register(&conf);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to mount LittleFS: %s", esp_err_to_name(err));
+    }
+    return err;
+}
+
+static esp_err_t littlefs_info(size_t *total, size_t *used)
+{
+    return esp_littlefs_info(STORAGE_PARTITION_LABEL, total, used);
+}
+
+const storage_fs_t storage_fs_littlefs = {
+    .name = "LittleFS",
+    .mount = littlefs_mount,
+    .info = littlefs_info,
+};
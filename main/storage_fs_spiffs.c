@@ -0,0 +1,41 @@
+#include "storage_fs.h"
+#include "constants.h"
+#include "esp_log.h"
+#include "esp_spiffs.h"
+
+static const char *TAG = "storage_fs";
+
+static esp_err_t spiffs_mount(void)
+{
+    esp_vfs_spiffs_conf_t conf = {
+        .base_path = STORAGE_BASE_PATH,
+        .partition_label = STORAGE_PARTITION_LABEL,
+        .max_files = STORAGE_MAX_FILES,
+        .format_if_mount_failed = true
+    };
+
+    esp_err_t err = esp_vfs_spiffs_register(&conf);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to mount SPIFFS: %s", esp_err_to_name(err));
+    }
+    return err;
+}
+
+static esp_err_t spiffs_info(size_t *total, size_t *used)
+{
+    return esp_spiffs_info(STORAGE_PARTITION_LABEL, total, used);
+}
+
+// Moves live pages out of mostly deleted blocks and erases them, the same
+// work a write would otherwise do inline when it runs out of free pages
+static esp_err_t spiffs_gc(size_t size)
+{
+    return esp_spiffs_gc(STORAGE_PARTITION_LABEL, size);
+}
+
+const storage_fs_t storage_fs_spiffs = {
+    .name = "SPIFFS",
+    .mount = spiffs_mount,
+    .info = spiffs_info,
+    .gc = spiffs_gc,
+};
@@ -0,0 +1,1156 @@
+#include "storage_engine.h"
+#include "note_codec.h"
+#include "esp_log.h"
+#include "esp_heap_caps.h"
+#include "esp_rom_crc.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+#include <string.h>
+#include <stdlib.h>
+#include <dirent.h>
+#include <unistd.h>
+#include <errno.h>
+#include <inttypes.h>
+#include <sys/stat.h>
+
+#define LOG_RECORD_MAGIC 0x474F4C44  // "DLOG"
+#define LOG_RECORD_PUT 1
+#define LOG_RECORD_DELETE 2
+#define LOG_FLAG_ENCRYPTED 0x01
+#define LOG_FLAG_COMPRESSED 0x02  // Body is note_codec frames
+#define LOG_FLAG_EXPIRES 0x04     // The title is followed by a uint64_t expiry time
+#define LOG_TITLE_AREA_MAX (MAX_TITLE_LENGTH + sizeof(uint64_t))
+#define LOG_COPY_CHUNK 512
+#define LOG_LOC_INITIAL_CAPACITY 64
+#define LOG_INLINE_BODY_MAX MAX_NOTE_SIZE_BYTES  // Larger uploads are streamed into a segment
+
+// On-flash record: header, title bytes (title_len covers the expiry time
+// too when LOG_FLAG_EXPIRES is set), then body bytes
+typedef struct __attribute__((packed)) {
+    uint32_t magic;
+    uint8_t type;
+    uint8_t flags;
+    uint8_t title_len;
+    uint8_t reserved;
+    uint32_t id;
+    uint64_t timestamp;
+    uint32_t body_len;
+    union {
+        uint32_t target_seg;  // DELETE: segment holding the record being deleted
+        uint32_t raw_len;     // Compressed PUT: body length before compression
+    };
+    uint32_t body_crc;
+    uint32_t header_crc;  // Covers this header (with header_crc = 0) and the title
+} log_record_t;
+
+typedef struct {
+    uint32_t num;
+    uint32_t size;
+    uint32_t dead;     // Bytes of superseded records
+    uint32_t readers;  // Open log_reader_t handles; pins the file
+    bool retired;      // Compacted, unlinked once the last reader closes
+    bool streaming;    // A writer owns the tail; nothing is appended after it
+} log_segment_t;
+
+// Where the live copy of a note sits
+typedef struct {
+    uint32_t id;
+    uint32_t seg;
+    uint32_t offset;
+    uint32_t len;
+} log_loc_t;
+
+// Open note body; holds a reader reference on its segment
+typedef struct {
+    FILE *f;
+    uint32_t seg;
+    uint32_t remaining;
+    uint32_t crc;
+    uint32_t body_crc;
+} log_reader_t;
+
+// Note being uploaded. The record header carries the body CRC, so small
+// bodies are collected first and appended in one go on commit. Larger ones
+// are written straight into a segment behind a placeholder header, which is
+// filled in on commit.
+typedef struct {
+    log_record_t rec;
+    char title[LOG_TITLE_AREA_MAX];
+    char *body;  // Small notes are buffered in RAM
+    FILE *f;     // Larger ones own the tail of segment seg from offset on
+    uint32_t seg;
+    uint32_t offset;
+    uint32_t len;
+    uint32_t capacity;  // Most body bytes append may accept
+} log_writer_t;
+
+typedef esp_err_t (*record_visitor_t)(uint32_t seg, uint32_t offset,
+                                      const log_record_t *rec, const char *title, void *ctx);
+
+static const char *TAG = "storage_log";
+static SemaphoreHandle_t g_lock = NULL;
+static TaskHandle_t g_compact_task = NULL;
+
+// Segments ordered by number; the last one is the active append target
+static log_segment_t g_segments[LOG_MAX_SEGMENTS];
+static size_t g_segment_count = 0;
+static FILE *g_active = NULL;
+
+// Live record locations ordered by note ID
+static log_loc_t *g_locs = NULL;
+static size_t g_loc_count = 0;
+static size_t g_loc_capacity = 0;
+
+// Notes appended since the last sync; log_sync() adds them to g_locs
+static log_loc_t g_pending[STORAGE_GROUP_COMMIT_MAX];
+static size_t g_pending_count = 0;
+static bool g_pending_lost = false;
+
+static void segment_path(uint32_t num, char *path, size_t len)
+{
+    snprintf(path, len, "%s/seg_%08" PRIx32 ".log", STORAGE_BASE_PATH, num);
+}
+
+static uint32_t note_key(const note_metadata_t *meta)
+{
+    return (uint32_t)strtoul(meta->id, NULL, 16);
+}
+
+static uint32_t record_size(const log_record_t *rec)
+{
+    return sizeof(log_record_t) + rec->title_len + rec->body_len;
+}
+
+static uint32_t record_header_crc(const log_record_t *rec, const char *title)
+{
+    log_record_t tmp = *rec;
+    tmp.header_crc = 0;
+    uint32_t crc = esp_rom_crc32_le(0, (const uint8_t *)&tmp, sizeof(tmp));
+    return esp_rom_crc32_le(crc, (const uint8_t *)title, tmp.title_len);
+}
+
+static log_segment_t *find_segment(uint32_t num)
+{
+    for (size_t i = 0; i < g_segment_count; i++) {
+        if (g_segments[i].num == num) {
+            return &g_segments[i];
+        }
+    }
+    return NULL;
+}
+
+static bool is_sealed(const log_segment_t *seg)
+{
+    return seg != &g_segments[g_segment_count - 1];
+}
+
+static bool needs_compaction(const log_segment_t *seg)
+{
+    return is_sealed(seg) && !seg->streaming && seg->size > 0 &&
+           (uint64_t)seg->dead * 100 >= (uint64_t)seg->size * LOG_COMPACT_THRESHOLD_PCT;
+}
+
+// Location index
+
+static esp_err_t locs_reserve(size_t needed)
+{
+    if (needed <= g_loc_capacity) {
+        return ESP_OK;
+    }
+
+    size_t capacity = g_loc_capacity ? g_loc_capacity * 2 : LOG_LOC_INITIAL_CAPACITY;
+    while (capacity < needed) {
+        capacity *= 2;
+    }
+
+    log_loc_t *locs = heap_caps_realloc_prefer(g_locs, capacity * sizeof(log_loc_t), 2,
+                                               MALLOC_CAP_SPIRAM, MALLOC_CAP_DEFAULT);
+    if (!locs) {
+        return ESP_ERR_NO_MEM;
+    }
+
+    g_locs = locs;
+    g_loc_capacity = capacity;
+    return ESP_OK;
+}
+
+static size_t locs_lower_bound(uint32_t id)
+{
+    size_t lo = 0, hi = g_loc_count;
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        if (g_locs[mid].id < id) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    return lo;
+}
+
+static log_loc_t *locs_find(uint32_t id)
+{
+    size_t pos = locs_lower_bound(id);
+    return (pos < g_loc_count && g_locs[pos].id == id) ? &g_locs[pos] : NULL;
+}
+
+static esp_err_t locs_insert(const log_loc_t *loc)
+{
+    esp_err_t err = locs_reserve(g_loc_count + 1);
+    if (err != ESP_OK) {
+        return err;
+    }
+
+    size_t pos = (g_loc_count == 0 || g_locs[g_loc_count - 1].id < loc->id)
+                     ? g_loc_count : locs_lower_bound(loc->id);
+    memmove(&g_locs[pos + 1], &g_locs[pos], (g_loc_count - pos) * sizeof(log_loc_t));
+    g_locs[pos] = *loc;
+    g_loc_count++;
+    return ESP_OK;
+}
+
+static void locs_remove(log_loc_t *loc)
+{
+    size_t pos = loc - g_locs;
+    memmove(&g_locs[pos], &g_locs[pos + 1], (g_loc_count - pos - 1) * sizeof(log_loc_t));
+    g_loc_count--;
+}
+
+static int compare_locs(const void *a, const void *b)
+{
+    const log_loc_t *la = a, *lb = b;
+    if (la->id != lb->id) {
+        return la->id < lb->id ? -1 : 1;
+    }
+    return la->seg < lb->seg ? -1 : (la->seg > lb->seg);
+}
+
+// Segment files
+
+static esp_err_t open_new_segment(void)
+{
+    if (g_segment_count >= LOG_MAX_SEGMENTS) {
+        ESP_LOGE(TAG, "Segment table full");
+        return ESP_ERR_NO_MEM;
+    }
+
+    uint32_t num = g_segment_count ? g_segments[g_segment_count - 1].num + 1 : 1;
+    char path[64];
+    segment_path(num, path, sizeof(path));
+
+    // Not "ab": a streamed record's header is written back in place
+    FILE *f = fopen(path, "wb");
+    if (!f) {
+        ESP_LOGE(TAG, "Failed to create segment %s (errno=%d)", path, errno);
+        return ESP_FAIL;
+    }
+
+    if (g_active) {
+        fclose(g_active);
+    }
+    g_active = f;
+    g_segments[g_segment_count++] = (log_segment_t){ .num = num };
+    ESP_LOGI(TAG, "Opened segment %08" PRIx32, num);
+    return ESP_OK;
+}
+
+// Reserve space for a record of len bytes at the end of the active segment
+static esp_err_t append_begin(uint32_t len, uint32_t *seg, uint32_t *offset)
+{
+    log_segment_t *active = &g_segments[g_segment_count - 1];
+    if (!g_active || (active->size > 0 && active->size + len > LOG_SEGMENT_SIZE)) {
+        esp_err_t err = open_new_segment();
+        if (err != ESP_OK) {
+            return err;
+        }
+        active = &g_segments[g_segment_count - 1];
+    }
+
+    *seg = active->num;
+    *offset = active->size;
+    return ESP_OK;
+}
+
+// Whatever reached flash after the last good record is unreadable; count it
+// as dead. The segment must never be appended to again.
+static void account_torn(log_segment_t *seg)
+{
+    char path[64];
+    struct stat st;
+    segment_path(seg->num, path, sizeof(path));
+    if (stat(path, &st) == 0 && (uint32_t)st.st_size > seg->size) {
+        seg->dead += st.st_size - seg->size;
+        seg->size = st.st_size;
+    }
+}
+
+// The next append opens a new segment
+static void close_torn_active(void)
+{
+    fclose(g_active);
+    g_active = NULL;
+    account_torn(&g_segments[g_segment_count - 1]);
+}
+
+// Unsynced notes whose commit is reported as failed may still be intact on
+// flash; tombstone them so they do not come back on the next boot
+static esp_err_t cancel_pending(void)
+{
+    log_segment_t *active = &g_segments[g_segment_count - 1];
+    bool ok = true;
+    for (size_t i = 0; i < g_pending_count && ok; i++) {
+        log_record_t rec = {
+            .magic = LOG_RECORD_MAGIC,
+            .type = LOG_RECORD_DELETE,
+            .id = g_pending[i].id,
+            .target_seg = g_pending[i].seg,
+            .body_crc = esp_rom_crc32_le(0, NULL, 0),
+        };
+        rec.header_crc = record_header_crc(&rec, "");
+        ok = fwrite(&rec, 1, sizeof(rec), g_active) == sizeof(rec);
+    }
+
+    if (ok && fflush(g_active) == 0 && fsync(fileno(g_active)) == 0) {
+        active->size += g_pending_count * sizeof(log_record_t);
+        return ESP_OK;
+    }
+    close_torn_active();
+    return ESP_FAIL;
+}
+
+// Give up on unsynced notes; their bytes count as dead
+static void drop_pending(void)
+{
+    for (size_t i = 0; i < g_pending_count; i++) {
+        log_segment_t *seg = find_segment(g_pending[i].seg);
+        if (seg) {
+            seg->dead += g_pending[i].len;
+        }
+    }
+    if (g_pending_count > 0) {
+        g_pending_lost = true;
+    }
+    g_pending_count = 0;
+}
+
+static void seal_active(void)
+{
+    ESP_LOGE(TAG, "Append to segment %08" PRIx32 " failed, sealing it",
+             g_segments[g_segment_count - 1].num);
+    close_torn_active();
+
+    // The tombstones go into the fresh segment, after every record they cancel
+    esp_err_t err = open_new_segment();
+    if (g_pending_count > 0) {
+        if (err == ESP_OK) {
+            err = cancel_pending();
+        }
+        if (err != ESP_OK) {
+            ESP_LOGE(TAG, "%zu failed notes may reappear after a reboot", g_pending_count);
+        }
+        drop_pending();
+    }
+}
+
+// Account an appended record, or seal the segment around a torn write.
+// Durable appends are synced now; others wait for log_sync().
+static esp_err_t append_end(uint32_t len, bool ok, bool durable)
+{
+    log_segment_t *active = &g_segments[g_segment_count - 1];
+
+    if (ok && (!durable || (fflush(g_active) == 0 && fsync(fileno(g_active)) == 0))) {
+        active->size += len;
+        return ESP_OK;
+    }
+
+    seal_active();
+    return ESP_FAIL;
+}
+
+// Called with g_lock held. A failure is remembered until log_sync() has
+// reported it to the whole batch.
+static esp_err_t sync_pending(void)
+{
+    if (g_pending_count > 0 && g_active &&
+        (fflush(g_active) != 0 || fsync(fileno(g_active)) != 0)) {
+        seal_active();
+    }
+    if (g_pending_lost) {
+        return ESP_FAIL;
+    }
+
+    esp_err_t err = ESP_OK;
+    for (size_t i = 0; i < g_pending_count && err == ESP_OK; i++) {
+        err = locs_insert(&g_pending[i]);
+    }
+    g_pending_count = 0;
+    return err;
+}
+
+// A durable append that fails seals the segment and would take unsynced
+// records of the current batch down with it; sync them first. A failure here
+// is the batch's own and reaches it through log_sync().
+static void sync_pending_first(void)
+{
+    if (g_pending_count > 0) {
+        sync_pending();
+    }
+}
+
+// Walk every intact record in a segment. *valid_len receives the length of
+// the readable prefix; anything after it is a torn write.
+static esp_err_t scan_segment(uint32_t num, record_visitor_t visit, void *ctx,
+                              uint32_t *file_len, uint32_t *valid_len)
+{
+    char path[64];
+    segment_path(num, path, sizeof(path));
+
+    FILE *f = fopen(path, "rb");
+    if (!f) {
+        return ESP_ERR_NOT_FOUND;
+    }
+
+    fseek(f, 0, SEEK_END);
+    uint32_t size = (uint32_t)ftell(f);
+    fseek(f, 0, SEEK_SET);
+
+    esp_err_t err = ESP_OK;
+    uint32_t offset = 0;
+    log_record_t rec;
+    char title[LOG_TITLE_AREA_MAX];
+
+    while (offset + sizeof(rec) <= size && fread(&rec, 1, sizeof(rec), f) == sizeof(rec)) {
+        if (rec.magic != LOG_RECORD_MAGIC || rec.title_len >= LOG_TITLE_AREA_MAX ||
+            fread(title, 1, rec.title_len, f) != rec.title_len ||
+            record_header_crc(&rec, title) != rec.header_crc ||
+            offset + record_size(&rec) > size) {
+            break;
+        }
+        title[rec.title_len] = '\0';
+
+        if (visit) {
+            err = visit(num, offset, &rec, title, ctx);
+            if (err != ESP_OK) {
+                break;
+            }
+        }
+
+        offset += record_size(&rec);
+        fseek(f, offset, SEEK_SET);
+    }
+
+    fclose(f);
+    if (file_len) *file_len = size;
+    if (valid_len) *valid_len = offset;
+    return err;
+}
+
+static esp_err_t list_segments(void)
+{
+    DIR *dir = opendir(STORAGE_BASE_PATH);
+    if (!dir) {
+        ESP_LOGE(TAG, "Failed to open storage directory: %s (errno=%d)", STORAGE_BASE_PATH, errno);
+        return ESP_FAIL;
+    }
+
+    g_segment_count = 0;
+    struct dirent *entry;
+    while ((entry = readdir(dir)) != NULL) {
+        uint32_t num;
+        if (sscanf(entry->d_name, "seg_%8" SCNx32 ".log", &num) != 1) {
+            continue;
+        }
+        if (g_segment_count >= LOG_MAX_SEGMENTS) {
+            ESP_LOGE(TAG, "Too many segments, ignoring %s", entry->d_name);
+            continue;
+        }
+
+        // Insertion sort keeps the (small) table ordered by segment number
+        size_t pos = g_segment_count;
+        while (pos > 0 && g_segments[pos - 1].num > num) {
+            g_segments[pos] = g_segments[pos - 1];
+            pos--;
+        }
+        g_segments[pos] = (log_segment_t){ .num = num };
+        g_segment_count++;
+    }
+
+    closedir(dir);
+    return ESP_OK;
+}
+
+// Loading
+
+typedef struct {
+    uint32_t *ids;
+    size_t count;
+    size_t capacity;
+} id_list_t;
+
+typedef struct {
+    storage_engine_load_cb_t cb;
+    id_list_t tombstones;
+} load_ctx_t;
+
+static esp_err_t id_list_push(id_list_t *list, uint32_t id)
+{
+    if (list->count == list->capacity) {
+        size_t capacity = list->capacity ? list->capacity * 2 : 64;
+        uint32_t *ids = heap_caps_realloc_prefer(list->ids, capacity * sizeof(uint32_t), 2,
+                                                 MALLOC_CAP_SPIRAM, MALLOC_CAP_DEFAULT);
+        if (!ids) {
+            return ESP_ERR_NO_MEM;
+        }
+        list->ids = ids;
+        list->capacity = capacity;
+    }
+    list->ids[list->count++] = id;
+    return ESP_OK;
+}
+
+static int compare_ids(const void *a, const void *b)
+{
+    uint32_t ia = *(const uint32_t *)a, ib = *(const uint32_t *)b;
+    return ia < ib ? -1 : (ia > ib);
+}
+
+static esp_err_t collect_tombstone(uint32_t seg, uint32_t offset,
+                                   const log_record_t *rec, const char *title, void *ctx)
+{
+    if (rec->type != LOG_RECORD_DELETE) {
+        return ESP_OK;
+    }
+    return id_list_push(&((load_ctx_t *)ctx)->tombstones, rec->id);
+}
+
+static esp_err_t load_record(uint32_t seg, uint32_t offset,
+                             const log_record_t *rec, const char *title, void *ctx)
+{
+    load_ctx_t *lc = ctx;
+    log_segment_t *segment = find_segment(seg);
+
+    if (rec->type == LOG_RECORD_DELETE) {
+        // Tombstones outlive their target only until its segment is compacted
+        if (!find_segment(rec->target_seg)) {
+            segment->dead += record_size(rec);
+        }
+        return ESP_OK;
+    }
+
+    if (rec->type != LOG_RECORD_PUT ||
+        bsearch(&rec->id, lc->tombstones.ids, lc->tombstones.count, sizeof(uint32_t), compare_ids)) {
+        segment->dead += record_size(rec);
+        return ESP_OK;
+    }
+
+    esp_err_t err = locs_reserve(g_loc_count + 1);
+    if (err != ESP_OK) {
+        return err;
+    }
+    g_locs[g_loc_count++] = (log_loc_t){
+        .id = rec->id, .seg = seg, .offset = offset, .len = record_size(rec)
+    };
+
+    note_metadata_t meta;
+    memset(&meta, 0, sizeof(meta));
+    snprintf(meta.id, sizeof(meta.id), "%08" PRIx32, rec->id);
+    size_t title_len = rec->title_len;
+    if ((rec->flags & LOG_FLAG_EXPIRES) && title_len >= sizeof(meta.expires_at)) {
+        title_len -= sizeof(meta.expires_at);
+        memcpy(&meta.expires_at, title + title_len, sizeof(meta.expires_at));
+    }
+    memcpy(meta.title, title, title_len);
+    meta.timestamp = rec->timestamp;
+    meta.compressed = rec->flags & LOG_FLAG_COMPRESSED;
+    meta.size = meta.compressed ? rec->raw_len : rec->body_len;
+    meta.encrypted = rec->flags & LOG_FLAG_ENCRYPTED;
+    return lc->cb(&meta);
+}
+
+static void compact_task(void *arg);
+
+static esp_err_t log_load(storage_engine_load_cb_t cb)
+{
+    g_lock = xSemaphoreCreateMutex();
+    if (!g_lock) {
+        return ESP_ERR_NO_MEM;
+    }
+
+    esp_err_t err = list_segments();
+    if (err != ESP_OK) {
+        return err;
+    }
+
+    load_ctx_t ctx = { .cb = cb };
+    bool torn = false;
+
+    // Pass 1: collect deleted IDs and each segment's intact length
+    for (size_t i = 0; i < g_segment_count && err == ESP_OK; i++) {
+        uint32_t file_len, valid_len;
+        err = scan_segment(g_segments[i].num, collect_tombstone, &ctx, &file_len, &valid_len);
+        g_segments[i].size = file_len;
+        g_segments[i].dead = file_len - valid_len;
+        if (valid_len != file_len) {
+            ESP_LOGW(TAG, "Segment %08" PRIx32 " has %" PRIu32 " torn bytes",
+                     g_segments[i].num, file_len - valid_len);
+            torn = (i == g_segment_count - 1);
+        }
+    }
+    if (ctx.tombstones.count > 1) {
+        qsort(ctx.tombstones.ids, ctx.tombstones.count, sizeof(uint32_t), compare_ids);
+    }
+
+    // Pass 2: report live notes and account dead bytes
+    for (size_t i = 0; i < g_segment_count && err == ESP_OK; i++) {
+        err = scan_segment(g_segments[i].num, load_record, &ctx, NULL, NULL);
+    }
+    heap_caps_free(ctx.tombstones.ids);
+    if (err != ESP_OK) {
+        return err;
+    }
+
+    // A crash mid-compaction can leave a record in two segments; keep the newer copy
+    if (g_loc_count > 1) {
+        qsort(g_locs, g_loc_count, sizeof(log_loc_t), compare_locs);
+        size_t out = 0;
+        for (size_t i = 0; i < g_loc_count; i++) {
+            if (out > 0 && g_locs[out - 1].id == g_locs[i].id) {
+                find_segment(g_locs[out - 1].seg)->dead += g_locs[out - 1].len;
+                g_locs[out - 1] = g_locs[i];
+            } else {
+                g_locs[out++] = g_locs[i];
+            }
+        }
+        g_loc_count = out;
+    }
+
+    // Resume appending to the newest segment unless it is full or torn
+    if (g_segment_count == 0 || torn ||
+        g_segments[g_segment_count - 1].size >= LOG_SEGMENT_SIZE) {
+        err = open_new_segment();
+    } else {
+        char path[64];
+        segment_path(g_segments[g_segment_count - 1].num, path, sizeof(path));
+        g_active = fopen(path, "r+b");
+        err = g_active && fseek(g_active, 0, SEEK_END) == 0 ? ESP_OK : ESP_FAIL;
+    }
+    if (err != ESP_OK) {
+        return err;
+    }
+
+    ESP_LOGI(TAG, "Loaded %zu notes from %zu segments", g_loc_count, g_segment_count);
+
+    if (xTaskCreate(compact_task, "log_compact", 4096, NULL, tskIDLE_PRIORITY + 1,
+                    &g_compact_task) != pdPASS) {
+        ESP_LOGE(TAG, "Failed to start compaction task");
+        return ESP_FAIL;
+    }
+
+    // Segments may already be mostly dead from before the reboot
+    xTaskNotifyGive(g_compact_task);
+    return ESP_OK;
+}
+
+// Note operations
+
+// Give the segment tail back after a streamed record, or seal the segment
+// around an unfinished one. Called with g_lock held.
+static esp_err_t stream_end(log_writer_t *writer, bool ok)
+{
+    log_segment_t *seg = find_segment(writer->seg);
+    seg->streaming = false;
+
+    if (ok && seg == &g_segments[g_segment_count - 1] && !g_active) {
+        // Nothing else was appended meanwhile; the next sync covers the record
+        g_active = writer->f;
+    } else {
+        // Other appends moved on to a newer segment, so this one is sealed
+        ok = ok && fflush(writer->f) == 0 && fsync(fileno(writer->f)) == 0;
+        ok = fclose(writer->f) == 0 && ok;
+    }
+    writer->f = NULL;
+
+    if (!ok) {
+        account_torn(seg);
+        return ESP_FAIL;
+    }
+    seg->size += record_size(&writer->rec);
+    return ESP_OK;
+}
+
+// Claim the active segment's tail and write a placeholder header, which
+// scans stop at until log_commit() fills it in
+static esp_err_t stream_begin(log_writer_t *writer)
+{
+    uint32_t len = sizeof(log_record_t) + writer->rec.title_len + writer->capacity;
+    log_record_t placeholder = { 0 };
+
+    xSemaphoreTake(g_lock, portMAX_DELAY);
+
+    // Records already in the segment are synced through g_active, which is
+    // about to be handed to the writer
+    sync_pending_first();
+    esp_err_t err = append_begin(len, &writer->seg, &writer->offset);
+    if (err == ESP_OK) {
+        writer->f = g_active;
+        g_active = NULL;
+        g_segments[g_segment_count - 1].streaming = true;
+        if (fwrite(&placeholder, 1, sizeof(placeholder), writer->f) != sizeof(placeholder) ||
+            fwrite(writer->title, 1, writer->rec.title_len, writer->f) != writer->rec.title_len) {
+            stream_end(writer, false);
+            err = ESP_FAIL;
+        }
+    }
+
+    xSemaphoreGive(g_lock);
+    return err;
+}
+
+static void writer_free(log_writer_t *writer)
+{
+    if (writer->f) {
+        xSemaphoreTake(g_lock, portMAX_DELAY);
+        stream_end(writer, false);
+        xSemaphoreGive(g_lock);
+    }
+    free(writer->body);
+    free(writer);
+}
+
+static esp_err_t log_create(const note_metadata_t *meta, void **handle)
+{
+    log_writer_t *writer = calloc(1, sizeof(log_writer_t));
+    if (!writer) {
+        return ESP_ERR_NO_MEM;
+    }
+
+    writer->rec = (log_record_t){
+        .magic = LOG_RECORD_MAGIC,
+        .type = LOG_RECORD_PUT,
+        .flags = (meta->encrypted ? LOG_FLAG_ENCRYPTED : 0) |
+                 (meta->compressed ? LOG_FLAG_COMPRESSED : 0) |
+                 (meta->expires_at ? LOG_FLAG_EXPIRES : 0),
+        .title_len = (uint8_t)strnlen(meta->title, MAX_TITLE_LENGTH - 1),
+        .id = note_key(meta),
+        .timestamp = meta->timestamp,
+        .raw_len = meta->compressed ? meta->size : 0,
+    };
+    memcpy(writer->title, meta->title, writer->rec.title_len);
+    if (meta->expires_at) {
+        memcpy(writer->title + writer->rec.title_len, &meta->expires_at, sizeof(meta->expires_at));
+        writer->rec.title_len += sizeof(meta->expires_at);
+    }
+
+    // Compressed bodies are usually smaller, but never larger than the bound
+    writer->capacity = meta->compressed ? NOTE_CODEC_BOUND(meta->size) : meta->size;
+    esp_err_t err = ESP_OK;
+    if (writer->capacity <= LOG_INLINE_BODY_MAX) {
+        writer->body = malloc(writer->capacity ? writer->capacity : 1);
+        err = writer->body ? ESP_OK : ESP_ERR_NO_MEM;
+    } else {
+        err = stream_begin(writer);
+    }
+    if (err != ESP_OK) {
+        free(writer);
+        return err;
+    }
+
+    *handle = writer;
+    return ESP_OK;
+}
+
+static esp_err_t log_append(void *handle, const char *data, size_t len)
+{
+    log_writer_t *writer = handle;
+    if (len > writer->capacity - writer->len) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+
+    if (writer->body) {
+        memcpy(writer->body + writer->len, data, len);
+    } else if (fwrite(data, 1, len, writer->f) != len) {
+        ESP_LOGE(TAG, "Failed to write note %08" PRIx32 " (errno=%d)", writer->rec.id, errno);
+        return ESP_FAIL;
+    }
+
+    writer->rec.body_crc = esp_rom_crc32_le(writer->rec.body_crc, (const uint8_t *)data, len);
+    writer->len += len;
+    return ESP_OK;
+}
+
+static esp_err_t log_commit(void *handle)
+{
+    log_writer_t *writer = handle;
+    log_record_t *rec = &writer->rec;
+    if (!(rec->flags & LOG_FLAG_COMPRESSED) && writer->len != writer->capacity) {
+        writer_free(writer);
+        return ESP_ERR_INVALID_SIZE;
+    }
+    rec->body_len = writer->len;
+    rec->header_crc = record_header_crc(rec, writer->title);
+    uint32_t len = record_size(rec);
+
+    xSemaphoreTake(g_lock, portMAX_DELAY);
+
+    // Once the batch has lost notes the rest of it fails too
+    esp_err_t err = g_pending_lost ? ESP_FAIL : ESP_OK;
+    if (err == ESP_OK && g_pending_count == STORAGE_GROUP_COMMIT_MAX) {
+        err = sync_pending();
+    }
+
+    uint32_t seg, offset;
+    if (writer->f) {
+        // Fill in the placeholder header in place; the body stays where it is
+        bool ok = err == ESP_OK && fseek(writer->f, writer->offset, SEEK_SET) == 0 &&
+                  fwrite(rec, 1, sizeof(*rec), writer->f) == sizeof(*rec) &&
+                  fseek(writer->f, 0, SEEK_END) == 0;
+        seg = writer->seg;
+        offset = writer->offset;
+        esp_err_t end = stream_end(writer, ok);
+        if (err == ESP_OK) {
+            err = end;
+        }
+    } else if (err == ESP_OK) {
+        err = append_begin(len, &seg, &offset);
+        if (err == ESP_OK) {
+            bool ok = fwrite(rec, 1, sizeof(*rec), g_active) == sizeof(*rec) &&
+                      fwrite(writer->title, 1, rec->title_len, g_active) == rec->title_len &&
+                      fwrite(writer->body, 1, rec->body_len, g_active) == rec->body_len;
+            err = append_end(len, ok, false);
+        }
+    }
+    if (err == ESP_OK) {
+        g_pending[g_pending_count++] = (log_loc_t){
+            .id = rec->id, .seg = seg, .offset = offset, .len = len
+        };
+    }
+
+    xSemaphoreGive(g_lock);
+
+    writer_free(writer);
+    return err;
+}
+
+static void log_abort(void *handle)
+{
+    writer_free(handle);
+}
+
+// One fsync covers every record committed since the last call
+static esp_err_t log_sync(void)
+{
+    xSemaphoreTake(g_lock, portMAX_DELAY);
+    esp_err_t err = sync_pending();
+    g_pending_lost = false;
+    xSemaphoreGive(g_lock);
+    return err;
+}
+
+static esp_err_t log_open(const note_metadata_t *meta, void **handle)
+{
+    xSemaphoreTake(g_lock, portMAX_DELAY);
+
+    esp_err_t err = ESP_ERR_NOT_FOUND;
+    log_loc_t *loc = locs_find(note_key(meta));
+    if (!loc) {
+        goto out;
+    }
+
+    char path[64];
+    segment_path(loc->seg, path, sizeof(path));
+    FILE *f = fopen(path, "rb");
+    if (!f) {
+        ESP_LOGE(TAG, "Failed to open segment %s", path);
+        goto out;
+    }
+
+    log_record_t rec;
+    if (fseek(f, loc->offset, SEEK_SET) != 0 || fread(&rec, 1, sizeof(rec), f) != sizeof(rec) ||
+        rec.magic != LOG_RECORD_MAGIC || rec.id != loc->id ||
+        fseek(f, rec.title_len, SEEK_CUR) != 0) {
+        ESP_LOGE(TAG, "Corrupt record for note %s", meta->id);
+        fclose(f);
+        err = ESP_FAIL;
+        goto out;
+    }
+
+    log_reader_t *reader = malloc(sizeof(log_reader_t));
+    if (!reader) {
+        fclose(f);
+        err = ESP_ERR_NO_MEM;
+        goto out;
+    }
+    *reader = (log_reader_t){
+        .f = f,
+        .seg = loc->seg,
+        .remaining = rec.body_len,
+        .body_crc = rec.body_crc,
+    };
+
+    // Compaction leaves the file in place while it is being read
+    find_segment(loc->seg)->readers++;
+    *handle = reader;
+    err = ESP_OK;
+
+out:
+    xSemaphoreGive(g_lock);
+    return err;
+}
+
+// The body checksum can only be checked once the last chunk has been read
+static esp_err_t log_read(void *handle, char *buf, size_t buf_len, size_t *read_len)
+{
+    log_reader_t *reader = handle;
+    *read_len = 0;
+    if (reader->remaining == 0) {
+        return ESP_OK;
+    }
+
+    size_t n = reader->remaining < buf_len ? reader->remaining : buf_len;
+    if (fread(buf, 1, n, reader->f) != n) {
+        ESP_LOGE(TAG, "Short read from segment %08" PRIx32, reader->seg);
+        return ESP_FAIL;
+    }
+    reader->crc = esp_rom_crc32_le(reader->crc, (const uint8_t *)buf, n);
+    reader->remaining -= n;
+
+    if (reader->remaining == 0 && reader->crc != reader->body_crc) {
+        ESP_LOGE(TAG, "Body checksum mismatch in segment %08" PRIx32, reader->seg);
+        return ESP_FAIL;
+    }
+
+    *read_len = n;
+    return ESP_OK;
+}
+
+static void log_close(void *handle)
+{
+    log_reader_t *reader = handle;
+    fclose(reader->f);
+
+    xSemaphoreTake(g_lock, portMAX_DELAY);
+    log_segment_t *seg = find_segment(reader->seg);
+    bool drop = seg && --seg->readers == 0 && seg->retired;
+    xSemaphoreGive(g_lock);
+
+    free(reader);
+    if (drop) {
+        xTaskNotifyGive(g_compact_task);
+    }
+}
+
+static esp_err_t log_remove(const note_metadata_t *meta)
+{
+    xSemaphoreTake(g_lock, portMAX_DELAY);
+
+    log_loc_t *loc = locs_find(note_key(meta));
+    if (!loc) {
+        xSemaphoreGive(g_lock);
+        return ESP_ERR_NOT_FOUND;
+    }
+
+    log_record_t rec = {
+        .magic = LOG_RECORD_MAGIC,
+        .type = LOG_RECORD_DELETE,
+        .id = loc->id,
+        .timestamp = meta->timestamp,
+        .target_seg = loc->seg,
+        .body_crc = esp_rom_crc32_le(0, NULL, 0),
+    };
+    rec.header_crc = record_header_crc(&rec, "");
+
+    sync_pending_first();
+    uint32_t seg, offset;
+    esp_err_t err = append_begin(sizeof(rec), &seg, &offset);
+    if (err == ESP_OK) {
+        err = append_end(sizeof(rec), fwrite(&rec, 1, sizeof(rec), g_active) == sizeof(rec), true);
+    }
+
+    bool compact = false;
+    if (err == ESP_OK) {
+        // append_end may have rolled the segment table; look the target up again
+        loc = locs_find(rec.id);
+        log_segment_t *target = find_segment(loc->seg);
+        target->dead += loc->len;
+        compact = needs_compaction(target);
+        locs_remove(loc);
+    }
+
+    xSemaphoreGive(g_lock);
+
+    if (compact) {
+        xTaskNotifyGive(g_compact_task);
+    }
+    return err;
+}
+
+// Compaction
+
+// Records committed but not yet synced are not in g_locs, so compaction would
+// drop them; their segment waits for the next sync. Called with g_lock held.
+static bool has_pending(uint32_t num)
+{
+    for (size_t i = 0; i < g_pending_count; i++) {
+        if (g_pending[i].seg == num) {
+            return true;
+        }
+    }
+    return false;
+}
+
+static bool pick_victim(uint32_t *num)
+{
+    bool found = false;
+    uint64_t best = 0;
+
+    xSemaphoreTake(g_lock, portMAX_DELAY);
+    for (size_t i = 0; i < g_segment_count; i++) {
+        const log_segment_t *seg = &g_segments[i];
+        if (!needs_compaction(seg) || seg->readers > 0 || has_pending(seg->num)) {
+            continue;
+        }
+        uint64_t ratio = (uint64_t)seg->dead * 1000 / seg->size;
+        if (!found || ratio > best) {
+            best = ratio;
+            *num = seg->num;
+            found = true;
+        }
+    }
+    xSemaphoreGive(g_lock);
+    return found;
+}
+
+// Append a record to the active segment, copying its body from src (which is
+// positioned at the start of the body) and syncing it. Called with g_lock held.
+static esp_err_t copy_record(FILE *src, const log_record_t *rec, const char *title,
+                             uint32_t *new_seg, uint32_t *new_offset)
+{
+    uint32_t len = record_size(rec);
+    sync_pending_first();
+    esp_err_t err = append_begin(len, new_seg, new_offset);
+    if (err != ESP_OK) {
+        return err;
+    }
+
+    bool ok = fwrite(rec, 1, sizeof(*rec), g_active) == sizeof(*rec) &&
+              fwrite(title, 1, rec->title_len, g_active) == rec->title_len;
+
+    char chunk[LOG_COPY_CHUNK];
+    uint32_t remaining = rec->body_len;
+    while (ok && remaining > 0) {
+        size_t n = remaining < sizeof(chunk) ? remaining : sizeof(chunk);
+        ok = fread(chunk, 1, n, src) == n && fwrite(chunk, 1, n, g_active) == n;
+        remaining -= n;
+    }
+
+    return append_end(len, ok, true);
+}
+
+typedef struct {
+    FILE *src;
+    uint32_t copied;
+} compact_ctx_t;
+
+static esp_err_t compact_record(uint32_t seg, uint32_t offset,
+                                const log_record_t *rec, const char *title, void *ctx)
+{
+    compact_ctx_t *cc = ctx;
+    esp_err_t err = ESP_OK;
+
+    xSemaphoreTake(g_lock, portMAX_DELAY);
+
+    log_loc_t *loc = NULL;
+    bool keep;
+    if (rec->type == LOG_RECORD_PUT) {
+        loc = locs_find(rec->id);
+        keep = loc && loc->seg == seg && loc->offset == offset;
+    } else {
+        keep = rec->target_seg != seg && find_segment(rec->target_seg) != NULL;
+    }
+
+    if (keep) {
+        uint32_t new_seg, new_offset;
+        fseek(cc->src, offset + sizeof(log_record_t) + rec->title_len, SEEK_SET);
+        err = copy_record(cc->src, rec, title, &new_seg, &new_offset);
+        if (err == ESP_OK && loc) {
+            loc->seg = new_seg;
+            loc->offset = new_offset;
+        }
+        cc->copied++;
+    }
+
+    xSemaphoreGive(g_lock);
+    return err;
+}
+
+static void compact_segment(uint32_t num)
+{
+    char path[64];
+    segment_path(num, path, sizeof(path));
+
+    xSemaphoreTake(g_lock, portMAX_DELAY);
+    bool retired = find_segment(num)->retired;
+    uint32_t file_len = find_segment(num)->size, valid_len;
+    xSemaphoreGive(g_lock);
+
+    compact_ctx_t ctx = { 0 };
+    esp_err_t err = ESP_OK;
+    if (!retired) {
+        ctx.src = fopen(path, "rb");
+        if (!ctx.src) {
+            ESP_LOGE(TAG, "Failed to open segment %s for compaction", path);
+            return;
+        }
+        err = scan_segment(num, compact_record, &ctx, &file_len, &valid_len);
+        fclose(ctx.src);
+    }
+
+    xSemaphoreTake(g_lock, portMAX_DELAY);
+    log_segment_t *seg = find_segment(num);
+    if (err == ESP_OK && seg->readers > 0) {
+        // Every live record has a newer copy, but a reader still has this one
+        // open; log_close() wakes us again to drop it
+        seg->retired = true;
+        seg->dead = seg->size;
+    } else if (err == ESP_OK) {
+        unlink(path);
+        size_t pos = seg - g_segments;
+        memmove(&g_segments[pos], &g_segments[pos + 1],
+                (g_segment_count - pos - 1) * sizeof(log_segment_t));
+        g_segment_count--;
+        ESP_LOGI(TAG, "Compacted segment %08" PRIx32 ": %" PRIu32 " records kept, %" PRIu32 " bytes reclaimed",
+                 num, ctx.copied, file_len);
+    } else {
+        // Leave it alone until further deletes make it a candidate again
+        ESP_LOGE(TAG, "Compaction of segment %08" PRIx32 " failed: %s", num, esp_err_to_name(err));
+        seg->dead = 0;
+    }
+    xSemaphoreGive(g_lock);
+}
+
+static void compact_task(void *arg)
+{
+    while (1) {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+
+        uint32_t num;
+        while (pick_victim(&num)) {
+            compact_segment(num);
+        }
+    }
+}
+
+const storage_engine_t storage_engine_log = {
+    .name = "log",
+    .load = log_load,
+    .create = log_create,
+    .append = log_append,
+    .commit = log_commit,
+    .sync = log_sync,
+    .abort = log_abort,
+    .open = log_open,
+    .read = log_read,
+    .close = log_close,
+    .remove = log_remove,
+};
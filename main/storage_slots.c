@@ -0,0 +1,692 @@
+#include "storage_engine.h"
+#include "note_meta.h"
+#include "note_codec.h"
+#include "esp_log.h"
+#include "esp_heap_caps.h"
+#include "esp_partition.h"
+#include "esp_rom_crc.h"
+#include "esp_random.h"
+#include "nvs.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+#include <string.h>
+#include <stdlib.h>
+#include <stddef.h>
+#include <inttypes.h>
+
+#define SLOT_MAGIC 0x544C5344  // "DSLT"
+#define SLOT_SECTOR_SIZE 4096
+#define SLOT_BLOCK_SECTORS 16     // 64 KB: erased with one block erase when possible
+#define SLOT_LARGE_SECTORS 256    // Slots above 1 MB are whole multiples of 1 MB
+#define SLOT_LOC_INITIAL_CAPACITY 64
+#define SLOT_SALT_KEY "slot_salt"  // In the "storage" NVS namespace
+
+// Written at the start of a slot once its body is complete, so a slot whose
+// header is still erased was never finished. Deleting a note programs magic
+// to 0, which needs no erase; the rest stays readable to find the slot's end.
+typedef struct __attribute__((packed)) {
+    uint32_t magic;
+    uint32_t sectors;
+    uint32_t body_len;  // Stored bytes following the header
+    uint32_t body_crc;
+    note_meta_record_t meta;
+    uint32_t header_crc;  // Covers everything after magic, seeded with g_salt
+} slot_header_t;
+
+// Where a note lives on the partition
+typedef struct {
+    uint32_t id;
+    uint32_t first;     // First sector of the slot
+    uint32_t sectors;
+    uint32_t body_len;
+    uint32_t body_crc;
+    uint32_t readers;   // Open slot_reader_t handles; the slot is not reused while > 0
+    bool removed;       // Deleted while being read, freed by the last close
+} slot_loc_t;
+
+typedef struct {
+    slot_header_t header;
+    uint32_t first;     // First sector of the slot
+    uint32_t len;
+    uint32_t capacity;  // Most body bytes append may accept
+} slot_writer_t;
+
+typedef struct {
+    uint32_t id;
+    uint32_t offset;  // Partition offset of the next body byte
+    uint32_t remaining;
+    uint32_t crc;
+    uint32_t body_crc;
+} slot_reader_t;
+
+static const char *TAG = "storage_slots";
+static const esp_partition_t *g_part = NULL;
+static SemaphoreHandle_t g_lock = NULL;
+static TaskHandle_t g_erase_task = NULL;
+static uint32_t g_salt = 0;  // Random per partition, so a body cannot carry a header a scan accepts
+
+// One bit per sector. A free sector is either erased (ready for a slot) or
+// dirty (awaiting the eraser); sectors being erased are neither.
+static uint32_t g_sector_count = 0;
+static uint8_t *g_used = NULL;
+static uint8_t *g_erased = NULL;
+static uint32_t g_used_sectors = 0;
+static uint32_t g_erasing_first = 0;
+static uint32_t g_erasing_count = 0;
+
+// Live slots ordered by note ID
+static slot_loc_t *g_locs = NULL;
+static size_t g_loc_count = 0;
+static size_t g_loc_capacity = 0;
+
+static bool bit_get(const uint8_t *map, uint32_t i)
+{
+    return map[i / 8] & (1 << (i % 8));
+}
+
+static void bit_set_range(uint8_t *map, uint32_t first, uint32_t count, bool value)
+{
+    for (uint32_t i = first; i < first + count; i++) {
+        if (value) {
+            map[i / 8] |= 1 << (i % 8);
+        } else {
+            map[i / 8] &= ~(1 << (i % 8));
+        }
+    }
+}
+
+static uint32_t note_key(const note_metadata_t *meta)
+{
+    return (uint32_t)strtoul(meta->id, NULL, 16);
+}
+
+static uint32_t header_crc(const slot_header_t *header)
+{
+    return esp_rom_crc32_le(g_salt, (const uint8_t *)header + sizeof(header->magic),
+                            offsetof(slot_header_t, header_crc) - sizeof(header->magic));
+}
+
+static uint32_t sector_offset(uint32_t sector)
+{
+    return sector * SLOT_SECTOR_SIZE;
+}
+
+// Size classes: powers of two up to 1 MB, then whole megabytes. Slots are
+// aligned to their size (at most a 64 KB block) so freed slots of one class
+// are reused by the next note of that class without fragmenting the rest.
+static uint32_t slot_sectors(uint32_t bytes)
+{
+    uint32_t needed = (bytes + SLOT_SECTOR_SIZE - 1) / SLOT_SECTOR_SIZE;
+    if (needed > SLOT_LARGE_SECTORS) {
+        return (needed + SLOT_LARGE_SECTORS - 1) / SLOT_LARGE_SECTORS * SLOT_LARGE_SECTORS;
+    }
+    uint32_t sectors = 1;
+    while (sectors < needed) {
+        sectors *= 2;
+    }
+    return sectors;
+}
+
+static uint32_t slot_align(uint32_t sectors)
+{
+    return sectors < SLOT_BLOCK_SECTORS ? sectors : SLOT_BLOCK_SECTORS;
+}
+
+// Locations
+
+static slot_loc_t *locs_find(uint32_t id)
+{
+    size_t lo = 0, hi = g_loc_count;
+    while (lo < hi) {
+        size_t mid = (lo + hi) / 2;
+        if (g_locs[mid].id < id) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    return lo < g_loc_count && g_locs[lo].id == id ? &g_locs[lo] : NULL;
+}
+
+static esp_err_t locs_insert(const slot_loc_t *loc)
+{
+    if (g_loc_count == g_loc_capacity) {
+        size_t capacity = g_loc_capacity ? g_loc_capacity * 2 : SLOT_LOC_INITIAL_CAPACITY;
+        slot_loc_t *locs = heap_caps_realloc_prefer(g_locs, capacity * sizeof(slot_loc_t), 2,
+                                                    MALLOC_CAP_SPIRAM, MALLOC_CAP_DEFAULT);
+        if (!locs) {
+            return ESP_ERR_NO_MEM;
+        }
+        g_locs = locs;
+        g_loc_capacity = capacity;
+    }
+
+    size_t i = g_loc_count;
+    while (i > 0 && g_locs[i - 1].id > loc->id) {
+        g_locs[i] = g_locs[i - 1];
+        i--;
+    }
+    g_locs[i] = *loc;
+    g_loc_count++;
+    return ESP_OK;
+}
+
+static void locs_remove(slot_loc_t *loc)
+{
+    size_t i = loc - g_locs;
+    memmove(&g_locs[i], &g_locs[i + 1], (g_loc_count - i - 1) * sizeof(slot_loc_t));
+    g_loc_count--;
+}
+
+// Sector pool
+
+static void free_sectors(uint32_t first, uint32_t count)
+{
+    bit_set_range(g_used, first, count, false);
+    bit_set_range(g_erased, first, count, false);
+    g_used_sectors -= count;
+}
+
+// Sectors left blank by an earlier erase need not be erased again
+static bool sector_blank(uint32_t sector)
+{
+    uint32_t buf[64];
+    for (uint32_t off = 0; off < SLOT_SECTOR_SIZE; off += sizeof(buf)) {
+        if (esp_partition_read(g_part, sector_offset(sector) + off, buf, sizeof(buf)) != ESP_OK) {
+            return false;
+        }
+        for (size_t i = 0; i < sizeof(buf) / sizeof(buf[0]); i++) {
+            if (buf[i] != 0xFFFFFFFF) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+static esp_err_t erase_sectors(uint32_t first, uint32_t count)
+{
+    uint32_t i = first;
+    while (i < first + count && sector_blank(i)) {
+        i++;
+    }
+    if (i == first + count) {
+        return ESP_OK;
+    }
+    return esp_partition_erase_range(g_part, sector_offset(first), count * SLOT_SECTOR_SIZE);
+}
+
+// Find count free sectors for a new slot, preferring a run that is already
+// erased. Caller holds g_lock.
+static bool find_slot(uint32_t count, uint32_t *first, uint32_t *dirty)
+{
+    uint32_t align = slot_align(count);
+    bool found = false;
+    *dirty = UINT32_MAX;
+
+    for (uint32_t start = 0; start + count <= g_sector_count; start += align) {
+        if (g_erasing_count && start < g_erasing_first + g_erasing_count &&
+            g_erasing_first < start + count) {
+            continue;
+        }
+
+        uint32_t run_dirty = 0;
+        uint32_t i;
+        for (i = start; i < start + count && !bit_get(g_used, i); i++) {
+            run_dirty += !bit_get(g_erased, i);
+        }
+        if (i < start + count || run_dirty >= *dirty) {
+            continue;
+        }
+
+        *first = start;
+        *dirty = run_dirty;
+        found = true;
+        if (run_dirty == 0) {
+            break;
+        }
+    }
+    return found;
+}
+
+// Erase freed sectors in the background so creates find the pool ready.
+// Runs of dirty sectors within one 64 KB block go in a single erase.
+static bool erase_next(void)
+{
+    xSemaphoreTake(g_lock, portMAX_DELAY);
+    uint32_t first = 0;
+    while (first < g_sector_count && (bit_get(g_used, first) || bit_get(g_erased, first))) {
+        first++;
+    }
+    if (first == g_sector_count) {
+        xSemaphoreGive(g_lock);
+        return false;
+    }
+    uint32_t count = 1;
+    while (first + count < g_sector_count && (first + count) % SLOT_BLOCK_SECTORS != 0 &&
+           !bit_get(g_used, first + count) && !bit_get(g_erased, first + count)) {
+        count++;
+    }
+    g_erasing_first = first;
+    g_erasing_count = count;
+    xSemaphoreGive(g_lock);
+
+    esp_err_t err = erase_sectors(first, count);
+
+    xSemaphoreTake(g_lock, portMAX_DELAY);
+    g_erasing_count = 0;
+    if (err == ESP_OK) {
+        bit_set_range(g_erased, first, count, true);
+    } else {
+        // Leave the sectors out of the pool rather than retrying forever
+        ESP_LOGE(TAG, "Failed to erase sectors %" PRIu32 "-%" PRIu32 ": %s",
+                 first, first + count - 1, esp_err_to_name(err));
+        bit_set_range(g_used, first, count, true);
+        g_used_sectors += count;
+    }
+    xSemaphoreGive(g_lock);
+    return true;
+}
+
+static void erase_task(void *arg)
+{
+    while (1) {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+        while (erase_next()) {
+        }
+    }
+}
+
+// Load
+
+static esp_err_t load_salt(void)
+{
+    nvs_handle_t nvs;
+    esp_err_t err = nvs_open("storage", NVS_READWRITE, &nvs);
+    if (err != ESP_OK) {
+        return err;
+    }
+
+    err = nvs_get_u32(nvs, SLOT_SALT_KEY, &g_salt);
+    if (err == ESP_ERR_NVS_NOT_FOUND) {
+        // Slots written under another salt read as free and are erased
+        ESP_LOGW(TAG, "No slot salt, starting with an empty partition");
+        g_salt = esp_random();
+        err = nvs_set_u32(nvs, SLOT_SALT_KEY, g_salt);
+        if (err == ESP_OK) {
+            err = nvs_commit(nvs);
+        }
+    }
+    nvs_close(nvs);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to load slot salt: %s", esp_err_to_name(err));
+    }
+    return err;
+}
+
+// A header is only trusted where its size class could have put it, and
+// over sectors no accepted slot holds
+static bool header_valid(const slot_header_t *header, uint32_t sector)
+{
+    if (header->header_crc != header_crc(header) || header->sectors == 0 ||
+        header->sectors > g_sector_count - sector ||
+        slot_sectors(header->sectors * SLOT_SECTOR_SIZE) != header->sectors ||
+        sector % slot_align(header->sectors) != 0 ||
+        header->body_len > header->sectors * SLOT_SECTOR_SIZE - sizeof(slot_header_t)) {
+        return false;
+    }
+    for (uint32_t i = sector; i < sector + header->sectors; i++) {
+        if (bit_get(g_used, i)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static esp_err_t slots_load(storage_engine_load_cb_t cb)
+{
+    g_part = esp_partition_find_first(ESP_PARTITION_TYPE_DATA, ESP_PARTITION_SUBTYPE_ANY,
+                                      SLOT_PARTITION_LABEL);
+    if (!g_part) {
+        ESP_LOGE(TAG, "No \"%s\" partition (flash partitions_slots.csv)", SLOT_PARTITION_LABEL);
+        return ESP_ERR_NOT_FOUND;
+    }
+
+    g_lock = xSemaphoreCreateMutex();
+    g_sector_count = g_part->size / SLOT_SECTOR_SIZE;
+    size_t map_len = (g_sector_count + 7) / 8;
+    g_used = calloc(1, map_len);
+    g_erased = calloc(1, map_len);
+    if (!g_lock || !g_used || !g_erased) {
+        return ESP_ERR_NO_MEM;
+    }
+
+    esp_err_t err = load_salt();
+    if (err != ESP_OK) {
+        return err;
+    }
+
+    // Only the first sector of each live slot is read; free sectors are
+    // checked by the eraser later, since a crash may have left data in them.
+    // Deleted slots are stepped through, as smaller slots may since have
+    // reused part of them.
+    uint32_t sector = 0;
+    while (sector < g_sector_count) {
+        slot_header_t header;
+        err = esp_partition_read(g_part, sector_offset(sector), &header, sizeof(header));
+        if (err != ESP_OK) {
+            return err;
+        }
+
+        if (header.magic != SLOT_MAGIC || !header_valid(&header, sector)) {
+            sector++;
+            continue;
+        }
+
+        note_metadata_t meta;
+        bool outdated;
+        err = note_meta_decode(&header.meta, sizeof(header.meta), &meta, &outdated);
+        if (err != ESP_OK) {
+            ESP_LOGW(TAG, "Bad metadata in slot at sector %" PRIu32 ": %s",
+                     sector, esp_err_to_name(err));
+            sector += header.sectors;
+            continue;
+        }
+
+        slot_loc_t loc = {
+            .id = header.meta.id,
+            .first = sector,
+            .sectors = header.sectors,
+            .body_len = header.body_len,
+            .body_crc = header.body_crc,
+        };
+        err = locs_insert(&loc);
+        if (err == ESP_OK) {
+            err = cb(&meta);
+        }
+        if (err != ESP_OK) {
+            return err;
+        }
+        bit_set_range(g_used, sector, header.sectors, true);
+        g_used_sectors += header.sectors;
+        sector += header.sectors;
+    }
+
+    ESP_LOGI(TAG, "%zu notes in %" PRIu32 " of %" PRIu32 " sectors",
+             g_loc_count, g_used_sectors, g_sector_count);
+
+    if (xTaskCreate(erase_task, "slot_erase", 3072, NULL, tskIDLE_PRIORITY + 1,
+                    &g_erase_task) != pdPASS) {
+        ESP_LOGE(TAG, "Failed to start erase task");
+        return ESP_FAIL;
+    }
+    xTaskNotifyGive(g_erase_task);
+    return ESP_OK;
+}
+
+// Writes
+
+static esp_err_t slots_create(const note_metadata_t *meta, void **handle)
+{
+    slot_writer_t *writer = calloc(1, sizeof(slot_writer_t));
+    if (!writer) {
+        return ESP_ERR_NO_MEM;
+    }
+
+    // Compressed bodies are usually smaller, but never larger than the bound
+    writer->capacity = meta->compressed ? NOTE_CODEC_BOUND(meta->size) : meta->size;
+    note_meta_encode(meta, &writer->header.meta);
+    uint32_t sectors = slot_sectors(sizeof(slot_header_t) + writer->capacity);
+
+    xSemaphoreTake(g_lock, portMAX_DELAY);
+    uint32_t first, dirty;
+    esp_err_t err = ESP_OK;
+    if (!find_slot(sectors, &first, &dirty)) {
+        err = ESP_ERR_NO_MEM;
+    } else {
+        bit_set_range(g_used, first, sectors, true);
+        g_used_sectors += sectors;
+    }
+    xSemaphoreGive(g_lock);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "No free slot of %" PRIu32 " sectors", sectors);
+        free(writer);
+        return err;
+    }
+
+    // The pool ran dry (or is fragmented): the erase happens on this write
+    if (dirty > 0) {
+        ESP_LOGW(TAG, "Erasing %" PRIu32 " sectors inline for note %s", dirty, meta->id);
+        for (uint32_t i = first; i < first + sectors && err == ESP_OK; i++) {
+            if (!bit_get(g_erased, i)) {
+                err = erase_sectors(i, 1);
+            }
+        }
+        if (err != ESP_OK) {
+            xSemaphoreTake(g_lock, portMAX_DELAY);
+            free_sectors(first, sectors);
+            xSemaphoreGive(g_lock);
+            free(writer);
+            return err;
+        }
+    }
+
+    writer->header.sectors = sectors;
+    writer->first = first;
+    *handle = writer;
+    return ESP_OK;
+}
+
+static void writer_release(slot_writer_t *writer)
+{
+    xSemaphoreTake(g_lock, portMAX_DELAY);
+    free_sectors(writer->first, writer->header.sectors);
+    xSemaphoreGive(g_lock);
+    xTaskNotifyGive(g_erase_task);
+    free(writer);
+}
+
+static esp_err_t slots_append(void *handle, const char *data, size_t len)
+{
+    slot_writer_t *writer = handle;
+    if (len > writer->capacity - writer->len) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+
+    uint32_t offset = sector_offset(writer->first) + sizeof(slot_header_t) + writer->len;
+    esp_err_t err = esp_partition_write(g_part, offset, data, len);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to write note %08" PRIx32 ": %s",
+                 writer->header.meta.id, esp_err_to_name(err));
+        return err;
+    }
+    writer->header.body_crc = esp_rom_crc32_le(writer->header.body_crc, (const uint8_t *)data, len);
+    writer->len += len;
+    return ESP_OK;
+}
+
+static esp_err_t slots_commit(void *handle)
+{
+    slot_writer_t *writer = handle;
+    slot_header_t *header = &writer->header;
+    if (!(header->meta.flags & NOTE_META_FLAG_COMPRESSED) && writer->len != writer->capacity) {
+        writer_release(writer);
+        return ESP_ERR_INVALID_SIZE;
+    }
+
+    header->magic = SLOT_MAGIC;
+    header->body_len = writer->len;
+    header->header_crc = header_crc(header);
+
+    // The header goes last: until it is programmed the slot reads as unused
+    esp_err_t err = esp_partition_write(g_part, sector_offset(writer->first), header,
+                                        sizeof(*header));
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to write slot header for note %08" PRIx32 ": %s",
+                 header->meta.id, esp_err_to_name(err));
+        writer_release(writer);
+        return err;
+    }
+
+    slot_loc_t loc = {
+        .id = header->meta.id,
+        .first = writer->first,
+        .sectors = header->sectors,
+        .body_len = header->body_len,
+        .body_crc = header->body_crc,
+    };
+    xSemaphoreTake(g_lock, portMAX_DELAY);
+    err = locs_insert(&loc);
+    xSemaphoreGive(g_lock);
+    free(writer);
+    return err;
+}
+
+// esp_partition_write returns once the data is on flash
+static esp_err_t slots_sync(void)
+{
+    return ESP_OK;
+}
+
+static void slots_abort(void *handle)
+{
+    writer_release(handle);
+}
+
+// Reads
+
+static esp_err_t slots_open(const note_metadata_t *meta, void **handle)
+{
+    slot_reader_t *reader = malloc(sizeof(slot_reader_t));
+    if (!reader) {
+        return ESP_ERR_NO_MEM;
+    }
+
+    xSemaphoreTake(g_lock, portMAX_DELAY);
+    slot_loc_t *loc = locs_find(note_key(meta));
+    if (!loc || loc->removed) {
+        xSemaphoreGive(g_lock);
+        free(reader);
+        return ESP_ERR_NOT_FOUND;
+    }
+    *reader = (slot_reader_t){
+        .id = loc->id,
+        .offset = sector_offset(loc->first) + sizeof(slot_header_t),
+        .remaining = loc->body_len,
+        .body_crc = loc->body_crc,
+    };
+    loc->readers++;
+    xSemaphoreGive(g_lock);
+
+    *handle = reader;
+    return ESP_OK;
+}
+
+// The body checksum can only be checked once the last chunk has been read
+static esp_err_t slots_read(void *handle, char *buf, size_t buf_len, size_t *read_len)
+{
+    slot_reader_t *reader = handle;
+    *read_len = 0;
+    if (reader->remaining == 0) {
+        return ESP_OK;
+    }
+
+    size_t n = reader->remaining < buf_len ? reader->remaining : buf_len;
+    esp_err_t err = esp_partition_read(g_part, reader->offset, buf, n);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to read note %08" PRIx32 ": %s", reader->id, esp_err_to_name(err));
+        return err;
+    }
+    reader->crc = esp_rom_crc32_le(reader->crc, (const uint8_t *)buf, n);
+    reader->offset += n;
+    reader->remaining -= n;
+
+    if (reader->remaining == 0 && reader->crc != reader->body_crc) {
+        ESP_LOGE(TAG, "Body checksum mismatch for note %08" PRIx32, reader->id);
+        return ESP_FAIL;
+    }
+
+    *read_len = n;
+    return ESP_OK;
+}
+
+// Caller holds g_lock
+static void release_slot(slot_loc_t *loc)
+{
+    free_sectors(loc->first, loc->sectors);
+    locs_remove(loc);
+}
+
+static void slots_close(void *handle)
+{
+    slot_reader_t *reader = handle;
+
+    xSemaphoreTake(g_lock, portMAX_DELAY);
+    slot_loc_t *loc = locs_find(reader->id);
+    bool drop = loc && --loc->readers == 0 && loc->removed;
+    if (drop) {
+        release_slot(loc);
+    }
+    xSemaphoreGive(g_lock);
+
+    free(reader);
+    if (drop) {
+        xTaskNotifyGive(g_erase_task);
+    }
+}
+
+static esp_err_t slots_remove(const note_metadata_t *meta)
+{
+    xSemaphoreTake(g_lock, portMAX_DELAY);
+
+    slot_loc_t *loc = locs_find(note_key(meta));
+    if (!loc || loc->removed) {
+        xSemaphoreGive(g_lock);
+        return ESP_ERR_NOT_FOUND;
+    }
+
+    // Clearing the magic only programs bits to 0, so the delete is one small write
+    uint32_t dead = 0;
+    esp_err_t err = esp_partition_write(g_part, sector_offset(loc->first), &dead, sizeof(dead));
+    bool drop = false;
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to clear slot for note %s: %s", meta->id, esp_err_to_name(err));
+    } else if (loc->readers > 0) {
+        loc->removed = true;
+    } else {
+        release_slot(loc);
+        drop = true;
+    }
+
+    xSemaphoreGive(g_lock);
+
+    if (drop) {
+        xTaskNotifyGive(g_erase_task);
+    }
+    return err;
+}
+
+static esp_err_t slots_info(size_t *total, size_t *used)
+{
+    xSemaphoreTake(g_lock, portMAX_DELAY);
+    *total = (size_t)g_sector_count * SLOT_SECTOR_SIZE;
+    *used = (size_t)g_used_sectors * SLOT_SECTOR_SIZE;
+    xSemaphoreGive(g_lock);
+    return ESP_OK;
+}
+
+const storage_engine_t storage_engine_slots = {
+    .name = "slots",
+    .load = slots_load,
+    .create = slots_create,
+    .append = slots_append,
+    .commit = slots_commit,
+    .sync = slots_sync,
+    .abort = slots_abort,
+    .open = slots_open,
+    .read = slots_read,
+    .close = slots_close,
+    .remove = slots_remove,
+    .info = slots_info,
+};
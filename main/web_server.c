@@ -1,12 +1,18 @@
 #include "web_server.h"
 #include "storage.h"
+#include "note_archive.h"
 #include "constants.h"
 #include "esp_log.h"
 #include "esp_http_server.h"
 #include "esp_https_server.h"
+#include "esp_timer.h"
+#include "esp_rom_crc.h"
 #include "cJSON.h"
 #include <string.h>
+#include <stdlib.h>
 #include <sys/time.h>
+#include <time.h>
+#include <inttypes.h>
 
 static const char *TAG = "web_server";
 static httpd_handle_t server = NULL;
@@ -18,63 +24,125 @@ extern const uint8_t prvtkey_pem_start[] asm("_binary_prvtkey_pem_start");
 extern const uint8_t prvtkey_pem_end[]   asm("_binary_prvtkey_pem_end");
 
 
-// Serve static files from SPIFFS
+// Web interface: index.html with its stylesheet and scripts inlined,
+// minified and gzipped at build time (bundle_web.py)
+extern const uint8_t index_html_gz_start[] asm("_binary_index_html_gz_start");
+extern const uint8_t index_html_gz_end[]   asm("_binary_index_html_gz_end");
+
+// Content hash of the page, set once the server starts
+static char g_index_etag[16];
+
+// Responses carry an ETag and are revalidated on every use. Returns true,
+// having sent 304 Not Modified, when the client's If-None-Match lists the
+// etag (or "*"); etag must stay valid until the response is sent.
+static bool send_if_not_modified(httpd_req_t *req, const char *etag)
+{
+    httpd_resp_set_hdr(req, "ETag", etag);
+    httpd_resp_set_hdr(req, "Cache-Control", "no-cache");
+
+    char header[128];
+    if (httpd_req_get_hdr_value_str(req, "If-None-Match", header, sizeof(header)) != ESP_OK ||
+        (strcmp(header, "*") != 0 && !strstr(header, etag))) {
+        return false;
+    }
+    httpd_resp_set_status(req, "304 Not Modified");
+    httpd_resp_send(req, NULL, 0);
+    return true;
+}
+
+// ETag for responses built from the notes: checking it needs no storage access
+static void generation_etag(char *etag, size_t len)
+{
+    snprintf(etag, len, "\"g%08" PRIx32 "\"", storage_generation());
+}
+
+// GET / - Serve the web interface straight from flash-mapped rodata. It is
+// the only static page; files on the storage partition are never served.
 static esp_err_t static_handler(httpd_req_t *req)
 {
     ESP_LOGI(TAG, "Static handler: %s %s", http_method_str(req->method), req->uri);
-    
-    char filepath[600];
-    
-    // Default to index.html
-    if (strcmp(req->uri, "/") == 0) {
-        snprintf(filepath, sizeof(filepath), "%s/index.html", SPIFFS_BASE_PATH);
-    } else {
-        // Truncate URI if needed to prevent overflow
-        size_t uri_len = strlen(req->uri);
-        if (uri_len > 512) {
-            httpd_resp_send_404(req);
-            return ESP_FAIL;
-        }
-        snprintf(filepath, sizeof(filepath), "%s%s", SPIFFS_BASE_PATH, req->uri);
-    }
 
-    FILE *f = fopen(filepath, "r");
-    if (!f) {
+    size_t path_len = strcspn(req->uri, "?");
+    bool is_index = path_len == 1 || (path_len == strlen("/index.html") &&
+                                      strncmp(req->uri, "/index.html", path_len) == 0);
+    if (!is_index) {
         httpd_resp_send_404(req);
         return ESP_FAIL;
     }
 
-    // Set content type
-    if (strstr(filepath, ".html")) {
-        httpd_resp_set_type(req, "text/html");
-    } else if (strstr(filepath, ".css")) {
-        httpd_resp_set_type(req, "text/css");
-    } else if (strstr(filepath, ".js")) {
-        httpd_resp_set_type(req, "application/javascript");
+    if (send_if_not_modified(req, g_index_etag)) {
+        return ESP_OK;
     }
 
-    // Send file in chunks
-    char chunk[512];
-    size_t read_bytes;
-    do {
-        read_bytes = fread(chunk, 1, sizeof(chunk), f);
-        if (read_bytes > 0) {
-            httpd_resp_send_chunk(req, chunk, read_bytes);
-        }
-    } while (read_bytes > 0);
+    // Every browser that can run the Web Crypto code accepts gzip
+    httpd_resp_set_type(req, "text/html");
+    httpd_resp_set_hdr(req, "Content-Encoding", "gzip");
+    return httpd_resp_send(req, (const char *)index_html_gz_start,
+                           index_html_gz_end - index_html_gz_start);
+}
 
-    fclose(f);
-    httpd_resp_send_chunk(req, NULL, 0);
-    return ESP_OK;
+// Note metadata as returned by the list and search endpoints
+static cJSON *notes_to_json(const note_metadata_t *notes, size_t count)
+{
+    cJSON *notes_array = cJSON_CreateArray();
+    if (!notes_array) {
+        return NULL;
+    }
+
+    for (size_t i = 0; i < count; i++) {
+        cJSON *note = cJSON_CreateObject();
+        if (!note) {
+            ESP_LOGE(TAG, "Failed to create note object for index %d", i);
+            continue;
+        }
+        cJSON_AddStringToObject(note, "id", notes[i].id);
+        cJSON_AddStringToObject(note, "title", notes[i].title);
+        cJSON_AddNumberToObject(note, "timestamp", (double)notes[i].timestamp);
+        cJSON_AddBoolToObject(note, "encrypted", notes[i].encrypted);
+        if (notes[i].expires_at) {
+            cJSON_AddNumberToObject(note, "expires_at", (double)notes[i].expires_at);
+        }
+        cJSON_AddItemToArray(notes_array, note);
+    }
+    return notes_array;
 }
 
-// GET /api/notes - List all notes
-static esp_err_t api_list_notes_handler(httpd_req_t *req)
+static esp_err_t list_notes(httpd_req_t *req, uint8_t ns)
 {
     ESP_LOGI(TAG, "Listing notes request received");
-    
+
+    // Any page of any namespace is current until the generation moves
+    char etag[16];
+    generation_etag(etag, sizeof(etag));
+    if (send_if_not_modified(req, etag)) {
+        return ESP_OK;
+    }
+
+    // Parse paging parameters from the query string
+    size_t limit = LIST_PAGE_DEFAULT;
+    char cursor[STORAGE_CURSOR_LEN] = "";
+    storage_order_t order = STORAGE_ORDER_NEWEST_FIRST;
+
+    char query[128];
+    if (httpd_req_get_url_query_str(req, query, sizeof(query)) == ESP_OK) {
+        char value[STORAGE_CURSOR_LEN];
+        if (httpd_query_key_value(query, "limit", value, sizeof(value)) == ESP_OK) {
+            long requested = strtol(value, NULL, 10);
+            if (requested > 0) {
+                limit = requested < LIST_PAGE_MAX ? (size_t)requested : LIST_PAGE_MAX;
+            }
+        }
+        if (httpd_query_key_value(query, "cursor", value, sizeof(value)) == ESP_OK) {
+            strncpy(cursor, value, sizeof(cursor) - 1);
+        }
+        if (httpd_query_key_value(query, "order", value, sizeof(value)) == ESP_OK &&
+            strcmp(value, "oldest") == 0) {
+            order = STORAGE_ORDER_OLDEST_FIRST;
+        }
+    }
+
     // Allocate notes array dynamically to avoid stack overflow
-    note_metadata_t *notes = malloc(10 * sizeof(note_metadata_t));
+    note_metadata_t *notes = malloc(limit * sizeof(note_metadata_t));
     if (!notes) {
         ESP_LOGE(TAG, "Failed to allocate memory for notes list");
         httpd_resp_set_status(req, "500 Internal Server Error");
@@ -83,7 +151,14 @@ static esp_err_t api_list_notes_handler(httpd_req_t *req)
     }
     
     size_t count = 0;
-    esp_err_t err = storage_list_notes(notes, 10, &count);
+    char next_cursor[STORAGE_CURSOR_LEN];
+    esp_err_t err = storage_list_notes(ns, order, cursor, notes, limit, &count, next_cursor);
+    if (err == ESP_ERR_INVALID_ARG) {
+        free(notes);
+        httpd_resp_set_status(req, "400 Bad Request");
+        httpd_resp_sendstr(req, "{\"error\":\"Invalid cursor\"}");
+        return ESP_FAIL;
+    }
     if (err != ESP_OK) {
         ESP_LOGE(TAG, "Failed to list notes: %s", esp_err_to_name(err));
         free(notes);
@@ -103,7 +178,7 @@ static esp_err_t api_list_notes_handler(httpd_req_t *req)
         return ESP_FAIL;
     }
     
-    cJSON *notes_array = cJSON_CreateArray();
+    cJSON *notes_array = notes_to_json(notes, count);
     if (!notes_array) {
         ESP_LOGE(TAG, "Failed to create JSON array");
         cJSON_Delete(root);
@@ -113,24 +188,124 @@ static esp_err_t api_list_notes_handler(httpd_req_t *req)
         return ESP_FAIL;
     }
 
-    for (size_t i = 0; i < count; i++) {
-        cJSON *note = cJSON_CreateObject();
-        if (!note) {
-            ESP_LOGE(TAG, "Failed to create note object for index %d", i);
-            continue;
+    cJSON_AddItemToObject(root, "notes", notes_array);
+    if (next_cursor[0]) {
+        cJSON_AddStringToObject(root, "next_cursor", next_cursor);
+    } else {
+        cJSON_AddNullToObject(root, "next_cursor");
+    }
+    
+    char *json_str = cJSON_PrintUnformatted(root);
+    cJSON_Delete(root);
+    free(notes);
+
+    if (!json_str) {
+        ESP_LOGE(TAG, "Failed to serialize JSON response");
+        httpd_resp_set_status(req, "500 Internal Server Error");
+        httpd_resp_sendstr(req, "{\"error\":\"Failed to serialize response\"}");
+        return ESP_FAIL;
+    }
+
+    httpd_resp_set_type(req, "application/json");
+    httpd_resp_sendstr(req, json_str);
+    free(json_str);
+
+    return ESP_OK;
+}
+
+// GET /api/notes?limit=N&cursor=...&order=oldest - List one page of notes
+static esp_err_t api_list_notes_handler(httpd_req_t *req)
+{
+    return list_notes(req, STORAGE_NS_DEFAULT);
+}
+
+static void url_decode(const char *src, char *dst, size_t len);
+
+static esp_err_t search_notes(httpd_req_t *req, uint8_t ns)
+{
+    size_t limit = LIST_PAGE_DEFAULT;
+    char encoded[SEARCH_MAX_QUERY_LEN * 3 + 1] = "";
+    char q[SEARCH_MAX_QUERY_LEN + 1];
+
+    char query[SEARCH_MAX_QUERY_LEN * 3 + 32];
+    if (httpd_req_get_url_query_str(req, query, sizeof(query)) == ESP_OK) {
+        char value[16];
+        if (httpd_query_key_value(query, "limit", value, sizeof(value)) == ESP_OK) {
+            long requested = strtol(value, NULL, 10);
+            if (requested > 0) {
+                limit = requested < LIST_PAGE_MAX ? (size_t)requested : LIST_PAGE_MAX;
+            }
         }
-        cJSON_AddStringToObject(note, "id", notes[i].id);
-        cJSON_AddStringToObject(note, "title", notes[i].title);
-        cJSON_AddNumberToObject(note, "timestamp", (double)notes[i].timestamp);
-        cJSON_AddBoolToObject(note, "encrypted", notes[i].encrypted);
-        cJSON_AddItemToArray(notes_array, note);
+        httpd_query_key_value(query, "q", encoded, sizeof(encoded));
+    }
+    url_decode(encoded, q, sizeof(q));
+    if (q[0] == '\0') {
+        httpd_resp_set_status(req, "400 Bad Request");
+        httpd_resp_sendstr(req, "{\"error\":\"Missing q parameter\"}");
+        return ESP_FAIL;
+    }
+
+    note_metadata_t *notes = malloc(limit * sizeof(note_metadata_t));
+    if (!notes) {
+        ESP_LOGE(TAG, "Failed to allocate memory for search results");
+        httpd_resp_set_status(req, "500 Internal Server Error");
+        httpd_resp_sendstr(req, "{\"error\":\"Out of memory\"}");
+        return ESP_FAIL;
+    }
+
+    size_t count = 0;
+    bool more = false;
+    esp_err_t err = storage_search_notes(ns, q, notes, limit, &count, &more);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to search notes: %s", esp_err_to_name(err));
+        free(notes);
+        httpd_resp_set_status(req, "500 Internal Server Error");
+        httpd_resp_sendstr(req, "{\"error\":\"Failed to search notes\"}");
+        return ESP_FAIL;
     }
 
+    cJSON *root = cJSON_CreateObject();
+    cJSON *notes_array = notes_to_json(notes, count);
+    free(notes);
+    if (!root || !notes_array) {
+        cJSON_Delete(root);
+        cJSON_Delete(notes_array);
+        httpd_resp_set_status(req, "500 Internal Server Error");
+        httpd_resp_sendstr(req, "{\"error\":\"Out of memory\"}");
+        return ESP_FAIL;
+    }
     cJSON_AddItemToObject(root, "notes", notes_array);
-    
+    cJSON_AddBoolToObject(root, "more", more);
+
     char *json_str = cJSON_PrintUnformatted(root);
     cJSON_Delete(root);
-    free(notes);
+    if (!json_str) {
+        ESP_LOGE(TAG, "Failed to serialize JSON response");
+        httpd_resp_set_status(req, "500 Internal Server Error");
+        httpd_resp_sendstr(req, "{\"error\":\"Failed to serialize response\"}");
+        return ESP_FAIL;
+    }
+
+    httpd_resp_set_type(req, "application/json");
+    httpd_resp_sendstr(req, json_str);
+    free(json_str);
+    return ESP_OK;
+}
+
+// GET /api/search?q=words&limit=n - Notes containing every word, newest first
+static esp_err_t api_search_handler(httpd_req_t *req)
+{
+    return search_notes(req, STORAGE_NS_DEFAULT);
+}
+
+static esp_err_t send_created(httpd_req_t *req, const char *note_id)
+{
+    cJSON *response = cJSON_CreateObject();
+    cJSON_AddStringToObject(response, "id", note_id);
+    cJSON_AddStringToObject(response, "status", "created");
+
+    char *json_str = cJSON_PrintUnformatted(response);
+    cJSON_Delete(response);
 
     if (!json_str) {
         ESP_LOGE(TAG, "Failed to serialize JSON response");
@@ -146,12 +321,175 @@ static esp_err_t api_list_notes_handler(httpd_req_t *req)
     return ESP_OK;
 }
 
-// POST /api/notes - Create new note
-static esp_err_t api_create_note_handler(httpd_req_t *req)
+static esp_err_t send_create_error(httpd_req_t *req, esp_err_t err)
+{
+    ESP_LOGE(TAG, "Failed to create note: %s", esp_err_to_name(err));
+    if (err == ESP_ERR_INVALID_SIZE) {
+        httpd_resp_set_status(req, "413 Payload Too Large");
+        httpd_resp_sendstr(req, "{\"error\":\"Message too large\"}");
+    } else if (err == ESP_ERR_INVALID_STATE) {
+        httpd_resp_set_status(req, "409 Conflict");
+        httpd_resp_sendstr(req, "{\"error\":\"Device clock not set\"}");
+    } else if (err == ESP_ERR_INVALID_ARG) {
+        httpd_resp_set_status(req, "400 Bad Request");
+        httpd_resp_sendstr(req, "{\"error\":\"Invalid ttl\"}");
+    } else if (err == ESP_ERR_NO_MEM) {
+        httpd_resp_set_status(req, "507 Insufficient Storage");
+        httpd_resp_sendstr(req, "{\"error\":\"Storage full\"}");
+    } else {
+        httpd_resp_set_status(req, "500 Internal Server Error");
+        httpd_resp_sendstr(req, "{\"error\":\"Failed to create note\"}");
+    }
+    return ESP_FAIL;
+}
+
+// Receive exactly len body bytes; retries socket timeouts
+static int recv_full(httpd_req_t *req, char *buf, size_t len)
+{
+    size_t received = 0;
+    while (received < len) {
+        int ret = httpd_req_recv(req, buf + received, len - received);
+        if (ret == HTTPD_SOCK_ERR_TIMEOUT) {
+            continue;
+        }
+        if (ret <= 0) {
+            return -1;
+        }
+        received += ret;
+    }
+    return (int)received;
+}
+
+// Turn a TTL in seconds into an absolute expiry time (0 = never expires)
+static esp_err_t ttl_to_expiry(double ttl, uint64_t *expires_at)
+{
+    if (!(ttl >= 1 && ttl <= EXPIRY_MAX_TTL_S)) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    *expires_at = (uint64_t)time(NULL) + (uint64_t)ttl;
+    return ESP_OK;
+}
+
+// Decode a percent-encoded header value (encodeURIComponent on the client)
+static void url_decode(const char *src, char *dst, size_t len)
+{
+    size_t n = 0;
+    while (*src && n + 1 < len) {
+        unsigned int byte;
+        if (src[0] == '%' && sscanf(src + 1, "%2x", &byte) == 1) {
+            dst[n++] = (char)byte;
+            src += 3;
+        } else {
+            dst[n++] = *src++;
+        }
+    }
+    dst[n] = '\0';
+}
+
+// Write the request body to flash as it arrives. *dropped is set if the
+// client went away, in which case no response can be sent.
+static esp_err_t receive_body(httpd_req_t *req, storage_writer_t *writer, bool *dropped)
+{
+    *dropped = false;
+    char *chunk = malloc(UPLOAD_CHUNK_SIZE);
+    if (!chunk) {
+        return ESP_ERR_NO_MEM;
+    }
+
+    esp_err_t err = ESP_OK;
+    size_t remaining = req->content_len;
+    while (remaining > 0 && err == ESP_OK) {
+        size_t want = remaining < UPLOAD_CHUNK_SIZE ? remaining : UPLOAD_CHUNK_SIZE;
+        int ret = httpd_req_recv(req, chunk, want);
+        if (ret == HTTPD_SOCK_ERR_TIMEOUT) {
+            continue;
+        }
+        if (ret <= 0) {
+            ESP_LOGE(TAG, "Upload aborted with %zu bytes outstanding", remaining);
+            *dropped = true;
+            err = ESP_FAIL;
+            break;
+        }
+        err = storage_write_chunk(writer, chunk, ret);
+        remaining -= ret;
+    }
+    free(chunk);
+    return err;
+}
+
+// Raw body upload: title and flags travel in headers, the body is written to
+// flash as it arrives, so its size is bounded by the partition, not by RAM
+static esp_err_t create_note_streamed(httpd_req_t *req, uint8_t ns)
+{
+    char header[MAX_TITLE_LENGTH * 3 + 1];
+    char title[MAX_TITLE_LENGTH] = "";
+    if (httpd_req_get_hdr_value_str(req, "X-Note-Title", header, sizeof(header)) == ESP_OK) {
+        url_decode(header, title, sizeof(title));
+    }
+    if (title[0] == '\0') {
+        httpd_resp_set_status(req, "400 Bad Request");
+        httpd_resp_sendstr(req, "{\"error\":\"Missing required fields\"}");
+        return ESP_FAIL;
+    }
+
+    bool encrypted = false;
+    char flag[8];
+    if (httpd_req_get_hdr_value_str(req, "X-Note-Encrypted", flag, sizeof(flag)) == ESP_OK) {
+        encrypted = strcmp(flag, "1") == 0 || strcmp(flag, "true") == 0;
+    }
+
+    uint64_t expires_at = 0;
+    char ttl[16];
+    if (httpd_req_get_hdr_value_str(req, "X-Note-TTL", ttl, sizeof(ttl)) == ESP_OK) {
+        char *end;
+        double seconds = strtod(ttl, &end);
+        if (end == ttl || *end != '\0' || ttl_to_expiry(seconds, &expires_at) != ESP_OK) {
+            return send_create_error(req, ESP_ERR_INVALID_ARG);
+        }
+    }
+
+    storage_writer_t writer;
+    esp_err_t err = storage_begin_note(ns, title, encrypted, expires_at, req->content_len,
+                                       &writer);
+    if (err != ESP_OK) {
+        return send_create_error(req, err);
+    }
+
+    int64_t start = esp_timer_get_time();
+    bool dropped;
+    err = receive_body(req, &writer, &dropped);
+    if (err != ESP_OK) {
+        storage_abort_note(&writer);
+        return dropped ? ESP_FAIL : send_create_error(req, err);
+    }
+
+    char note_id[16];
+    err = storage_commit_note(&writer, note_id);
+    if (err != ESP_OK) {
+        return send_create_error(req, err);
+    }
+
+    int64_t elapsed_us = esp_timer_get_time() - start;
+    ESP_LOGI(TAG, "Note %s uploaded: %zu bytes in %lld ms (%lld KB/s)",
+             note_id, req->content_len, (long long)(elapsed_us / 1000),
+             elapsed_us > 0 ? (long long)req->content_len * 1000000 / 1024 / elapsed_us : 0LL);
+    return send_created(req, note_id);
+}
+
+// JSON body: {"title","message","encrypted","ttl"}, limited to MAX_NOTE_SIZE_BYTES
+static esp_err_t create_note_json(httpd_req_t *req, uint8_t ns)
 {
-    char content[MAX_NOTE_SIZE_BYTES + 512];
-    int ret = httpd_req_recv(req, content, sizeof(content) - 1);
+    if (req->content_len > MAX_NOTE_SIZE_BYTES + 512) {
+        return send_create_error(req, ESP_ERR_INVALID_SIZE);
+    }
+
+    char *content = malloc(req->content_len + 1);
+    if (!content) {
+        return send_create_error(req, ESP_ERR_NO_MEM);
+    }
+    int ret = req->content_len ? recv_full(req, content, req->content_len) : 0;
     if (ret <= 0) {
+        free(content);
         httpd_resp_set_status(req, "400 Bad Request");
         httpd_resp_sendstr(req, "{\"error\":\"Invalid request\"}");
         return ESP_FAIL;
@@ -159,6 +497,7 @@ static esp_err_t api_create_note_handler(httpd_req_t *req)
     content[ret] = '\0';
 
     cJSON *json = cJSON_Parse(content);
+    free(content);
     if (!json) {
         httpd_resp_set_status(req, "400 Bad Request");
         httpd_resp_sendstr(req, "{\"error\":\"Invalid JSON\"}");
@@ -168,8 +507,9 @@ static esp_err_t api_create_note_handler(httpd_req_t *req)
     cJSON *title_item = cJSON_GetObjectItem(json, "title");
     cJSON *message_item = cJSON_GetObjectItem(json, "message");
     cJSON *encrypted_item = cJSON_GetObjectItem(json, "encrypted");
+    cJSON *ttl_item = cJSON_GetObjectItem(json, "ttl");
 
-    if (!title_item || !message_item) {
+    if (!cJSON_IsString(title_item) || !cJSON_IsString(message_item)) {
         cJSON_Delete(json);
         httpd_resp_set_status(req, "400 Bad Request");
         httpd_resp_sendstr(req, "{\"error\":\"Missing required fields\"}");
@@ -178,106 +518,206 @@ static esp_err_t api_create_note_handler(httpd_req_t *req)
 
     bool encrypted = encrypted_item ? cJSON_IsTrue(encrypted_item) : false;
 
+    uint64_t expires_at = 0;
+    if (ttl_item && !cJSON_IsNull(ttl_item) &&
+        (!cJSON_IsNumber(ttl_item) || ttl_to_expiry(ttl_item->valuedouble, &expires_at) != ESP_OK)) {
+        cJSON_Delete(json);
+        return send_create_error(req, ESP_ERR_INVALID_ARG);
+    }
+
     char note_id[16];
-    esp_err_t err = storage_create_note(title_item->valuestring,
+    esp_err_t err = storage_create_note(ns,
+                                        title_item->valuestring,
                                         message_item->valuestring,
                                         encrypted,
+                                        expires_at,
                                         note_id);
     cJSON_Delete(json);
 
     if (err != ESP_OK) {
-        ESP_LOGE(TAG, "Failed to create note: %s", esp_err_to_name(err));
-        httpd_resp_set_status(req, "500 Internal Server Error");
-        httpd_resp_sendstr(req, "{\"error\":\"Failed to create note\"}");
-        return ESP_FAIL;
+        return send_create_error(req, err);
     }
 
     ESP_LOGI(TAG, "Note created successfully: %s", note_id);
+    return send_created(req, note_id);
+}
 
-    cJSON *response = cJSON_CreateObject();
-    cJSON_AddStringToObject(response, "id", note_id);
-    cJSON_AddStringToObject(response, "status", "created");
+static esp_err_t create_note(httpd_req_t *req, uint8_t ns)
+{
+    char content_type[64] = "";
+    httpd_req_get_hdr_value_str(req, "Content-Type", content_type, sizeof(content_type));
+    if (strncmp(content_type, "application/octet-stream", 24) == 0) {
+        return create_note_streamed(req, ns);
+    }
+    return create_note_json(req, ns);
+}
 
-    char *json_str = cJSON_PrintUnformatted(response);
-    cJSON_Delete(response);
+// POST /api/notes - Create new note
+static esp_err_t api_create_note_handler(httpd_req_t *req)
+{
+    return create_note(req, STORAGE_NS_DEFAULT);
+}
 
-    if (!json_str) {
-        ESP_LOGE(TAG, "Failed to serialize JSON response");
-        httpd_resp_set_status(req, "500 Internal Server Error");
-        httpd_resp_sendstr(req, "{\"error\":\"Failed to serialize response\"}");
-        return ESP_FAIL;
+// Response writer that batches small pieces into chunked-encoding frames
+typedef struct {
+    httpd_req_t *req;
+    char buf[512];
+    size_t len;
+    esp_err_t err;
+} json_stream_t;
+
+static void json_flush(json_stream_t *js)
+{
+    if (js->len > 0 && js->err == ESP_OK) {
+        js->err = httpd_resp_send_chunk(js->req, js->buf, js->len);
     }
+    js->len = 0;
+}
 
-    httpd_resp_set_type(req, "application/json");
-    httpd_resp_sendstr(req, json_str);
-    free(json_str);
+static void json_put(json_stream_t *js, const char *data, size_t len)
+{
+    while (len > 0 && js->err == ESP_OK) {
+        if (js->len == sizeof(js->buf)) {
+            json_flush(js);
+        }
+        size_t n = sizeof(js->buf) - js->len;
+        if (n > len) {
+            n = len;
+        }
+        memcpy(js->buf + js->len, data, n);
+        js->len += n;
+        data += n;
+        len -= n;
+    }
+}
 
-    return ESP_OK;
+static void json_put_str(json_stream_t *js, const char *str)
+{
+    json_put(js, str, strlen(str));
 }
 
-// GET /api/notes/{id} - Read note (returns encrypted message if encrypted)
-static esp_err_t api_read_note_handler(httpd_req_t *req)
+// Append len bytes as the inside of a JSON string literal
+static void json_put_escaped(json_stream_t *js, const char *data, size_t len)
 {
-    // Extract note ID from URI
-    char note_id[16];
-    const char *uri = req->uri;
-    sscanf(uri, "/api/notes/%s", note_id);
+    for (size_t i = 0; i < len; i++) {
+        unsigned char c = (unsigned char)data[i];
+        char esc[7];
+        switch (c) {
+        case '"':  json_put(js, "\\\"", 2); break;
+        case '\\': json_put(js, "\\\\", 2); break;
+        case '\n': json_put(js, "\\n", 2); break;
+        case '\r': json_put(js, "\\r", 2); break;
+        case '\t': json_put(js, "\\t", 2); break;
+        default:
+            if (c < 0x20) {
+                snprintf(esc, sizeof(esc), "\\u%04x", c);
+                json_put(js, esc, 6);
+            } else {
+                json_put(js, (const char *)&c, 1);
+            }
+        }
+    }
+}
 
-    // Read note
-    char message[MAX_NOTE_SIZE_BYTES];
-    size_t message_len = sizeof(message);
-    note_metadata_t metadata;
+// Copy one path segment starting at start, dropping any query or trailing slash
+static void copy_segment(const char *start, char *out, size_t len)
+{
+    size_t n = strcspn(start, "?/");
+    if (n >= len) {
+        n = len - 1;
+    }
+    memcpy(out, start, n);
+    out[n] = '\0';
+}
 
-    esp_err_t err = storage_read_note(note_id, message, &message_len, &metadata);
+// Copy the note ID out of /api/notes/{id}
+static void note_id_from_uri(const char *uri, char *note_id, size_t len)
+{
+    copy_segment(uri + strlen("/api/notes/"), note_id, len);
+}
 
-    if (err != ESP_OK) {
+// The body is streamed from flash through a fixed buffer; it is never held whole in RAM.
+static esp_err_t read_note(httpd_req_t *req, uint8_t ns, const char *note_id)
+{
+    note_metadata_t metadata;
+    storage_reader_t reader;
+    esp_err_t err = storage_open_note(ns, note_id, &metadata, &reader);
+    if (err == ESP_ERR_NOT_FOUND) {
         httpd_resp_set_status(req, "404 Not Found");
         httpd_resp_set_type(req, "application/json");
         httpd_resp_sendstr(req, "{\"error\":\"Note not found\"}");
         return ESP_FAIL;
     }
+    if (err != ESP_OK) {
+        httpd_resp_set_status(req, "500 Internal Server Error");
+        httpd_resp_set_type(req, "application/json");
+        httpd_resp_sendstr(req, "{\"error\":\"Failed to read note\"}");
+        return ESP_FAIL;
+    }
 
-    cJSON *response = cJSON_CreateObject();
-    cJSON_AddStringToObject(response, "id", metadata.id);
-    cJSON_AddStringToObject(response, "title", metadata.title);
-    cJSON_AddNumberToObject(response, "timestamp", (double)metadata.timestamp);
-    cJSON_AddBoolToObject(response, "encrypted", metadata.encrypted);
-    cJSON_AddStringToObject(response, "message", message);
+    httpd_resp_set_type(req, "application/json");
 
-    char *json_str = cJSON_PrintUnformatted(response);
-    cJSON_Delete(response);
+    json_stream_t js = { .req = req, .err = ESP_OK };
+    char num[96];
+    json_put_str(&js, "{\"id\":\"");
+    json_put_escaped(&js, metadata.id, strlen(metadata.id));
+    json_put_str(&js, "\",\"title\":\"");
+    json_put_escaped(&js, metadata.title, strlen(metadata.title));
+    snprintf(num, sizeof(num), "\",\"timestamp\":%llu,\"encrypted\":%s",
+             (unsigned long long)metadata.timestamp, metadata.encrypted ? "true" : "false");
+    json_put_str(&js, num);
+    if (metadata.expires_at) {
+        snprintf(num, sizeof(num), ",\"expires_at\":%llu",
+                 (unsigned long long)metadata.expires_at);
+        json_put_str(&js, num);
+    }
+    json_put_str(&js, ",\"message\":\"");
+
+    char chunk[256];
+    size_t chunk_len;
+    while (js.err == ESP_OK) {
+        err = storage_read_chunk(&reader, chunk, sizeof(chunk), &chunk_len);
+        if (err != ESP_OK || chunk_len == 0) {
+            break;
+        }
+        json_put_escaped(&js, chunk, chunk_len);
+    }
+    storage_close_note(&reader);
 
-    if (!json_str) {
-        ESP_LOGE(TAG, "Failed to serialize read response");
-        httpd_resp_set_status(req, "500 Internal Server Error");
-        httpd_resp_sendstr(req, "{\"error\":\"Failed to serialize response\"}");
+    if (err != ESP_OK || js.err != ESP_OK) {
+        // Headers are already out; dropping the connection truncates the response
+        ESP_LOGE(TAG, "Failed to stream note %s: %s", note_id,
+                 esp_err_to_name(err != ESP_OK ? err : js.err));
         return ESP_FAIL;
     }
 
-    httpd_resp_set_type(req, "application/json");
-    httpd_resp_sendstr(req, json_str);
-    free(json_str);
+    json_put_str(&js, "\"}");
+    json_flush(&js);
+    httpd_resp_send_chunk(req, NULL, 0);
 
     ESP_LOGI(TAG, "Read note %s (encrypted=%d)", note_id, metadata.encrypted);
     return ESP_OK;
 }
 
-// DELETE /api/notes/{id} - Delete note
-static esp_err_t api_delete_note_handler(httpd_req_t *req)
+// GET /api/notes/{id} - Read note
+static esp_err_t api_read_note_handler(httpd_req_t *req)
 {
     char note_id[16];
-    const char *uri = req->uri;
-    sscanf(uri, "/api/notes/%15s", note_id);
-    
-    // Remove any query parameters or trailing slashes
-    char *query = strchr(note_id, '?');
-    if (query) *query = '\0';
-    char *slash = strchr(note_id, '/');
-    if (slash) *slash = '\0';
-    
+    note_id_from_uri(req->uri, note_id, sizeof(note_id));
+    return read_note(req, STORAGE_NS_DEFAULT, note_id);
+}
+
+static esp_err_t delete_note(httpd_req_t *req, uint8_t ns, const char *note_id)
+{
     ESP_LOGI(TAG, "Deleting note: %s", note_id);
 
-    esp_err_t err = storage_delete_note(note_id);
+    esp_err_t err = storage_delete_note(ns, note_id);
+    if (err == ESP_ERR_NOT_FOUND) {
+        httpd_resp_set_status(req, "404 Not Found");
+        httpd_resp_set_type(req, "application/json");
+        httpd_resp_sendstr(req, "{\"error\":\"Note not found\"}");
+        return ESP_FAIL;
+    }
     if (err != ESP_OK) {
         httpd_resp_set_status(req, "500 Internal Server Error");
         httpd_resp_sendstr(req, "{\"error\":\"Failed to delete note\"}");
@@ -289,6 +729,194 @@ static esp_err_t api_delete_note_handler(httpd_req_t *req)
     return ESP_OK;
 }
 
+// DELETE /api/notes/{id} - Delete note
+static esp_err_t api_delete_note_handler(httpd_req_t *req)
+{
+    char note_id[16];
+    note_id_from_uri(req->uri, note_id, sizeof(note_id));
+    return delete_note(req, STORAGE_NS_DEFAULT, note_id);
+}
+
+// Append the raw request body to a note. Only the new bytes are written;
+// encrypted notes take separately encrypted segments.
+static esp_err_t append_note(httpd_req_t *req, uint8_t ns, const char *note_id)
+{
+    httpd_resp_set_type(req, "application/json");
+
+    if (req->content_len == 0) {
+        httpd_resp_set_status(req, "400 Bad Request");
+        httpd_resp_sendstr(req, "{\"error\":\"Nothing to append\"}");
+        return ESP_FAIL;
+    }
+
+    storage_writer_t writer;
+    esp_err_t err = storage_begin_append(ns, note_id, req->content_len, &writer);
+    bool dropped = false;
+    if (err == ESP_OK) {
+        err = receive_body(req, &writer, &dropped);
+        if (err != ESP_OK) {
+            storage_abort_note(&writer);
+        }
+    }
+    char committed_id[16];
+    if (err == ESP_OK) {
+        err = storage_commit_note(&writer, committed_id);
+    }
+    if (dropped) {
+        return ESP_FAIL;
+    }
+
+    if (err == ESP_ERR_NOT_FOUND) {
+        httpd_resp_set_status(req, "404 Not Found");
+        httpd_resp_sendstr(req, "{\"error\":\"Note not found\"}");
+        return ESP_FAIL;
+    }
+    if (err == ESP_ERR_INVALID_STATE) {
+        httpd_resp_set_status(req, "409 Conflict");
+        httpd_resp_sendstr(req, "{\"error\":\"Note is already being appended to\"}");
+        return ESP_FAIL;
+    }
+    if (err == ESP_ERR_NOT_SUPPORTED) {
+        httpd_resp_set_status(req, "501 Not Implemented");
+        httpd_resp_sendstr(req, "{\"error\":\"Storage engine cannot append\"}");
+        return ESP_FAIL;
+    }
+    if (err != ESP_OK) {
+        return send_create_error(req, err);
+    }
+
+    char body[96];
+    snprintf(body, sizeof(body), "{\"id\":\"%s\",\"size\":%" PRIu32 ",\"status\":\"appended\"}",
+             writer.meta.id, writer.meta.size);
+    httpd_resp_sendstr(req, body);
+    return ESP_OK;
+}
+
+// PATCH /api/notes/{id} - Append to a note
+static esp_err_t api_append_note_handler(httpd_req_t *req)
+{
+    char note_id[16];
+    note_id_from_uri(req->uri, note_id, sizeof(note_id));
+    return append_note(req, STORAGE_NS_DEFAULT, note_id);
+}
+
+// Every note of a namespace as one archive, streamed with constant memory
+static esp_err_t export_notes(httpd_req_t *req, uint8_t ns)
+{
+    note_export_t *exp;
+    char *chunk = malloc(UPLOAD_CHUNK_SIZE);
+    if (!chunk || note_export_begin(ns, &exp) != ESP_OK) {
+        free(chunk);
+        httpd_resp_set_status(req, "500 Internal Server Error");
+        httpd_resp_sendstr(req, "{\"error\":\"Out of memory\"}");
+        return ESP_FAIL;
+    }
+
+    httpd_resp_set_type(req, "application/octet-stream");
+    httpd_resp_set_hdr(req, "Content-Disposition", "attachment; filename=\"deaddrop.ddar\"");
+
+    int64_t start = esp_timer_get_time();
+    uint64_t total = 0;
+    esp_err_t err;
+    size_t len;
+    while ((err = note_export_read(exp, chunk, UPLOAD_CHUNK_SIZE, &len)) == ESP_OK && len > 0) {
+        err = httpd_resp_send_chunk(req, chunk, len);
+        if (err != ESP_OK) {
+            break;
+        }
+        total += len;
+    }
+    uint32_t count = note_export_count(exp);
+    note_export_free(exp);
+    free(chunk);
+
+    // On error the archive ends without its end marker, so import rejects it
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Export aborted: %s", esp_err_to_name(err));
+        httpd_resp_send_chunk(req, NULL, 0);
+        return ESP_FAIL;
+    }
+
+    int64_t elapsed_us = esp_timer_get_time() - start;
+    ESP_LOGI(TAG, "Exported %" PRIu32 " notes, %llu bytes in %lld ms (%lld KB/s)",
+             count, (unsigned long long)total, (long long)(elapsed_us / 1000),
+             elapsed_us > 0 ? (long long)(total * 1000000 / 1024 / elapsed_us) : 0LL);
+    return httpd_resp_send_chunk(req, NULL, 0);
+}
+
+// GET /api/export - Every note of the default namespace
+static esp_err_t api_export_handler(httpd_req_t *req)
+{
+    return export_notes(req, STORAGE_NS_DEFAULT);
+}
+
+// Add every note of an export archive to a namespace (IDs are reassigned)
+static esp_err_t import_notes(httpd_req_t *req, uint8_t ns)
+{
+    note_import_t *imp;
+    char *chunk = malloc(UPLOAD_CHUNK_SIZE);
+    if (!chunk || note_import_begin(ns, &imp) != ESP_OK) {
+        free(chunk);
+        httpd_resp_set_status(req, "500 Internal Server Error");
+        httpd_resp_sendstr(req, "{\"error\":\"Out of memory\"}");
+        return ESP_FAIL;
+    }
+
+    int64_t start = esp_timer_get_time();
+    esp_err_t err = ESP_OK;
+    size_t remaining = req->content_len;
+    while (remaining > 0 && err == ESP_OK) {
+        size_t want = remaining < UPLOAD_CHUNK_SIZE ? remaining : UPLOAD_CHUNK_SIZE;
+        int ret = httpd_req_recv(req, chunk, want);
+        if (ret == HTTPD_SOCK_ERR_TIMEOUT) {
+            continue;
+        }
+        if (ret <= 0) {
+            ESP_LOGE(TAG, "Import aborted with %zu bytes outstanding", remaining);
+            note_import_free(imp);
+            free(chunk);
+            return ESP_FAIL;
+        }
+        err = note_import_feed(imp, chunk, ret);
+        remaining -= ret;
+    }
+    free(chunk);
+
+    uint32_t imported = 0, skipped = 0;
+    if (err == ESP_OK) {
+        err = note_import_finish(imp, &imported, &skipped);
+    }
+    note_import_free(imp);
+
+    httpd_resp_set_type(req, "application/json");
+    if (err == ESP_ERR_INVALID_RESPONSE || err == ESP_ERR_INVALID_CRC ||
+        err == ESP_ERR_INVALID_SIZE) {
+        ESP_LOGE(TAG, "Rejected import archive: %s", esp_err_to_name(err));
+        httpd_resp_set_status(req, "400 Bad Request");
+        httpd_resp_sendstr(req, "{\"error\":\"Invalid or truncated archive\"}");
+        return ESP_FAIL;
+    }
+    if (err != ESP_OK) {
+        return send_create_error(req, err);
+    }
+
+    int64_t elapsed_us = esp_timer_get_time() - start;
+    ESP_LOGI(TAG, "Imported %" PRIu32 " notes (%" PRIu32 " expired), %zu bytes in %lld ms (%lld KB/s)",
+             imported, skipped, req->content_len, (long long)(elapsed_us / 1000),
+             elapsed_us > 0 ? (long long)req->content_len * 1000000 / 1024 / elapsed_us : 0LL);
+
+    char response[64];
+    snprintf(response, sizeof(response), "{\"imported\":%" PRIu32 ",\"skipped\":%" PRIu32 "}",
+             imported, skipped);
+    return httpd_resp_sendstr(req, response);
+}
+
+// POST /api/import - Import into the default namespace
+static esp_err_t api_import_handler(httpd_req_t *req)
+{
+    return import_notes(req, STORAGE_NS_DEFAULT);
+}
+
 // POST /api/time - Sync time from client
 static esp_err_t api_time_handler(httpd_req_t *req)
 {
@@ -322,6 +950,7 @@ static esp_err_t api_time_handler(httpd_req_t *req)
         .tv_usec = 0
     };
     settimeofday(&tv, NULL);
+    storage_time_changed();  // Expiry times may have just come due
 
     cJSON_Delete(root);
     
@@ -335,6 +964,13 @@ static esp_err_t api_time_handler(httpd_req_t *req)
 // GET /api/stats - Get storage statistics
 static esp_err_t api_stats_handler(httpd_req_t *req)
 {
+    // Wear, cache and latency counters are only refreshed along with the notes
+    char etag[16];
+    generation_etag(etag, sizeof(etag));
+    if (send_if_not_modified(req, etag)) {
+        return ESP_OK;
+    }
+
     storage_stats_t stats;
     esp_err_t err = storage_get_stats(&stats);
     if (err != ESP_OK) {
@@ -347,6 +983,42 @@ static esp_err_t api_stats_handler(httpd_req_t *req)
     cJSON_AddNumberToObject(response, "count", stats.count);
     cJSON_AddNumberToObject(response, "total", stats.total);
     cJSON_AddNumberToObject(response, "used", stats.used);
+    cJSON_AddNumberToObject(response, "encrypted_count", stats.encrypted_count);
+    cJSON_AddNumberToObject(response, "plain_count", stats.plain_count);
+    cJSON_AddNumberToObject(response, "message_bytes", (double)stats.message_bytes);
+    cJSON_AddNumberToObject(response, "encrypted_bytes", (double)stats.encrypted_bytes);
+    cJSON_AddNumberToObject(response, "plain_bytes", (double)stats.plain_bytes);
+
+    // Flash wear since boot, per kind of storage work
+    static const char *const wear_names[STORAGE_WEAR_COUNT] = {
+        [STORAGE_WEAR_NOTES] = "notes",
+        [STORAGE_WEAR_DELETES] = "deletes",
+        [STORAGE_WEAR_NOTE_IDS] = "note_ids",
+        [STORAGE_WEAR_INDEX] = "index",
+        [STORAGE_WEAR_BACKGROUND] = "background",
+    };
+    cJSON_AddBoolToObject(response, "flash_counters", stats.flash_counters);
+    cJSON *wear = cJSON_AddObjectToObject(response, "wear");
+    for (int i = 0; wear && i < STORAGE_WEAR_COUNT; i++) {
+        cJSON *kind = cJSON_AddObjectToObject(wear, wear_names[i]);
+        if (!kind) {
+            break;
+        }
+        cJSON_AddNumberToObject(kind, "ops", stats.wear[i].ops);
+        cJSON_AddNumberToObject(kind, "logical_bytes", (double)stats.wear[i].logical_bytes);
+        cJSON_AddNumberToObject(kind, "written_bytes", (double)stats.wear[i].written_bytes);
+        cJSON_AddNumberToObject(kind, "erased_bytes", (double)stats.wear[i].erased_bytes);
+    }
+
+    cJSON *cache = cJSON_AddObjectToObject(response, "cache");
+    if (cache) {
+        cJSON_AddNumberToObject(cache, "hits", stats.cache_hits);
+        cJSON_AddNumberToObject(cache, "misses", stats.cache_misses);
+        cJSON_AddNumberToObject(cache, "entries", stats.cache_entries);
+        cJSON_AddNumberToObject(cache, "bytes", stats.cache_bytes);
+    }
+    cJSON_AddNumberToObject(response, "commit_p99_ms", stats.commit_p99_ms);
+    cJSON_AddNumberToObject(response, "commit_max_ms", stats.commit_max_ms);
 
     char *json_str = cJSON_PrintUnformatted(response);
     cJSON_Delete(response);
@@ -365,6 +1037,202 @@ static esp_err_t api_stats_handler(httpd_req_t *req)
     return ESP_OK;
 }
 
+// Namespaces: /api/ns/{name}/notes, /notes/{id}, /search, /stats, /export and
+// /import behave like their /api counterparts but only see that namespace.
+// POST creates the namespace on first use; other methods 404 until then.
+
+// Split /api/ns/{name}/{rest} into name and rest
+static esp_err_t ns_split(httpd_req_t *req, char *name, size_t len, const char **rest)
+{
+    const char *start = req->uri + strlen("/api/ns/");
+    size_t n = strcspn(start, "?/");
+    if (n == 0 || n >= len) {
+        httpd_resp_set_status(req, "400 Bad Request");
+        httpd_resp_sendstr(req, "{\"error\":\"Invalid namespace\"}");
+        return ESP_FAIL;
+    }
+    memcpy(name, start, n);
+    name[n] = '\0';
+    *rest = start[n] == '/' ? start + n + 1 : start + n;
+    return ESP_OK;
+}
+
+static esp_err_t ns_resolve(httpd_req_t *req, const char *name, bool create, uint8_t *ns)
+{
+    esp_err_t err = storage_find_namespace(name, create, ns);
+    if (err == ESP_ERR_INVALID_ARG) {
+        httpd_resp_set_status(req, "400 Bad Request");
+        httpd_resp_sendstr(req, "{\"error\":\"Invalid namespace\"}");
+    } else if (err == ESP_ERR_NOT_FOUND) {
+        httpd_resp_set_status(req, "404 Not Found");
+        httpd_resp_sendstr(req, "{\"error\":\"Namespace not found\"}");
+    } else if (err == ESP_ERR_NO_MEM) {
+        httpd_resp_set_status(req, "507 Insufficient Storage");
+        httpd_resp_sendstr(req, "{\"error\":\"Too many namespaces\"}");
+    } else if (err != ESP_OK) {
+        httpd_resp_set_status(req, "500 Internal Server Error");
+        httpd_resp_sendstr(req, "{\"error\":\"Failed to open namespace\"}");
+    }
+    return err;
+}
+
+// True if the rest of the path is exactly this route (a query may follow)
+static bool ns_route_is(const char *rest, const char *route)
+{
+    size_t n = strlen(route);
+    return strncmp(rest, route, n) == 0 && (rest[n] == '\0' || rest[n] == '?');
+}
+
+// notes/{id}: copy the ID, false for any other route
+static bool ns_note_route(const char *rest, char *note_id, size_t len)
+{
+    if (strncmp(rest, "notes/", 6) != 0) {
+        return false;
+    }
+    copy_segment(rest + 6, note_id, len);
+    return note_id[0] != '\0';
+}
+
+static esp_err_t ns_unknown_route(httpd_req_t *req)
+{
+    httpd_resp_set_status(req, "404 Not Found");
+    httpd_resp_sendstr(req, "{\"error\":\"Unknown namespace route\"}");
+    return ESP_FAIL;
+}
+
+// Counters of one namespace; filesystem totals and wear stay on /api/stats
+static esp_err_t ns_stats(httpd_req_t *req, const char *name, uint8_t ns)
+{
+    char etag[16];
+    generation_etag(etag, sizeof(etag));
+    if (send_if_not_modified(req, etag)) {
+        return ESP_OK;
+    }
+
+    storage_ns_stats_t stats;
+    if (storage_get_ns_stats(ns, &stats) != ESP_OK) {
+        httpd_resp_set_status(req, "500 Internal Server Error");
+        httpd_resp_sendstr(req, "{\"error\":\"Failed to get stats\"}");
+        return ESP_FAIL;
+    }
+
+    cJSON *response = cJSON_CreateObject();
+    cJSON_AddStringToObject(response, "namespace", name);
+    cJSON_AddNumberToObject(response, "count", stats.count);
+    cJSON_AddNumberToObject(response, "encrypted_count", stats.encrypted_count);
+    cJSON_AddNumberToObject(response, "plain_count", stats.count - stats.encrypted_count);
+    cJSON_AddNumberToObject(response, "message_bytes", (double)stats.message_bytes);
+    cJSON_AddNumberToObject(response, "encrypted_bytes", (double)stats.encrypted_bytes);
+    cJSON_AddNumberToObject(response, "plain_bytes",
+                            (double)(stats.message_bytes - stats.encrypted_bytes));
+
+    char *json_str = cJSON_PrintUnformatted(response);
+    cJSON_Delete(response);
+    if (!json_str) {
+        httpd_resp_set_status(req, "500 Internal Server Error");
+        httpd_resp_sendstr(req, "{\"error\":\"Failed to serialize response\"}");
+        return ESP_FAIL;
+    }
+
+    httpd_resp_set_type(req, "application/json");
+    httpd_resp_sendstr(req, json_str);
+    free(json_str);
+    return ESP_OK;
+}
+
+// GET /api/ns/{name}/...
+static esp_err_t api_ns_get_handler(httpd_req_t *req)
+{
+    char name[NAMESPACE_NAME_LEN + 1];
+    const char *rest;
+    uint8_t ns;
+    httpd_resp_set_type(req, "application/json");
+    if (ns_split(req, name, sizeof(name), &rest) != ESP_OK ||
+        ns_resolve(req, name, false, &ns) != ESP_OK) {
+        return ESP_FAIL;
+    }
+
+    char note_id[16];
+    if (ns_route_is(rest, "notes")) {
+        return list_notes(req, ns);
+    }
+    if (ns_note_route(rest, note_id, sizeof(note_id))) {
+        return read_note(req, ns, note_id);
+    }
+    if (ns_route_is(rest, "search")) {
+        return search_notes(req, ns);
+    }
+    if (ns_route_is(rest, "stats")) {
+        return ns_stats(req, name, ns);
+    }
+    if (ns_route_is(rest, "export")) {
+        return export_notes(req, ns);
+    }
+    return ns_unknown_route(req);
+}
+
+// POST /api/ns/{name}/notes or /import
+static esp_err_t api_ns_post_handler(httpd_req_t *req)
+{
+    char name[NAMESPACE_NAME_LEN + 1];
+    const char *rest;
+    uint8_t ns;
+    httpd_resp_set_type(req, "application/json");
+    if (ns_split(req, name, sizeof(name), &rest) != ESP_OK) {
+        return ESP_FAIL;
+    }
+
+    // Only a known route may create the namespace
+    bool notes = ns_route_is(rest, "notes");
+    if (!notes && !ns_route_is(rest, "import")) {
+        return ns_unknown_route(req);
+    }
+    if (ns_resolve(req, name, true, &ns) != ESP_OK) {
+        return ESP_FAIL;
+    }
+    return notes ? create_note(req, ns) : import_notes(req, ns);
+}
+
+// DELETE /api/ns/{name}/notes/{id}
+static esp_err_t api_ns_delete_handler(httpd_req_t *req)
+{
+    char name[NAMESPACE_NAME_LEN + 1];
+    const char *rest;
+    uint8_t ns;
+    char note_id[16];
+    httpd_resp_set_type(req, "application/json");
+    if (ns_split(req, name, sizeof(name), &rest) != ESP_OK) {
+        return ESP_FAIL;
+    }
+    if (!ns_note_route(rest, note_id, sizeof(note_id))) {
+        return ns_unknown_route(req);
+    }
+    if (ns_resolve(req, name, false, &ns) != ESP_OK) {
+        return ESP_FAIL;
+    }
+    return delete_note(req, ns, note_id);
+}
+
+// PATCH /api/ns/{name}/notes/{id}
+static esp_err_t api_ns_append_handler(httpd_req_t *req)
+{
+    char name[NAMESPACE_NAME_LEN + 1];
+    const char *rest;
+    uint8_t ns;
+    char note_id[16];
+    httpd_resp_set_type(req, "application/json");
+    if (ns_split(req, name, sizeof(name), &rest) != ESP_OK) {
+        return ESP_FAIL;
+    }
+    if (!ns_note_route(rest, note_id, sizeof(note_id))) {
+        return ns_unknown_route(req);
+    }
+    if (ns_resolve(req, name, false, &ns) != ESP_OK) {
+        return ESP_FAIL;
+    }
+    return append_note(req, ns, note_id);
+}
+
 esp_err_t web_server_start(void)
 {
     if (server != NULL) {
@@ -374,7 +1242,7 @@ esp_err_t web_server_start(void)
 
     httpd_ssl_config_t config = HTTPD_SSL_CONFIG_DEFAULT();
     config.httpd.stack_size = 8192;
-    config.httpd.max_uri_handlers = 10;
+    config.httpd.max_uri_handlers = 15;
     config.httpd.uri_match_fn = httpd_uri_match_wildcard;
     
     // Set certificate and private key
@@ -386,6 +1254,9 @@ esp_err_t web_server_start(void)
     ESP_LOGI(TAG, "Certificate length: %zu bytes", config.servercert_len);
     ESP_LOGI(TAG, "Private key length: %zu bytes", config.prvtkey_len);
 
+    uint32_t crc = esp_rom_crc32_le(0, index_html_gz_start, index_html_gz_end - index_html_gz_start);
+    snprintf(g_index_etag, sizeof(g_index_etag), "\"%08" PRIx32 "\"", crc);
+
     if (httpd_ssl_start(&server, &config) != ESP_OK) {
         ESP_LOGE(TAG, "Failed to start HTTPS server");
         return ESP_FAIL;
@@ -416,6 +1287,14 @@ esp_err_t web_server_start(void)
     ESP_LOGI(TAG, "Registering handler: GET /api/notes");
     httpd_register_uri_handler(server, &api_list_notes);
 
+    httpd_uri_t api_search = {
+        .uri = "/api/search",
+        .method = HTTP_GET,
+        .handler = api_search_handler
+    };
+    ESP_LOGI(TAG, "Registering handler: GET /api/search");
+    httpd_register_uri_handler(server, &api_search);
+
     httpd_uri_t api_create_note = {
         .uri = "/api/notes",
         .method = HTTP_POST,
@@ -440,6 +1319,62 @@ esp_err_t web_server_start(void)
     ESP_LOGI(TAG, "Registering handler: DELETE /api/notes/*");
     httpd_register_uri_handler(server, &api_delete_note);
 
+    httpd_uri_t api_append_note = {
+        .uri = "/api/notes/*",
+        .method = HTTP_PATCH,
+        .handler = api_append_note_handler
+    };
+    ESP_LOGI(TAG, "Registering handler: PATCH /api/notes/*");
+    httpd_register_uri_handler(server, &api_append_note);
+
+    httpd_uri_t api_export = {
+        .uri = "/api/export",
+        .method = HTTP_GET,
+        .handler = api_export_handler
+    };
+    ESP_LOGI(TAG, "Registering handler: GET /api/export");
+    httpd_register_uri_handler(server, &api_export);
+
+    httpd_uri_t api_import = {
+        .uri = "/api/import",
+        .method = HTTP_POST,
+        .handler = api_import_handler
+    };
+    ESP_LOGI(TAG, "Registering handler: POST /api/import");
+    httpd_register_uri_handler(server, &api_import);
+
+    httpd_uri_t api_ns_get = {
+        .uri = "/api/ns/*",
+        .method = HTTP_GET,
+        .handler = api_ns_get_handler
+    };
+    ESP_LOGI(TAG, "Registering handler: GET /api/ns/*");
+    httpd_register_uri_handler(server, &api_ns_get);
+
+    httpd_uri_t api_ns_post = {
+        .uri = "/api/ns/*",
+        .method = HTTP_POST,
+        .handler = api_ns_post_handler
+    };
+    ESP_LOGI(TAG, "Registering handler: POST /api/ns/*");
+    httpd_register_uri_handler(server, &api_ns_post);
+
+    httpd_uri_t api_ns_delete = {
+        .uri = "/api/ns/*",
+        .method = HTTP_DELETE,
+        .handler = api_ns_delete_handler
+    };
+    ESP_LOGI(TAG, "Registering handler: DELETE /api/ns/*");
+    httpd_register_uri_handler(server, &api_ns_delete);
+
+    httpd_uri_t api_ns_append = {
+        .uri = "/api/ns/*",
+        .method = HTTP_PATCH,
+        .handler = api_ns_append_handler
+    };
+    ESP_LOGI(TAG, "Registering handler: PATCH /api/ns/*");
+    httpd_register_uri_handler(server, &api_ns_append);
+
     // Register static file handler LAST (wildcard, catches remaining)
     httpd_uri_t static_files = {
         .uri = "/*",